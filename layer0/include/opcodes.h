@@ -11,6 +11,7 @@ typedef uint64_t Instr;
 #define INSTR_SRC_B(i)  ((uint8_t)((i)>>32))
 #define INSTR_IMM_HI(i) ((uint16_t)((i)>>16))
 #define INSTR_IMM_LO(i) ((uint16_t)(i))
+#define INSTR_SRC_C(i)  ((uint8_t)((i)>>16))    /* low byte of hi, when op_reads() bit2 */
 typedef enum {
     OP_CONST=0,OP_ADD,OP_SUB,OP_MUL,OP_DIV,OP_NEG,OP_ABS,
     OP_OSC,OP_SAW,OP_SQUARE,OP_TRI,OP_PHASE,
@@ -20,9 +21,98 @@ typedef enum {
     OP_LPF,OP_HPF,OP_BPF,OP_ONEPOLE,
     OP_ADSR,OP_RAMP,OP_EXP_DECAY,
     OP_MIN,OP_MAX,OP_MIXN,OP_OUT,
+    OP_SVF,                 /* appended: existing encodings keep their values */
     OP_COUNT
 } Opcode;
 #define MAX_REGS   256
 #define MAX_STATE  512
 #define MAX_INSTRS 1024
 #define AUDIO_BLOCK 64
+
+/* Oscillator quality: imm lo of OP_SAW / OP_SQUARE / OP_TRI */
+#define OSC_NAIVE 0   /* trivial waveform; aliases at high pitch */
+#define OSC_BLEP  1   /* PolyBLEP / PolyBLAMP band-limited       */
+
+/* Math tier: imm lo of OP_OSC / OP_TANH / OP_EXP_DECAY */
+#define MATH_REF   0  /* reference: fsin, libm tanhf / expf         */
+#define MATH_POLY  1  /* polynomial kernels (patch_dsp.h error table) */
+#define MATH_RECUR 2  /* OP_EXP_DECAY only: one multiply per sample   */
+
+/* Oversampling: imm hi of OP_TANH / OP_FOLD / OP_CLIP.  The op runs at
+   2x or 4x between polyphase half-band filters (patch_dsp.h) that own
+   OS_*_SLOTS state slots; other values mean 1x.  Consecutive oversampled
+   ops form one region, see instr_os_continues(). */
+#define OS_1X 0
+#define OS_2X 1
+#define OS_4X 2
+#define OS_2X_SLOTS 40      /* 5*HB1_K         */
+#define OS_4X_SLOTS 55      /* 5*HB1_K+5*HB2_K */
+
+/* SVF response: imm lo of OP_SVF.  dst = svf(a; cutoff Hz = b, Q = c) */
+#define SVF_LP    0
+#define SVF_BP    1   /* unity gain at the cutoff */
+#define SVF_HP    2
+#define SVF_NOTCH 3
+
+/* State slots owned by each opcode (0 = stateless) */
+static inline int op_state_slots(uint8_t op){
+    switch(op){
+    case OP_OSC: case OP_SAW: case OP_SQUARE: case OP_TRI: case OP_PHASE:
+    case OP_FM:  case OP_PM:  case OP_LP_NOISE:
+    case OP_LPF: case OP_HPF: case OP_ONEPOLE:
+    case OP_EXP_DECAY:                    /* used by MATH_RECUR */
+        return 1;
+    case OP_SYNC: case OP_RAND_STEP: case OP_BPF:
+        return 2;
+    case OP_ADSR:
+        return 3;
+    case OP_SVF:
+        return 8;
+    default:
+        return 0;
+    }
+}
+
+/* Source operands read by each opcode: bit0 = a, bit1 = b, bit2 = c */
+static inline int op_reads(uint8_t op){
+    switch(op){
+    case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV:
+    case OP_FM:  case OP_PM:  case OP_AM:  case OP_SYNC:
+    case OP_MIN: case OP_MAX: case OP_MIXN:
+        return 3;
+    case OP_SVF:
+        return 7;
+    case OP_CONST: case OP_NOISE: case OP_LP_NOISE: case OP_RAND_STEP:
+    case OP_ADSR:  case OP_RAMP:  case OP_EXP_DECAY:
+        return 0;
+    default:
+        return 1;
+    }
+}
+
+/* State slots owned by one instruction: op_state_slots(), plus the
+   filter state of an oversampled nonlinearity */
+static inline int instr_state_slots(Instr ins){
+    uint8_t op=INSTR_OP(ins); uint16_t hi=INSTR_IMM_HI(ins);
+    if(op==OP_TANH||op==OP_FOLD||op==OP_CLIP)
+        return hi==OS_2X?OS_2X_SLOTS:hi==OS_4X?OS_4X_SLOTS:0;
+    return op_state_slots(op);
+}
+
+/* Oversampling factor (OS_2X / OS_4X) of an instruction, 0 if it runs
+   at 1x */
+static inline int instr_os(Instr ins){
+    uint8_t op=INSTR_OP(ins); uint16_t hi=INSTR_IMM_HI(ins);
+    if(op!=OP_TANH&&op!=OP_FOLD&&op!=OP_CLIP) return 0;
+    return hi==OS_2X||hi==OS_4X?hi:0;
+}
+
+/* An oversampled op continues the region of the instruction just before
+   it when that one is oversampled at the same factor and ins reads its
+   dst as a: it takes prev's sub-samples instead of interpolating dst
+   again, so fold -> tanh sits between one filter pair.  Its own up
+   filter slots then go unused; it still decimates into its own dst. */
+static inline int instr_os_continues(Instr prev, Instr ins){
+    int os=instr_os(ins);
+    return os&&instr_os(prev)==os&&INSTR_SRC_A(ins)==INSTR_DST(prev);
+}
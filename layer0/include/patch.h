@@ -12,14 +12,19 @@ extern "C" {
 #define REG_ONE   3   /* constant 1.0        */
 #define REG_FREE  4   /* first free register */
 
-/* Discrete constant tables (runtime-initialized by tables_init()) */
-extern float g_freq[128];    /* MIDI 0-127 -> Hz, equal temperament A4=440 */
-extern float g_cutoff[64];   /* 20 Hz .. 20000 Hz, 64 log steps             */
-extern float g_env[32];      /* 1ms .. 4s,  32 log steps                    */
-extern const float g_mod[32];/* 0.0 .. 1.0, 32 linear steps                 */
-extern const float g_dur[7]; /* 1/64 1/32 1/16 1/8 1/4 1/2 1 beat           */
-
-/* Program: flat array of instructions */
+/* Discrete constant tables (read-only literals; see tables.c) */
+extern const float g_freq[128];  /* MIDI 0-127 -> Hz, equal temperament A4=440 */
+extern const float g_cutoff[64]; /* 20 Hz .. 20000 Hz, 64 log steps             */
+extern const float g_env[32];    /* 1ms .. 4s,  32 log steps                    */
+extern const float g_mod[32];    /* 0.0 .. 1.0, 32 linear steps                 */
+extern const float g_dur[7];     /* 1/64 1/32 1/16 1/8 1/4 1/2 1 beat           */
+
+/* Program: flat array of instructions.
+   n_regs/n_state declare the footprint: every register index and state
+   slot the program touches is below them (PatchBuilder keeps them
+   exact; patch_validate() and the assembler check them).  Note-on
+   clears only the footprint, which it scans from the code rather than
+   trusting the declaration; n_regs==0 means "undeclared".              */
 typedef struct {
     Instr code[MAX_INSTRS];
     int   n_instrs;
@@ -27,32 +32,93 @@ typedef struct {
     int   n_state;
 } PatchProgram;
 
-/* Per-voice execution state */
+/* Per-voice capacity.  The defaults fit any program; builds whose
+   patches are small can shrink every voice to match, e.g.
+   -DPATCH_REGS=32 -DPATCH_STATE=64 gives a ~400 byte PatchState.
+   Programs with a larger footprint are refused at note-on/prepare. */
+#ifndef PATCH_REGS
+#define PATCH_REGS  MAX_REGS
+#endif
+#ifndef PATCH_STATE
+#define PATCH_STATE MAX_STATE
+#endif
+
+/* Per-voice execution state (hot scalars first, then the footprint
+   prefix of regs[] — only n_regs/n_state entries are ever touched) */
 typedef struct {
-    float    regs[MAX_REGS];
-    float    state[MAX_STATE]; /* persistent between step() calls */
     float    note_freq;
     float    note_vel;
     float    note_time;
     float    sr;
     float    dt;
     uint32_t rng;
+    float    regs[PATCH_REGS];
+    float    state[PATCH_STATE]; /* persistent between step() calls */
 } PatchState;
 
+/* Decoded instruction: operands unpacked, table lookups and
+   coefficient math (filter coefs, envelope times, mod depths) done */
+typedef struct {
+    uint8_t  op, dst, a, b;
+    uint16_t sb;        /* state offset */
+    uint8_t  c;         /* third source, when op_reads() bit2 */
+    float    k[4];      /* per-opcode constants */
+} DInstr;
+
+/* Prepared program: decoded once per (program, sample rate) by
+   patch_prepare() and shared read-only by every voice playing it.
+   Keeps a pointer to the source program, which must outlive it. */
+typedef struct {
+    DInstr              code[MAX_INSTRS];
+    int                 n_instrs;   /* up to and including the first OUT */
+    int                 n_regs, n_state;  /* footprint, from a full scan */
+    int                 block_ok;   /* eligible for the block engine     */
+    uint16_t            env_sb[MAX_INSTRS]; /* state offset of each ADSR */
+    int                 n_envs;
+    float               sr, dt;
+    const PatchProgram *src;
+    const void         *jit;        /* native block code (patch_jit.h)   */
+} PreparedProgram;
+
 /* Patch = program + state */
 typedef struct {
-    const PatchProgram *prog;
-    PatchState          st;
+    const PatchProgram    *prog;
+    const PreparedProgram *prep;   /* NULL: decode on the fly */
+    PatchState             st;
 } Patch;
 
+/* No-op: the tables are constant data.  Kept for existing callers. */
 void  tables_init(void);
+/* Start a note.  Only the program's register/state footprint is reset.
+   A program that does not fit PATCH_REGS/PATCH_STATE leaves the patch
+   unplayable (patch_step() returns -1). */
 void  patch_note_on(Patch *p, const PatchProgram *prog,
                     float sr, int midi, float vel);
+/* Decode prog once for sample rate sr; patches started with
+   patch_note_on_prepared() then skip the per-note decode.  Returns -1
+   if the program does not fit PATCH_REGS/PATCH_STATE. */
+int   patch_prepare(PreparedProgram *pp, const PatchProgram *prog, float sr);
+void  patch_note_on_prepared(Patch *p, const PreparedProgram *pp,
+                             int midi, float vel);
+/* Gate: patch_note_off() moves every envelope into its release stage;
+   O(#envelopes) with a prepared program.  patch_done() returns 1 once
+   every envelope has finished releasing, 0 while any is still sounding
+   and -1 when the program has no envelope to tell by. */
+void  patch_note_off(Patch *p);
+int   patch_done(const Patch *p);
+/* Render n samples.  patch_step() uses the block engine when the program
+   allows it (bit-identical output); patch_step_scalar() always runs the
+   per-sample reference interpreter, for regression checks. */
 int   patch_step(Patch *p, float *out, int n);
+int   patch_step_scalar(Patch *p, float *out, int n);
 void  patch_reset(Patch *p);
 float freq_from_midi(int m);
 float env_time(int i);
 float cutoff_hz(int i);
+/* Continuous parameters: fractional table index (0..31 / 0..63),
+   interpolated between entries and clamped to the table's range. */
+float env_time_f(float x);
+float cutoff_hz_f(float x);
 
 #ifdef __cplusplus
 }
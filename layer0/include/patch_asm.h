@@ -0,0 +1,72 @@
+#pragma once
+#include "patch.h"
+#include <stdio.h>
+/*
+ * SHMC Layer 0 — text assembler / disassembler for the patch ISA
+ *
+ * One instruction per line, operands separated by blanks or commas,
+ * ';' starts a comment:
+ *
+ *   PATCH pluck                  ; begins a patch (optional for one)
+ *   SAMPLE_RATE 48000            ; passed to the caller
+ *   REGISTERS 12                 ; register footprint; error if exceeded
+ *   STATES    8                  ; state slot limit; error if exceeded
+ *   REG  fb                      ; declare a name before its first write
+ *       ADSR   env  2ms 150ms 0.5 300ms
+ *       SAW    osc  one blep
+ *       LPF    flt  osc 1200Hz
+ *       MUL    o    flt env
+ *       OUT    o
+ *   END
+ *
+ * The first operand is the destination (OUT has none).  Registers are
+ * rN, the reserved freq / vel / time / one, or names: writing a new name
+ * allocates a register, writing it again reuses it (so a name read
+ * before its write is feedback and must be declared with REG).
+ *
+ * Immediates are written in their decoded units and snapped to the
+ * nearest table entry: cutoff "1200Hz" / "1.2kHz" (g_cutoff), times
+ * "35ms" / "0.5s" (g_env), plain numbers for depths, mixes, sustain and
+ * BPF damping (g_mod), EXP_DECAY rate (1/s), ONEPOLE coefficient,
+ * RAND_STEP period (samples) and CONST values (Q8.8, truncated as
+ * pb_const_f() does).  "#N" gives any immediate as its raw field value.
+ * Mode words follow the operands: poly / recur (math tier), blep
+ * (oscillators), 2x / 4x (oversampling), lp / bp / hp / notch (SVF).
+ * ".word 0x..." emits a raw 64-bit instruction.
+ *
+ * patch_disasm() prints a program in this syntax.  Every line reassembles
+ * to the same word; anything the syntax cannot express (stray bits in
+ * unused fields) is printed as .word, so disassemble + assemble is an
+ * exact round trip.
+ *
+ * Single pass, no allocation: a bank of thousands of patches assembles
+ * in milliseconds.
+ */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    int  line;                  /* 1-based line of the error, 0 if none */
+    char msg[96];
+} PatchAsmError;
+
+/* Called once per finished patch; a nonzero return stops assembly.
+   name is "" for a source without PATCH; sr is 0 without SAMPLE_RATE. */
+typedef int (*PatchAsmFn)(void *user, const char *name,
+                          const PatchProgram *prog, float sr);
+
+/* Assemble every patch in src[0..len).  Returns the number of patches,
+   or -1 on the first error (err, optional, says where).  Thread-safe,
+   but not reentrant: fn must not assemble (patch_asm_bank/patch_asm). */
+int  patch_asm_bank(const char *src, size_t len, PatchAsmFn fn, void *user,
+                    PatchAsmError *err);
+/* Exactly one patch; returns 0 or -1 */
+int  patch_asm(const char *src, size_t len, PatchProgram *out, PatchAsmError *err);
+
+/* Print prog; with a name it is wrapped in PATCH name ... END */
+void patch_disasm(FILE *f, const char *name, const PatchProgram *prog);
+
+#ifdef __cplusplus
+}
+#endif
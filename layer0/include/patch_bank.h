@@ -0,0 +1,72 @@
+#pragma once
+#include "patch.h"
+/*
+ * SHMC Layer 0 — SoA voice bank
+ *
+ * Runs BANK_LANES voices of one PreparedProgram in lockstep.  Registers
+ * and state are stored [index][lane], so every instruction is a single
+ * vector operation across all lanes and the instruction stream is
+ * decoded once per sample for the whole bank instead of once per voice.
+ *
+ * Kernels use GCC vector extensions: the same source compiles to SSE,
+ * AVX2 or AVX-512 depending on -m flags, and to scalar code elsewhere.
+ * Each lane is bit-identical to a scalar Patch playing the same note.
+ *
+ * Usage:
+ *   PatchBank bk; bank_init(&bk, &prepared);
+ *   int lane = bank_note_on(&bk, 60, 0.8f);
+ *   bank_step(&bk, out, AUDIO_BLOCK);      // mix of all active lanes
+ *   bank_note_off(&bk, 60);
+ */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* One native vector per lane group: 4 (SSE), 8 (AVX), 16 (AVX-512) */
+#ifndef BANK_LANES
+#if defined(__AVX512F__)
+#define BANK_LANES 16
+#elif defined(__AVX__)
+#define BANK_LANES 8
+#else
+#define BANK_LANES 4
+#endif
+#endif
+
+typedef float    bank_vf __attribute__((vector_size(BANK_LANES*4)));
+typedef int32_t  bank_vi __attribute__((vector_size(BANK_LANES*4)));
+typedef uint32_t bank_vu __attribute__((vector_size(BANK_LANES*4)));
+
+typedef struct {
+    bank_vf  regs[PATCH_REGS];
+    bank_vf  state[PATCH_STATE];
+    bank_vf  note_freq, note_vel, note_time;
+    bank_vu  rng;
+    const PreparedProgram *pp;
+    float    dt;
+    uint32_t active;              /* lane bitmask: voice allocated   */
+    uint32_t released;            /* lane bitmask: note-off received */
+    uint32_t age[BANK_LANES];     /* note-on serial, for stealing    */
+    uint8_t  pitch[BANK_LANES];
+    uint32_t serial;
+} PatchBank;
+
+/* Returns -1 (and leaves the bank unplayable) if pp was not prepared
+   successfully. */
+int  bank_init(PatchBank *bk, const PreparedProgram *pp);
+/* Start a note on a free lane.  When all lanes are busy the oldest
+   released lane is stolen, else the oldest lane.  Returns the lane.   */
+int  bank_note_on(PatchBank *bk, int midi, float vel);
+/* Release every lane playing midi.  Released lanes are reclaimed once
+   all their envelopes reach the end of the release stage.            */
+void bank_note_off(PatchBank *bk, int midi);
+void bank_release_lane(PatchBank *bk, int lane);
+int  bank_active(const PatchBank *bk);
+/* Render n samples: bank_step() writes the mix of active lanes,
+   bank_step_lanes() writes out[n*BANK_LANES] one column per lane.     */
+int  bank_step(PatchBank *bk, float *out, int n);
+int  bank_step_lanes(PatchBank *bk, float *out, int n);
+
+#ifdef __cplusplus
+}
+#endif
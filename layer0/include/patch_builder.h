@@ -10,17 +10,23 @@
  *   PatchProgram prog = *pb_finish(&pb);
  */
 
-typedef struct { PatchProgram prog; int rc; int ok; } PatchBuilder;
+typedef struct { PatchProgram prog; int rc; int ok; int os; } PatchBuilder;
 
 static inline void pb_init(PatchBuilder *b) {
     b->prog.n_instrs=0; b->prog.n_state=0; b->prog.n_regs=REG_FREE;
-    b->rc=REG_FREE; b->ok=0;
+    b->rc=REG_FREE; b->ok=0; b->os=OS_1X;
 }
+/* Oversampling (OS_1X / OS_2X / OS_4X) for the tanh/clip/fold ops emitted after */
+static inline void pb_oversample(PatchBuilder *b, int os) { b->os=os; }
 static inline int pb_reg(PatchBuilder *b) {
     if(b->rc>=MAX_REGS){b->ok=-1;return 0;} return b->rc++;
 }
 static inline void pb_emit(PatchBuilder *b, Instr ins) {
     if(b->prog.n_instrs>=MAX_INSTRS){b->ok=-1;return;}
+    /* state is allocated densely, in program order */
+    int sl=instr_state_slots(ins);
+    if(b->prog.n_state+sl>MAX_STATE){b->ok=-1;return;}
+    b->prog.n_state+=sl;
     b->prog.code[b->prog.n_instrs++]=ins;
 }
 /* --- const --- */
@@ -35,13 +41,19 @@ static inline int pb_const_f(PatchBuilder *b, float v) {
 static inline int pb_add(PatchBuilder *b,int a,int c){int d=pb_reg(b);pb_emit(b,INSTR_PACK(OP_ADD,d,a,c,0,0));return d;}
 static inline int pb_sub(PatchBuilder *b,int a,int c){int d=pb_reg(b);pb_emit(b,INSTR_PACK(OP_SUB,d,a,c,0,0));return d;}
 static inline int pb_mul(PatchBuilder *b,int a,int c){int d=pb_reg(b);pb_emit(b,INSTR_PACK(OP_MUL,d,a,c,0,0));return d;}
+static inline int pb_div(PatchBuilder *b,int a,int c){int d=pb_reg(b);pb_emit(b,INSTR_PACK(OP_DIV,d,a,c,0,0));return d;}
 static inline int pb_neg(PatchBuilder *b,int a)      {int d=pb_reg(b);pb_emit(b,INSTR_PACK(OP_NEG,d,a,0,0,0));return d;}
 static inline int pb_abs(PatchBuilder *b,int a)      {int d=pb_reg(b);pb_emit(b,INSTR_PACK(OP_ABS,d,a,0,0,0));return d;}
 /* --- oscillators --- */
 static inline int pb_osc   (PatchBuilder *b,int rm){int d=pb_reg(b);pb_emit(b,INSTR_PACK(OP_OSC,   d,rm,0,0,0));return d;}
+static inline int pb_osc_q (PatchBuilder *b,int rm,int tier){int d=pb_reg(b);pb_emit(b,INSTR_PACK(OP_OSC,d,rm,0,0,tier));return d;}
 static inline int pb_saw   (PatchBuilder *b,int rm){int d=pb_reg(b);pb_emit(b,INSTR_PACK(OP_SAW,   d,rm,0,0,0));return d;}
 static inline int pb_square(PatchBuilder *b,int rm){int d=pb_reg(b);pb_emit(b,INSTR_PACK(OP_SQUARE,d,rm,0,0,0));return d;}
 static inline int pb_tri   (PatchBuilder *b,int rm){int d=pb_reg(b);pb_emit(b,INSTR_PACK(OP_TRI,   d,rm,0,0,0));return d;}
+/* Band-limited (OSC_BLEP) variants */
+static inline int pb_saw_bl   (PatchBuilder *b,int rm){int d=pb_reg(b);pb_emit(b,INSTR_PACK(OP_SAW,   d,rm,0,0,OSC_BLEP));return d;}
+static inline int pb_square_bl(PatchBuilder *b,int rm){int d=pb_reg(b);pb_emit(b,INSTR_PACK(OP_SQUARE,d,rm,0,0,OSC_BLEP));return d;}
+static inline int pb_tri_bl   (PatchBuilder *b,int rm){int d=pb_reg(b);pb_emit(b,INSTR_PACK(OP_TRI,   d,rm,0,0,OSC_BLEP));return d;}
 /* --- modulation --- */
 static inline int pb_fm(PatchBuilder *b,int rm,int rmod,int di){
     int d=pb_reg(b);pb_emit(b,INSTR_PACK(OP_FM,d,rm,rmod,(uint16_t)di,0));return d;}
@@ -51,14 +63,18 @@ static inline int pb_am(PatchBuilder *b,int rc,int rmod,int di){
 static inline int pb_noise   (PatchBuilder *b)     {int d=pb_reg(b);pb_emit(b,INSTR_PACK(OP_NOISE,   d,0,0,0,0));return d;}
 static inline int pb_lp_noise(PatchBuilder *b,int ci){int d=pb_reg(b);pb_emit(b,INSTR_PACK(OP_LP_NOISE,d,0,0,(uint16_t)ci,0));return d;}
 /* --- nonlinearities --- */
-static inline int pb_tanh(PatchBuilder *b,int a){int d=pb_reg(b);pb_emit(b,INSTR_PACK(OP_TANH,d,a,0,0,0));return d;}
-static inline int pb_clip(PatchBuilder *b,int a){int d=pb_reg(b);pb_emit(b,INSTR_PACK(OP_CLIP,d,a,0,0,0));return d;}
-static inline int pb_fold(PatchBuilder *b,int a){int d=pb_reg(b);pb_emit(b,INSTR_PACK(OP_FOLD,d,a,0,0,0));return d;}
+static inline int pb_tanh(PatchBuilder *b,int a){int d=pb_reg(b);pb_emit(b,INSTR_PACK(OP_TANH,d,a,0,b->os,0));return d;}
+static inline int pb_tanh_q(PatchBuilder *b,int a,int tier){int d=pb_reg(b);pb_emit(b,INSTR_PACK(OP_TANH,d,a,0,b->os,tier));return d;}
+static inline int pb_clip(PatchBuilder *b,int a){int d=pb_reg(b);pb_emit(b,INSTR_PACK(OP_CLIP,d,a,0,b->os,0));return d;}
+static inline int pb_fold(PatchBuilder *b,int a){int d=pb_reg(b);pb_emit(b,INSTR_PACK(OP_FOLD,d,a,0,b->os,0));return d;}
 /* --- filters --- */
 static inline int pb_lpf(PatchBuilder *b,int a,int ci){int d=pb_reg(b);pb_emit(b,INSTR_PACK(OP_LPF,d,a,0,(uint16_t)ci,0));return d;}
 static inline int pb_hpf(PatchBuilder *b,int a,int ci){int d=pb_reg(b);pb_emit(b,INSTR_PACK(OP_HPF,d,a,0,(uint16_t)ci,0));return d;}
 static inline int pb_bpf(PatchBuilder *b,int a,int ci,int qi){
     int d=pb_reg(b);pb_emit(b,INSTR_PACK(OP_BPF,d,a,0,(uint16_t)ci,(uint16_t)qi));return d;}
+/* TPT state-variable filter: cutoff (Hz) and Q are registers, mode is SVF_* */
+static inline int pb_svf(PatchBuilder *b,int a,int cut,int q,int mode){
+    int d=pb_reg(b);pb_emit(b,INSTR_PACK(OP_SVF,d,a,cut,(uint16_t)(uint8_t)q,(uint16_t)mode));return d;}
 /* --- envelope --- */
 static inline int pb_adsr(PatchBuilder *b,int att,int dec,int sus,int rel){
     int d=pb_reg(b);
@@ -67,6 +83,8 @@ static inline int pb_adsr(PatchBuilder *b,int att,int dec,int sus,int rel){
     pb_emit(b,INSTR_PACK(OP_ADSR,d,0,0,hi,lo)); return d;}
 static inline int pb_exp_decay(PatchBuilder *b,int ri){
     int d=pb_reg(b);pb_emit(b,INSTR_PACK(OP_EXP_DECAY,d,0,0,(uint16_t)ri,0));return d;}
+static inline int pb_exp_decay_q(PatchBuilder *b,int ri,int tier){
+    int d=pb_reg(b);pb_emit(b,INSTR_PACK(OP_EXP_DECAY,d,0,0,(uint16_t)ri,tier));return d;}
 /* --- utility --- */
 static inline int pb_mix(PatchBuilder *b,int a,int c,int wa,int wb){
     int d=pb_reg(b);pb_emit(b,INSTR_PACK(OP_MIXN,d,a,c,(uint16_t)wa,(uint16_t)wb));return d;}
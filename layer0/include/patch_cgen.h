@@ -0,0 +1,40 @@
+#pragma once
+#include "patch.h"
+#include <stdio.h>
+/*
+ * SHMC Layer 0 — ahead-of-time C code generator
+ *
+ * Emits a PatchProgram as a specialized C render function with every
+ * opcode inlined, registers in locals, and every table lookup and
+ * coefficient (cutoffs, envelope times, mod depths, dt) baked in as an
+ * exact hex-float literal for a fixed sample rate.  Programs the block
+ * engine accepts become a chunk loop of short sample loops, cut after
+ * each stateful op, with oversampled ops run per chunk; others become
+ * one straight-line sample loop.  The generated file includes src/patch_dsp.h, so the DSP helpers
+ * are the interpreter's own; built with -ffp-contract=off, output is
+ * bit-identical to patch_step_scalar().
+ *
+ * Usage (build time):
+ *   patch_cgen_begin(f, 44100.f);
+ *   patch_cgen(f, &prog, "lead_render", 44100.f);
+ * Run time:
+ *   patch_note_on(&voice, &prog, 44100.f, 60, 0.8f);
+ *   lead_render(&voice.st, out, n);
+ */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Generated function: n samples into out, advancing ps exactly like
+   patch_step_scalar() on a voice started with patch_note_on() */
+typedef void (*PatchRenderFn)(PatchState *ps, float *out, int n);
+
+/* File prologue: banner and includes */
+void patch_cgen_begin(FILE *f, float sr);
+/* Emit `void name(PatchState*, float*, int)`.  Returns 0, or -1 if the
+   program is larger than MAX_INSTRS. */
+int  patch_cgen(FILE *f, const PatchProgram *prog, const char *name, float sr);
+
+#ifdef __cplusplus
+}
+#endif
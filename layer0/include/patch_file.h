@@ -0,0 +1,136 @@
+#pragma once
+#include "patch.h"
+/*
+ * SHMC Layer 0 — binary patch / sequence library
+ *
+ * One file holds any number of named entries: patches (the 64-bit Instr
+ * words of a PatchProgram plus its footprint) and voice sequences (the
+ * 32-bit VInstr words of a layer 1 VoiceProgram).  Layout, all integers
+ * little-endian and every field naturally aligned:
+ *
+ *   PfHeader                      32 bytes
+ *   payloads                      each at an 8-byte aligned offset
+ *   PfEntry[n_entries]            48 bytes each, at table_off
+ *
+ * The header carries an FNV-1a checksum of itself and the entry table,
+ * each entry one of its payload.  Opening a file (pf_open() maps it
+ * read-only, pf_view() wraps memory the caller owns) checks the header,
+ * the table checksum and that every payload lies inside the file: O(entries),
+ * no payload is read.  An entry's checksum and contents are verified
+ * when it is fetched, so a library of thousands of patches opens at
+ * once and the pages of unused entries are never touched.  Mapped files
+ * are shared by every process that opens them.
+ *
+ * pf_patch_code() returns the Instr words in place; pf_patch_load()
+ * also validates them (patch_validate()) and copies them into a
+ * PatchProgram for the engines.  Voice entries are validated by layer 1
+ * (voice_load()).
+ *
+ * Usage:
+ *   PfWriter w; pf_writer_init(&w, buf, sizeof buf);
+ *   pf_add_patch(&w, "pad", &prog);  ...  size_t n = pf_finish(&w);
+ *   fwrite(buf, 1, n, f);
+ *
+ *   PatchFile lib; pf_open(&lib, "patches.shmc");
+ *   pf_patch_load(&lib, pf_find(&lib, "pad"), &prog);
+ */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PF_MAGIC   "SHMC"
+#define PF_VERSION 1
+#define PF_NAME    24           /* entry name, NUL-padded */
+
+enum { PF_PATCH=1, PF_VOICE=2 };
+
+/* Error codes (all negative) */
+enum {
+    PF_OK=0,
+    PF_E_IO      = -1,          /* open / stat / mmap failed          */
+    PF_E_FORMAT  = -2,          /* bad magic, header size or alignment */
+    PF_E_VERSION = -3,
+    PF_E_CHECKSUM= -4,
+    PF_E_BOUNDS  = -5,          /* payload or table outside the file  */
+    PF_E_ENTRY   = -6,          /* no such entry, or wrong kind       */
+    PF_E_OPCODE  = -7,          /* unknown opcode                     */
+    PF_E_REG     = -8,          /* register outside the footprint     */
+    PF_E_STATE   = -9,          /* state slot outside the footprint   */
+    PF_E_OPERAND = -10,         /* table index or count out of range  */
+    PF_E_FULL    = -11,         /* writer buffer too small            */
+};
+
+typedef struct {
+    char     magic[4];
+    uint16_t version;
+    uint16_t hdr_size;          /* sizeof(PfHeader)                   */
+    uint32_t n_entries;
+    uint32_t table_sum;         /* FNV-1a of header (this field 0) + table */
+    uint64_t table_off;
+    uint64_t file_size;
+} PfHeader;
+
+typedef struct {
+    char     name[PF_NAME];
+    uint32_t kind;              /* PF_PATCH / PF_VOICE                */
+    uint32_t n;                 /* payload words                      */
+    uint64_t off;
+    uint16_t n_regs, n_state;   /* patches: footprint                 */
+    uint32_t sum;               /* FNV-1a of the payload              */
+} PfEntry;
+
+_Static_assert(sizeof(PfHeader)==32 && sizeof(PfEntry)==48, "PatchFile layout");
+
+typedef struct {
+    const uint8_t *base;
+    size_t         size;
+    const PfEntry *ent;
+    int            n;
+    void          *map;         /* pf_open() mapping, or NULL         */
+} PatchFile;
+
+/* Builds a file in a caller buffer: payloads grow up from the header,
+   entries down from the end until pf_finish() moves them into place. */
+typedef struct {
+    uint8_t *buf;
+    size_t   cap, used;
+    int      n;
+    int      err;               /* first error, sticky                */
+} PfWriter;
+
+/* ---- Validation ----
+   Checks every instruction: known opcode, table indices in range, and
+   registers / state slots inside PATCH_REGS / PATCH_STATE and inside
+   the declared footprint (n_regs/n_state; 0 means "unknown": only the
+   build limits apply).  Returns 0 or a PF_E_* code; *fp_regs and *fp_state
+   (optional) receive the scanned footprint. */
+int  patch_validate_code(const Instr *code, int n, int n_regs, int n_state,
+                         int *fp_regs, int *fp_state);
+int  patch_validate(const PatchProgram *prog);
+
+/* ---- Writing ---- */
+void   pf_writer_init(PfWriter *w, void *buf, size_t cap);
+/* Returns the entry index or a PF_E_* code; invalid patches are refused */
+int    pf_add_patch(PfWriter *w, const char *name, const PatchProgram *prog);
+int    pf_add_voice(PfWriter *w, const char *name, const uint32_t *code, int n);
+/* Size of the finished file, or 0 if any add failed */
+size_t pf_finish(PfWriter *w);
+
+/* ---- Reading ---- */
+/* buf must be 8-byte aligned and outlive f */
+int    pf_view(PatchFile *f, const void *buf, size_t size);
+int    pf_open(PatchFile *f, const char *path);
+void   pf_close(PatchFile *f);
+/* Entry index by name, or PF_E_ENTRY */
+int    pf_find(const PatchFile *f, const char *name);
+/* Payload words of entry i, in place, after checking its kind and
+   checksum; NULL on error (*err, optional, gets the code) */
+const Instr    *pf_patch_code(const PatchFile *f, int i, int *n, int *err);
+const uint32_t *pf_voice_code(const PatchFile *f, int i, int *n, int *err);
+/* Validated copy into a PatchProgram */
+int    pf_patch_load(const PatchFile *f, int i, PatchProgram *out);
+const char *pf_strerror(int err);
+
+#ifdef __cplusplus
+}
+#endif
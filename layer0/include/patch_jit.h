@@ -0,0 +1,36 @@
+#pragma once
+#include "patch.h"
+/*
+ * SHMC Layer 0 — native x86-64 backend
+ *
+ * Compiles a PreparedProgram into a native block function that
+ * patch_step() runs instead of the kernel dispatch loop.  Stateless
+ * arithmetic (CONST ADD SUB MUL DIV NEG ABS AM MIXN) is emitted inline
+ * as SSE code, fully unrolled over the AUDIO_BLOCK register buffers;
+ * every other opcode becomes a direct call to its block kernel.  Output
+ * is bit-identical to the interpreter.
+ *
+ * Compiled code is cached by a hash of the program's instructions, so
+ * preparing the same program again (at any sample rate) reuses it.
+ *
+ * Usage:
+ *   patch_prepare(&pp, &prog, 44100.f);
+ *   patch_jit(&pp);                    // optional; -1 = interpreter
+ *   patch_note_on_prepared(&voice, &pp, 60, 0.8f);
+ */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Attach native code to pp.  Returns 0, or -1 when pp keeps using the
+   interpreter: not x86-64/POSIX, the program is not block-eligible or
+   uses an opcode the backend does not know, or the cache is full.
+   Not thread-safe; compile from the thread that prepares programs. */
+int  patch_jit(PreparedProgram *pp);
+/* Unmap all cached code.  Every PreparedProgram compiled so far must be
+   re-prepared (or have pp->jit cleared) before it is played again. */
+void patch_jit_clear(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,43 @@
+#pragma once
+#include "patch.h"
+/*
+ * SHMC Layer 0 — PatchProgram optimizer
+ *
+ * Rewrites a program into an equivalent, smaller one:
+ *   - constant folding (results that CONST can encode exactly) and
+ *     identities: x*1, AM with zero depth
+ *   - common-subexpression elimination of stateless ops
+ *   - dead-instruction elimination: everything after the first OUT and
+ *     stateful ops whose output is unused (ADSR and RNG draws are kept —
+ *     they drive patch_done() and the shared noise sequence)
+ *   - linear-scan register compaction, lowest free register first
+ *
+ * The result renders bit-identically to the source on every engine.
+ *
+ * Usage:
+ *   PatchOptStats st; PatchProgram opt;
+ *   patch_optimize(&opt, &prog, &st);
+ *   printf("%d -> %d instrs\n", st.instrs_before, st.instrs_after);
+ */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    int instrs_before, instrs_after;
+    int regs_before,   regs_after;
+    int state_before,  state_after;
+    int folded;                   /* ops replaced by CONST or an operand */
+    int cse;                      /* ops merged into an earlier one      */
+} PatchOptStats;
+
+/* dst may equal src.  Returns 0, or -1 when the program cannot be
+   rewritten safely (no OUT, a register read before it is written —
+   i.e. feedback across samples — a write to a reserved register, or
+   more than MAX_INSTRS instructions); dst is then a verbatim copy.
+   st may be NULL.                                                     */
+int patch_optimize(PatchProgram *dst, const PatchProgram *src, PatchOptStats *st);
+
+#ifdef __cplusplus
+}
+#endif
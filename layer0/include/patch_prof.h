@@ -0,0 +1,58 @@
+#pragma once
+#include "patch.h"
+#include <stdio.h>
+/*
+ * SHMC Layer 0 — per-instruction profiling of the interpreter
+ *
+ * Build with -DSHMC_PROFILE (make DEFS=-DSHMC_PROFILE) and exec1() /
+ * exec_block() time every instruction they run: an execution count (in
+ * samples) and ticks (rdtsc on x86-64, clock_gettime ns elsewhere) per
+ * instruction of each program, summed per opcode and per program in
+ * the report.  Without the flag the hooks are empty macros and none of
+ * this is compiled into the engines; the functions below still exist and
+ * report nothing, so tools call them unconditionally.
+ *
+ * Profiling builds run prepared programs through the block kernels even
+ * when they have native code (patch_jit()), so that every instruction is
+ * attributed; output is unchanged.  PatchBank voices are not profiled.
+ * Timing an instruction costs two tick reads, which dominates the
+ * cheapest ops: compare counts and ticks between opcodes and patches,
+ * not against unprofiled benchmarks.
+ *
+ * Programs are told apart by address.  Counters are updated atomically,
+ * so renders on several threads (layer 1 mixer) are counted too.
+ *
+ * Usage:
+ *   patch_prof_reset();
+ *   patch_prof_name(&prog, "pad");
+ *   ... render ...
+ *   patch_prof_report(stdout, 20);
+ */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PROF_PROGRAMS 32            /* distinct programs tracked */
+
+typedef struct {
+    uint64_t count;                 /* samples the instruction(s) ran for */
+    uint64_t ticks;
+} PatchProfStat;
+
+/* 1 in a -DSHMC_PROFILE build */
+int  patch_prof_enabled(void);
+/* Forget every program and counter */
+void patch_prof_reset(void);
+/* Label prog in the report (otherwise "prog#N") */
+void patch_prof_name(const PatchProgram *prog, const char *name);
+/* Totals for one opcode over every program; for one program (samples
+   rendered, ticks over all its instructions); 0 if not profiled */
+int  patch_prof_op(int op, PatchProfStat *st);
+int  patch_prof_program(const PatchProgram *prog, PatchProfStat *st);
+/* Hotspot table: opcodes and programs by ticks, then the top
+   instructions (top <= 0: all) */
+void patch_prof_report(FILE *f, int top);
+
+#ifdef __cplusplus
+}
+#endif
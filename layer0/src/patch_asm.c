@@ -0,0 +1,475 @@
+/*
+ * SHMC Layer 0 — text assembler / disassembler for the patch ISA
+ *
+ * Each opcode has one row in SYN[]: its mnemonic, the kind of each
+ * operand after the destination and the instruction field it lands in.
+ * The assembler and the disassembler both walk that row, so they cannot
+ * disagree about an encoding; patch_disasm() still reassembles every line
+ * it prints and falls back to .word when the text would not reproduce
+ * the instruction exactly.
+ */
+#include "../include/patch_asm.h"
+#include "../include/patch_builder.h"
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+
+extern const float g_cutoff[64]; extern const float g_env[32]; extern const float g_mod[32];
+
+/* ---- Operand syntax ---- */
+
+enum { K_REG=1, K_CONST, K_HZ, K_MS, K_MOD, K_BPQ, K_RATE, K_COEF, K_INT };
+enum { S_A=1, S_B, S_C, S_HI, S_LO, S_ATT, S_DEC, S_SUS, S_REL };
+enum { F_TIER=1, F_RECUR=2, F_BLEP=4, F_OS=8, F_SVF=16, F_NODST=32 };
+
+typedef struct {
+    const char *name;
+    uint8_t     n, flags;
+    uint8_t     kind[4], slot[4];
+} OpSyntax;
+
+#define R1 1,0,{K_REG},{S_A}
+#define R2 2,0,{K_REG,K_REG},{S_A,S_B}
+static const OpSyntax SYN[OP_COUNT]={
+    [OP_CONST]    ={"CONST",    1,0,{K_CONST},{S_HI}},
+    [OP_ADD]      ={"ADD",      R2}, [OP_SUB]={"SUB",R2}, [OP_MUL]={"MUL",R2}, [OP_DIV]={"DIV",R2},
+    [OP_NEG]      ={"NEG",      R1}, [OP_ABS]={"ABS",R1},
+    [OP_OSC]      ={"OSC",      1,F_TIER,{K_REG},{S_A}},
+    [OP_SAW]      ={"SAW",      1,F_BLEP,{K_REG},{S_A}},
+    [OP_SQUARE]   ={"SQUARE",   1,F_BLEP,{K_REG},{S_A}},
+    [OP_TRI]      ={"TRI",      1,F_BLEP,{K_REG},{S_A}},
+    [OP_PHASE]    ={"PHASE",    R1},
+    [OP_FM]       ={"FM",       3,0,{K_REG,K_REG,K_MOD},{S_A,S_B,S_HI}},
+    [OP_PM]       ={"PM",       R2},
+    [OP_AM]       ={"AM",       3,0,{K_REG,K_REG,K_MOD},{S_A,S_B,S_HI}},
+    [OP_SYNC]     ={"SYNC",     R2},
+    [OP_NOISE]    ={"NOISE",    0,0,{0},{0}},
+    [OP_LP_NOISE] ={"LP_NOISE", 1,0,{K_HZ},{S_HI}},
+    [OP_RAND_STEP]={"RAND_STEP",1,0,{K_INT},{S_HI}},
+    [OP_TANH]     ={"TANH",     1,F_TIER|F_OS,{K_REG},{S_A}},
+    [OP_CLIP]     ={"CLIP",     1,F_OS,{K_REG},{S_A}},
+    [OP_FOLD]     ={"FOLD",     1,F_OS,{K_REG},{S_A}},
+    [OP_SIGN]     ={"SIGN",     R1},
+    [OP_LPF]      ={"LPF",      2,0,{K_REG,K_HZ},{S_A,S_HI}},
+    [OP_HPF]      ={"HPF",      2,0,{K_REG,K_HZ},{S_A,S_HI}},
+    [OP_BPF]      ={"BPF",      3,0,{K_REG,K_HZ,K_BPQ},{S_A,S_HI,S_LO}},
+    [OP_ONEPOLE]  ={"ONEPOLE",  2,0,{K_REG,K_COEF},{S_A,S_HI}},
+    [OP_ADSR]     ={"ADSR",     4,0,{K_MS,K_MS,K_MOD,K_MS},{S_ATT,S_DEC,S_SUS,S_REL}},
+    [OP_RAMP]     ={"RAMP",     1,0,{K_MS},{S_HI}},
+    [OP_EXP_DECAY]={"EXP_DECAY",1,F_TIER|F_RECUR,{K_RATE},{S_HI}},
+    [OP_MIN]      ={"MIN",      R2}, [OP_MAX]={"MAX",R2},
+    [OP_MIXN]     ={"MIXN",     4,0,{K_REG,K_REG,K_MOD,K_MOD},{S_A,S_B,S_HI,S_LO}},
+    [OP_OUT]      ={"OUT",      1,F_NODST,{K_REG},{S_A}},
+    [OP_SVF]      ={"SVF",      3,F_SVF,{K_REG,K_REG,K_REG},{S_A,S_B,S_C}},
+};
+static const char *RESERVED[REG_FREE]={"freq","vel","time","one"};
+static const char *SVF_MODE[4]={"lp","bp","hp","notch"};
+
+/* ---- Tokens ---- */
+
+typedef struct { const char *p; int n; } Tok;
+#define MAX_TOK 12
+
+static int tok_is(Tok t, const char *s){
+    int n=(int)strlen(s);
+    if(t.n!=n) return 0;
+    for(int i=0;i<n;i++){
+        char c=t.p[i]; if(c>='A'&&c<='Z') c+=32;
+        char d=s[i];   if(d>='A'&&d<='Z') d+=32;
+        if(c!=d) return 0;
+    }
+    return 1;
+}
+static int is_sp(char c){ return c==' '||c=='\t'||c==','||c=='\r'; }
+
+/* Split [p,e) at blanks and commas, stopping at ';'.  -1: too many. */
+static int tokenize(const char *p, const char *e, Tok *t){
+    int n=0;
+    while(p<e&&*p!=';'){
+        if(is_sp(*p)){ p++; continue; }
+        const char *s=p;
+        while(p<e&&!is_sp(*p)&&*p!=';') p++;
+        if(n==MAX_TOK) return -1;
+        t[n++]=(Tok){ s,(int)(p-s) };
+    }
+    return n;
+}
+
+/* ---- Assembler state ---- */
+
+#define SYM_N 1024                  /* open addressing, > MAX_REGS names */
+typedef struct { const char *p; int n; uint32_t gen; uint8_t reg; } Sym;
+
+typedef struct {
+    PatchBuilder  b;
+    Sym           sym[SYM_N];
+    uint32_t      gen;              /* bumping it empties the table */
+    int           open, named, regs_lim, state_lim;
+    float         sr;
+    char          name[32];
+    char         *msg;              /* error text, 96 bytes */
+} Asm;
+
+static uint32_t tok_hash(Tok t){
+    uint32_t h=2166136261u;
+    for(int i=0;i<t.n;i++){ h^=(uint8_t)t.p[i]; h*=16777619u; }
+    return h;
+}
+static Sym *sym_find(Asm *a, Tok t){
+    for(uint32_t i=tok_hash(t)&(SYM_N-1);;i=(i+1)&(SYM_N-1)){
+        Sym *s=&a->sym[i];
+        if(s->gen!=a->gen||(s->n==t.n&&!memcmp(s->p,t.p,(size_t)t.n))) return s;
+    }
+}
+
+static int fail(char *msg, const char *fmt, Tok t){
+    if(msg) snprintf(msg,96,fmt,t.n,t.p);
+    return -1;
+}
+
+/* Register operand.  With def, a new name is allocated (destination /
+   REG); a==NULL (disassembler check) accepts only rN and reserved. */
+static int reg_tok(Asm *a, Tok t, int def, char *msg){
+    for(int i=0;i<REG_FREE;i++) if(tok_is(t,RESERVED[i])) return i;
+    if(t.n>=2&&t.n<=4&&(t.p[0]=='r'||t.p[0]=='R')){
+        int v=0, i=1;
+        while(i<t.n&&t.p[i]>='0'&&t.p[i]<='9') v=v*10+(t.p[i++]-'0');
+        if(i==t.n){
+            if(v>=MAX_REGS) return fail(msg,"register out of range: %.*s",t);
+            if(a&&v>=a->b.rc) a->b.rc=v+1;
+            return v;
+        }
+    }
+    if(!a) return fail(msg,"bad register: %.*s",t);
+    if(!((t.p[0]>='a'&&t.p[0]<='z')||(t.p[0]>='A'&&t.p[0]<='Z')||t.p[0]=='_'))
+        return fail(msg,"bad register name: %.*s",t);
+    Sym *s=sym_find(a,t);
+    if(s->gen==a->gen) return s->reg;
+    if(!def) return fail(msg,"undefined register: %.*s",t);
+    if(a->b.rc>=MAX_REGS) return fail(msg,"out of registers at %.*s",t);
+    *s=(Sym){ t.p,t.n,a->gen,(uint8_t)pb_reg(&a->b) };
+    return s->reg;
+}
+
+/* Number with an optional unit suffix; *unit gets the suffix */
+static int num_tok(Tok t, double *v, Tok *unit){
+    char buf[64], *end;
+    if(t.n<=0||t.n>=(int)sizeof(buf)) return -1;
+    memcpy(buf,t.p,(size_t)t.n); buf[t.n]=0;
+    *v=strtod(buf,&end);
+    if(end==buf) return -1;
+    *unit=(Tok){ t.p+(end-buf),t.n-(int)(end-buf) };
+    return 0;
+}
+
+/* Table value of entry i for a table-indexed kind */
+static float tab(int kind, int i){
+    switch(kind){
+    case K_HZ:   return g_cutoff[i];
+    case K_MS:   return g_env[i]*1000.f;
+    case K_BPQ:  return g_mod[i]+0.1f;
+    case K_RATE: return g_mod[i]*20.f;
+    default:     return g_mod[i];
+    }
+}
+static int tab_n(int kind){ return kind==K_HZ?64:32; }
+
+/* Every table is increasing: bisect, then take the closer neighbour
+   (by ratio for the log-spaced Hz / ms tables) */
+static int nearest(int kind, double x){
+    int lo=0, hi=tab_n(kind)-1;
+    while(hi-lo>1){ int m=(lo+hi)/2; if(tab(kind,m)<=x) lo=m; else hi=m; }
+    double a=tab(kind,lo), b=tab(kind,hi);
+    if(x<=a) return lo;
+    if(x>=b) return hi;
+    return (kind==K_HZ||kind==K_MS) ? (x*x<a*b?lo:hi) : (x-a<b-x?lo:hi);
+}
+
+/* Immediate operand -> field value (CONST also sets *lo) */
+static int imm_tok(int kind, Tok t, int *lo, char *msg){
+    if(t.n>1&&t.p[0]=='#'){
+        double v; Tok u;
+        t.p++; t.n--;
+        if(num_tok(t,&v,&u)||u.n||v<0||v>65535||v!=floor(v)) return fail(msg,"bad raw immediate: #%.*s",t);
+        if(kind==K_CONST) *lo=0;
+        return (int)v;
+    }
+    double v; Tok u;
+    if(num_tok(t,&v,&u)) return fail(msg,"bad immediate: %.*s",t);
+    switch(kind){
+    case K_CONST:
+        if(u.n||v*256.0<-32768.0||v*256.0>32767.0) return fail(msg,"CONST out of Q8.8 range: %.*s",t);
+        *lo=1;
+        return (uint16_t)(int16_t)((float)v*256.f);      /* as pb_const_f() */
+    case K_HZ:
+        if(tok_is(u,"khz")) v*=1000.0;
+        else if(u.n&&!tok_is(u,"hz")) return fail(msg,"expected Hz: %.*s",t);
+        return nearest(kind,v);
+    case K_MS:
+        if(tok_is(u,"s")) v*=1000.0;
+        else if(u.n&&!tok_is(u,"ms")) return fail(msg,"expected ms or s: %.*s",t);
+        return nearest(kind,v);
+    case K_COEF:
+        if(u.n||v<0||v>1) return fail(msg,"coefficient outside 0..1: %.*s",t);
+        return (int)lrint(v*255.0)<<8;
+    case K_INT:
+        if(u.n||v<0||v>65535||v!=floor(v)) return fail(msg,"bad count: %.*s",t);
+        return (int)v;
+    default:
+        if(u.n) return fail(msg,"unexpected unit: %.*s",t);
+        return nearest(kind,v);
+    }
+}
+
+static int find_op(Tok t){
+    for(int op=0;op<OP_COUNT;op++) if(SYN[op].name&&tok_is(t,SYN[op].name)) return op;
+    return -1;
+}
+
+/* One instruction line (t[0] is the mnemonic) */
+static int asm_instr(Asm *a, const Tok *t, int nt, Instr *out, char *msg){
+    int op=find_op(t[0]);
+    if(op<0) return fail(msg,"unknown mnemonic: %.*s",t[0]);
+    const OpSyntax *sy=&SYN[op];
+    int nd=(sy->flags&F_NODST)?0:1, k=1;
+    if(nt<1+nd+sy->n) return fail(msg,"too few operands for %.*s",t[0]);
+    int f[S_REL+1]={0}, lo=0;
+    for(int i=0;i<sy->n;i++,k++){
+        Tok o=t[1+nd+i];
+        int v=sy->kind[i]==K_REG ? reg_tok(a,o,0,msg) : imm_tok(sy->kind[i],o,&lo,msg);
+        if(v<0) return -1;
+        if(sy->slot[i]>=S_ATT&&v>=32) return fail(msg,"ADSR operand out of range: %.*s",o);
+        f[sy->slot[i]]=v;
+    }
+    if(sy->kind[0]==K_CONST) f[S_LO]=lo;
+    for(k=1+nd+sy->n;k<nt;k++){         /* mode words */
+        Tok m=t[k]; int ok=0;
+        if(sy->flags&F_TIER){
+            if(tok_is(m,"ref")) { f[S_LO]=MATH_REF;  ok=1; }
+            if(tok_is(m,"poly")){ f[S_LO]=MATH_POLY; ok=1; }
+        }
+        if((sy->flags&F_RECUR)&&tok_is(m,"recur")){ f[S_LO]=MATH_RECUR; ok=1; }
+        if(sy->flags&F_BLEP){
+            if(tok_is(m,"naive")){ f[S_LO]=OSC_NAIVE; ok=1; }
+            if(tok_is(m,"blep")) { f[S_LO]=OSC_BLEP;  ok=1; }
+        }
+        if(sy->flags&F_OS){
+            if(tok_is(m,"1x")){ f[S_HI]=OS_1X; ok=1; }
+            if(tok_is(m,"2x")){ f[S_HI]=OS_2X; ok=1; }
+            if(tok_is(m,"4x")){ f[S_HI]=OS_4X; ok=1; }
+        }
+        if(sy->flags&F_SVF)
+            for(int j=0;j<4;j++) if(tok_is(m,SVF_MODE[j])){ f[S_LO]=j; ok=1; }
+        if(!ok) return fail(msg,"unexpected operand: %.*s",m);
+    }
+    int dst=0;
+    if(nd&&(dst=reg_tok(a,t[1],1,msg))<0) return -1;
+    if(op==OP_ADSR){
+        f[S_HI]=(f[S_ATT]<<10)|(f[S_DEC]<<5)|f[S_SUS];
+        f[S_LO]=f[S_REL]<<11;
+    }
+    if(op==OP_SVF) f[S_HI]=f[S_C];
+    *out=INSTR_PACK(op,dst,f[S_A],f[S_B],f[S_HI],f[S_LO]);
+    return 0;
+}
+
+static int parse_word(Tok t, Instr *w){
+    char buf[32], *end;
+    if(t.n<=0||t.n>=(int)sizeof(buf)) return -1;
+    memcpy(buf,t.p,(size_t)t.n); buf[t.n]=0;
+    *w=strtoull(buf,&end,0);
+    return *end ? -1 : 0;
+}
+
+/* Keep the builder's register count covering raw words too */
+static void emit(Asm *a, Instr ins){
+    uint8_t op=INSTR_OP(ins); int rd=op<OP_COUNT?op_reads(op):0, m=0;
+    if(op!=OP_OUT) m=INSTR_DST(ins);
+    if((rd&1)&&INSTR_SRC_A(ins)>m) m=INSTR_SRC_A(ins);
+    if((rd&2)&&INSTR_SRC_B(ins)>m) m=INSTR_SRC_B(ins);
+    if((rd&4)&&INSTR_SRC_C(ins)>m) m=INSTR_SRC_C(ins);
+    if(m>=a->b.rc) a->b.rc=m+1;
+    pb_emit(&a->b,ins);
+}
+
+static void begin(Asm *a, Tok name){
+    pb_init(&a->b);
+    a->gen++; a->open=1;
+    a->regs_lim=a->state_lim=0; a->sr=0;
+    int n=name.n<(int)sizeof(a->name)-1?name.n:(int)sizeof(a->name)-1;
+    memcpy(a->name,name.p,(size_t)n); a->name[n]=0;
+}
+
+static int finish(Asm *a, PatchAsmFn fn, void *user){
+    a->open=0;
+    if(a->b.ok<0){ snprintf(a->msg,96,"patch %s exceeds MAX_INSTRS/MAX_STATE",a->name); return -1; }
+    PatchProgram *p=pb_finish(&a->b);
+    if(a->regs_lim){
+        if(p->n_regs>a->regs_lim){ snprintf(a->msg,96,"patch %s uses %d registers, REGISTERS %d",a->name,p->n_regs,a->regs_lim); return -1; }
+        p->n_regs=a->regs_lim;
+    }
+    if(a->state_lim&&p->n_state>a->state_lim){
+        snprintf(a->msg,96,"patch %s uses %d state slots, STATES %d",a->name,p->n_state,a->state_lim); return -1;
+    }
+    if(fn&&fn(user,a->name,p,a->sr)){ snprintf(a->msg,96,"stopped by caller"); return -1; }
+    return 0;
+}
+
+static int count_arg(Tok t, int *v, char *msg){
+    double d; Tok u;
+    if(num_tok(t,&d,&u)||u.n||d<0||d>1e9) return fail(msg,"bad number: %.*s",t);
+    *v=(int)d; return 0;
+}
+
+/* ---- Public API ---- */
+
+int patch_asm_bank(const char *src, size_t len, PatchAsmFn fn, void *user,
+                   PatchAsmError *err){
+    /* ~32 KB (symbol table and builder): kept off the stack.  Per
+       thread, so fn must not assemble in turn. */
+    static _Thread_local Asm a;
+    char msg[96]={0};
+    const char *p=src, *e=src+len;
+    int line=0, n=0;
+    a.msg=msg; a.open=0; a.named=0;
+    while(p<e){
+        const char *q=memchr(p,'\n',(size_t)(e-p)); if(!q) q=e;
+        Tok t[MAX_TOK]; int nt=tokenize(p,q,t);
+        line++; p=q+1;
+        if(nt==0) continue;
+        if(nt<0){ snprintf(msg,96,"too many operands"); goto bad; }
+        int v;
+        if(tok_is(t[0],"PATCH")){
+            if(a.open){ snprintf(msg,96,"PATCH before END of %s",a.name); goto bad; }
+            if(nt!=2){ snprintf(msg,96,"PATCH takes one name"); goto bad; }
+            begin(&a,t[1]); a.named=1;
+            continue;
+        }
+        if(tok_is(t[0],"END")){
+            if(!a.open||nt!=1){ snprintf(msg,96,"END without PATCH"); goto bad; }
+            if(finish(&a,fn,user)) goto bad;
+            n++; continue;
+        }
+        if(!a.open){
+            if(a.named){ fail(msg,"%.*s outside PATCH ... END",t[0]); goto bad; }
+            begin(&a,(Tok){ "",0 });
+        }
+        if(tok_is(t[0],"SAMPLE_RATE")||tok_is(t[0],"REGISTERS")||tok_is(t[0],"STATES")){
+            if(nt!=2||count_arg(t[1],&v,msg)) { if(!msg[0]) fail(msg,"%.*s takes one number",t[0]); goto bad; }
+            if(tok_is(t[0],"SAMPLE_RATE")) a.sr=(float)v;
+            else if(tok_is(t[0],"REGISTERS")){
+                if(v>MAX_REGS){ snprintf(msg,96,"REGISTERS above %d",MAX_REGS); goto bad; }
+                a.regs_lim=v;
+            }
+            else a.state_lim=v;
+        }
+        else if(tok_is(t[0],"REG")){
+            for(int i=1;i<nt;i++){
+                if(tok_is(t[i],"freq")||tok_is(t[i],"vel")||tok_is(t[i],"time")||tok_is(t[i],"one")||
+                   sym_find(&a,t[i])->gen==a.gen){ fail(msg,"register already defined: %.*s",t[i]); goto bad; }
+                if(reg_tok(&a,t[i],1,msg)<0) goto bad;
+            }
+        }
+        else if(tok_is(t[0],".word")){
+            Instr w;
+            if(nt!=2||parse_word(t[1],&w)){ snprintf(msg,96,".word takes one integer"); goto bad; }
+            emit(&a,w);
+        }
+        else {
+            Instr w;
+            if(asm_instr(&a,t,nt,&w,msg)) goto bad;
+            emit(&a,w);
+        }
+    }
+    if(a.open){
+        if(a.named){ snprintf(msg,96,"missing END for %s",a.name); goto bad; }
+        if(finish(&a,fn,user)) goto bad;
+        n++;
+    }
+    if(err){ err->line=0; err->msg[0]=0; }
+    return n;
+bad:
+    if(err){ err->line=line; memcpy(err->msg,msg,sizeof(err->msg)); }
+    return -1;
+}
+
+typedef struct { PatchProgram *out; int n; } One;
+static int take_one(void *user, const char *name, const PatchProgram *prog, float sr){
+    One *o=(One*)user; (void)name; (void)sr;
+    if(o->n++==0) *o->out=*prog;
+    return 0;
+}
+
+int patch_asm(const char *src, size_t len, PatchProgram *out, PatchAsmError *err){
+    One o={ out,0 };
+    int n=patch_asm_bank(src,len,take_one,&o,err);
+    if(n==1) return 0;
+    if(n>=0&&err){ err->line=0; snprintf(err->msg,sizeof(err->msg),"expected one patch, found %d",n); }
+    return -1;
+}
+
+/* ---- Disassembler ---- */
+
+static int put_reg(char *s, size_t n, int r){
+    return r<REG_FREE ? snprintf(s,n,"%s",RESERVED[r]) : snprintf(s,n,"r%d",r);
+}
+
+/* Decoded immediate; CONST needs lo to tell Q8.8 from the g_mod index */
+static int put_imm(char *s, size_t n, int kind, int v, int lo){
+    switch(kind){
+    case K_CONST: {
+        if(lo!=1) return snprintf(s,n,"#%d",v);
+        int k=snprintf(s,n,"%.8f",(double)(int16_t)v/256.0);   /* exact */
+        while(k>1&&s[k-1]=='0') s[--k]=0;
+        if(s[k-1]=='.') s[--k]=0;
+        return k;
+    }
+    case K_HZ:   return v<64 ? snprintf(s,n,"%.6gHz",(double)tab(kind,v)) : snprintf(s,n,"#%d",v);
+    case K_MS:   return v<32 ? snprintf(s,n,"%.6gms",(double)tab(kind,v)) : snprintf(s,n,"#%d",v);
+    case K_COEF: return v&0xFF ? snprintf(s,n,"#%d",v) : snprintf(s,n,"%.6g",(v>>8)/255.0);
+    case K_INT:  return snprintf(s,n,"%d",v);
+    default:     return v<32 ? snprintf(s,n,"%.6g",(double)tab(kind,v)) : snprintf(s,n,"#%d",v);
+    }
+}
+
+/* Text for one instruction; the caller checks that it reassembles */
+static void dis_instr(Instr ins, char *s, size_t cap){
+    uint8_t op=INSTR_OP(ins); uint16_t hi=INSTR_IMM_HI(ins), lo=INSTR_IMM_LO(ins);
+    if(op>=OP_COUNT){ s[0]=0; return; }
+    const OpSyntax *sy=&SYN[op];
+    int f[S_REL+1]={0};
+    f[S_A]=INSTR_SRC_A(ins); f[S_B]=INSTR_SRC_B(ins); f[S_C]=INSTR_SRC_C(ins);
+    f[S_HI]=hi; f[S_LO]=lo;
+    f[S_ATT]=(hi>>10)&0x3F; f[S_DEC]=(hi>>5)&0x1F; f[S_SUS]=hi&0x1F; f[S_REL]=(lo>>11)&0x1F;
+    size_t k=(size_t)snprintf(s,cap,"    %-9s",sy->name);
+    if(!(sy->flags&F_NODST)){ s[k++]=' '; k+=(size_t)put_reg(s+k,cap-k,INSTR_DST(ins)); }
+    for(int i=0;i<sy->n&&k+1<cap;i++){
+        s[k++]=' ';
+        int v=f[sy->slot[i]];
+        k+=(size_t)(sy->kind[i]==K_REG ? put_reg(s+k,cap-k,v) : put_imm(s+k,cap-k,sy->kind[i],v,lo));
+    }
+    const char *m=NULL, *m2=NULL;
+    if((sy->flags&F_TIER)&&lo==MATH_POLY) m="poly";
+    if((sy->flags&F_RECUR)&&lo==MATH_RECUR) m="recur";
+    if((sy->flags&F_BLEP)&&lo==OSC_BLEP) m="blep";
+    if((sy->flags&F_SVF)&&lo<4) m=SVF_MODE[lo];
+    if((sy->flags&F_OS)&&(hi==OS_2X||hi==OS_4X)) m2=hi==OS_2X?"2x":"4x";
+    if(m&&k<cap)  k+=(size_t)snprintf(s+k,cap-k," %s",m);
+    if(m2&&k<cap) k+=(size_t)snprintf(s+k,cap-k," %s",m2);
+}
+
+void patch_disasm(FILE *f, const char *name, const PatchProgram *prog){
+    if(name) fprintf(f,"PATCH %s\n",name);
+    if(prog->n_regs>0) fprintf(f,"REGISTERS %d\nSTATES %d\n",prog->n_regs,prog->n_state);
+    for(int i=0;i<prog->n_instrs;i++){
+        Instr ins=prog->code[i], w=~ins;
+        char s[128]; Tok t[MAX_TOK];
+        dis_instr(ins,s,sizeof(s));
+        int nt=tokenize(s,s+strlen(s),t);
+        if(nt<=0||asm_instr(NULL,t,nt,&w,NULL)||w!=ins)
+            fprintf(f,"    .word    0x%016llx\n",(unsigned long long)ins);
+        else
+            fprintf(f,"%s\n",s);
+    }
+    if(name) fprintf(f,"END\n");
+}
@@ -0,0 +1,363 @@
+/*
+ * SHMC Layer 0 — SoA voice bank
+ *
+ * Lockstep execution of BANK_LANES voices of one PreparedProgram.
+ * Every kernel below is the lane-parallel form of the scalar helper in
+ * patch_dsp.h, written with the same operation order so each lane stays
+ * bit-identical to exec1().  Branches become compare masks + vsel().
+ */
+#include "../include/patch_bank.h"
+#include "patch_dsp.h"
+#include <string.h>
+
+/* The vector helpers are static inline; their ABI is never exposed */
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+typedef bank_vf vf;
+typedef bank_vi vi;
+typedef bank_vu vu;
+
+/* ---- Vector helpers ---- */
+#define LANEWISE(d,expr) do{ for(int l=0;l<BANK_LANES;l++) (d)[l]=(expr); }while(0)
+static inline vf vsplat(float x){ vf v={0}; return v+x; }
+static inline vf vsel(vi m, vf a, vf b){ return (vf)((m&(vi)a)|(~m&(vi)b)); }
+static inline vf vabs(vf x){ return (vf)((vi)x&0x7FFFFFFF); }
+static inline vf vfloor(vf x){
+    vf t=__builtin_convertvector(__builtin_convertvector(x,vi),vf);
+    return vsel(t>x,t-1.f,t);
+}
+static inline vf vmin(vf a, vf b){ return vsel((a<b)|(b!=b),a,b); }
+static inline vf vmax(vf a, vf b){ return vsel((a>b)|(b!=b),a,b); }
+
+static inline vf vrng(vu *s){
+    vu x=*s; x^=x<<13; x^=x>>17; x^=x<<5; *s=x;
+    return __builtin_convertvector((vi)x,vf)*(1.f/2147483648.f);
+}
+static inline vf vosc_tick(vf *ph, vf freq, float dt){
+    vf p=*ph; *ph+=TWO_PI*freq*dt;
+    *ph=vsel(*ph>=TWO_PI,*ph-TWO_PI,*ph);
+    return p;
+}
+static inline vf vfsin(vf x){
+    x-=TWO_PI*vfloor(x/TWO_PI+0.5f);
+    vf s=x*x; return x*(1.f-s*(1.f/6.f-s/120.f));
+}
+static inline vf vsaw_w(vf p){ return 2.f*(p/TWO_PI)-1.f; }
+static inline vf vsqr_w(vf p){ return vsel(p<3.14159265f,vsplat(1.f),vsplat(-1.f)); }
+static inline vf vtri_w(vf p){ vf t=p/TWO_PI; return vsel(t<.5f,4.f*t-1.f,3.f-4.f*t); }
+static inline vf vbl_inc(vf f, float dt){ vf i=f*dt; return vsel(i<.5f,i,vsplat(.5f)); }
+static inline vf vblep(vf t, vf inc){
+    vf a=t/inc, b=(t-1.f)/inc;
+    return vsel(t<inc,a+a-a*a-1.f,vsel(t>1.f-inc,b*b+b+b+1.f,vsplat(0.f)));
+}
+static inline vf vblamp(vf t, vf inc){
+    vf a=t/inc-1.f, b=(t-1.f)/inc+1.f;
+    return vsel(t<inc,-(1.f/3.f)*a*a*a,vsel(t>1.f-inc,(1.f/3.f)*b*b*b,vsplat(0.f)));
+}
+static inline vf vhalf_wrap(vf t){ t+=.5f; return vsel(t>=1.f,t-1.f,t); }
+static inline vf vsaw_bl(vf p, vf inc){ vf t=p/TWO_PI; return 2.f*t-1.f-vblep(t,inc); }
+static inline vf vsqr_bl(vf p, vf inc){
+    vf t=p/TWO_PI; return vsqr_w(p)+vblep(t,inc)-vblep(vhalf_wrap(t),inc);
+}
+static inline vf vtri_bl(vf p, vf inc){
+    vf t=p/TWO_PI; return vtri_w(p)+4.f*inc*(vblamp(t,inc)-vblamp(vhalf_wrap(t),inc));
+}
+/* MATH_POLY kernels */
+static inline vf vclamp(vf x, float lo, float hi){ return vsel(x<lo,vsplat(lo),vsel(x>hi,vsplat(hi),x)); }
+static inline vf vsin_poly(vf x){
+    x-=TWO_PI*vfloor(x*(1.f/TWO_PI)+.5f);
+    vf r=vsel(x>0.f,vsplat(3.14159265f),vsplat(-3.14159265f))-x;
+    x=vsel(vabs(x)>1.57079633f,r,x);
+    vf s=x*x;
+    return x*(0.999999061f+s*(-0.166655539f+s*(0.00831189735f+s*-0.000184880597f)));
+}
+static inline vf vexp_poly(vf x){
+    x=vclamp(x,-87.f,88.f);
+    vf n=vfloor(x*1.44269504f+.5f);
+    vf r=x-n*0.693145752f-n*1.42860677e-06f;
+    vf p=1.00000007f+r*(0.999999692f+r*(0.499988945f+r*(0.166675748f+
+         r*(0.0419154167f+r*0.00829766935f))));
+    return p*(vf)((__builtin_convertvector(n,vi)+127)<<23);
+}
+static inline vf vtanh_poly(vf x){
+    x=vclamp(x,-7.90531111f,7.90531111f);
+    vf s=x*x, p=vsplat(-2.76076847742355e-16f), q=vsplat(1.19825839466702e-06f);
+    p=p*s+2.00018790482477e-13f; p=p*s-8.60467152213735e-11f;
+    p=p*s+5.12229709037114e-08f; p=p*s+1.48572235717979e-05f;
+    p=p*s+6.37261928875436e-04f; p=p*s+4.89352455891786e-03f;
+    q=q*s+1.18534705686654e-04f; q=q*s+2.26843463243900e-03f;
+    q=q*s+4.89352518554385e-03f;
+    return x*p/q;
+}
+/* OP_SVF: lanes whose (fc, Q) moved get fresh coefficients, the rest keep theirs */
+static inline vf vtan_pade(vf x){
+    vf s=x*x; return x*(945.f-105.f*s+s*s)/(945.f-420.f*s+15.f*s*s);
+}
+static inline vf vsvf(vf *st, vf x, vf fc, vf q, float mode, float dt){
+    vi m=(fc!=st[2])|(q!=st[3])|(st[5]==0.f);
+    int any=0;
+    for(int l=0;l<BANK_LANES;l++) any|=m[l];
+    if(any){
+        vf g=vtan_pade(vclamp(3.14159265f*fc*dt,0.f,1.53938040f));
+        vf k=1.f/vclamp(q,0.5f,100.f), a1=1.f/(1.f+g*(g+k)), a2=g*a1;
+        st[2]=vsel(m,fc,st[2]); st[3]=vsel(m,q,st[3]);
+        st[4]=vsel(m,k,st[4]);  st[5]=vsel(m,a1,st[5]);
+        st[6]=vsel(m,a2,st[6]); st[7]=vsel(m,g*a2,st[7]);
+    }
+    vf v3=x-st[1], v1=st[5]*st[0]+st[6]*v3, v2=st[1]+st[6]*st[0]+st[7]*v3;
+    st[0]=2.f*v1-st[0]; st[1]=2.f*v2-st[1];
+    return mode==SVF_LP?v2:mode==SVF_BP?st[4]*v1:mode==SVF_HP?x-st[4]*v1-v2:x-st[4]*v1;
+}
+static inline vf vfold_w(vf x){ x=x*.5f+.5f; x-=vfloor(x); return vabs(x*2.f-1.f)*2.f-1.f; }
+
+/* Oversampled nonlinearity, one sample: os_up() / os_down() with n=1 */
+static inline void vhb_up(vf *h, int K, const float *c, vf x, vf *y){
+    for(int j=2*K-1;j>0;j--) h[j]=h[j-1];
+    h[0]=x;
+    vf a=c[0]*(h[K-1]+h[K]);
+    for(int i=1;i<K;i++) a+=c[i]*(h[K-1-i]+h[K+i]);
+    y[0]=h[K]; y[1]=a+a;
+}
+static inline vf vhb_down(vf *h, int K, const float *c, const vf *v){
+    vf *o=h, *e=h+2*K;
+    for(int j=2*K-1;j>0;j--) o[j]=o[j-1];
+    for(int j=K-1;j>0;j--)   e[j]=e[j-1];
+    o[0]=v[1]; e[0]=v[0];
+    vf a=c[0]*(o[K-1]+o[K]);
+    for(int i=1;i<K;i++) a+=c[i]*(o[K-1-i]+o[K+i]);
+    return .5f*e[K-1]+a;
+}
+static inline vf vnl(uint8_t op, float tier, vf x){
+    vf v;
+    if(op==OP_TANH&&tier==MATH_POLY) return vtanh_poly(x);
+    if(op==OP_TANH){ LANEWISE(v,tanhf(x[l])); return v; }
+    if(op==OP_FOLD) return vfold_w(x);
+    return vmax(vsplat(-1.f),vmin(vsplat(1.f),x));
+}
+/* os_region() for one sample: v holds the op's 2 or 4 sub-samples */
+static inline vf vos(vf *s, uint8_t op, float tier, int os, int cont, vf x, vf *v){
+    vf u[2];
+    int m=os==OS_4X?4:2;
+    if(!cont){
+        if(os==OS_4X){
+            vhb_up(s,HB1_K,hb1_c,x,u);
+            vhb_up(s+5*HB1_K,HB2_K,hb2_c,u[0],v);
+            vhb_up(s+5*HB1_K,HB2_K,hb2_c,u[1],v+2);
+        }
+        else vhb_up(s,HB1_K,hb1_c,x,v);
+    }
+    for(int p=0;p<m;p++) v[p]=vnl(op,tier,v[p]);
+    if(os!=OS_4X) return vhb_down(s+2*HB1_K,HB1_K,hb1_c,v);
+    u[0]=vhb_down(s+5*HB1_K+2*HB2_K,HB2_K,hb2_c,v);
+    u[1]=vhb_down(s+5*HB1_K+2*HB2_K,HB2_K,hb2_c,v+2);
+    return vhb_down(s+2*HB1_K,HB1_K,hb1_c,u);
+}
+
+/* ADSR: all four stage formulas evaluated, the live one selected per lane */
+static inline vf vadsr(vf *st, float att, float dec, float sus, float rel, float dt){
+    vf stg=st[0], tm=st[2]+dt, z=vsplat(0.f);
+    vi s0=stg==0.f, s1=stg==1.f, s2=stg==2.f, s3=stg==3.f;
+    vf l0=tm/att;                    vi e0=s0&(tm>=att);
+    vf l1=1.f-(1.f-sus)*(tm/dec);    vi e1=s1&(tm>=dec);
+    vf l3=sus*(1.f-tm/rel);          vi e3=s3&(tm>=rel);
+    vf lv=vsel(s0,l0,vsel(s1,l1,vsel(s2,vsplat(sus),vsel(s3,l3,z))));
+    lv=vsel(e0,vsplat(1.f),vsel(e1,vsplat(sus),vsel(e3,z,lv)));
+    tm=vsel(e0|e1,z,tm);
+    stg=vsel(e0,vsplat(1.f),vsel(e1,vsplat(2.f),vsel(e3,vsplat(4.f),stg)));
+    st[0]=stg; st[1]=lv; st[2]=tm; return lv;
+}
+
+#define PITCH(v) (freq*vsel((v)>0.f,(v),vsplat(1.f)))
+
+/* ---- Core: one sample for every lane ---- */
+static vf bank_exec1(PatchBank *bk){
+    vf *r=bk->regs;
+    const PreparedProgram *pp=bk->pp;
+    float dt=bk->dt;
+    vf freq=bk->note_freq;
+    r[REG_TIME]=bk->note_time;
+    vf osv[4];                      /* sub-samples of the last oversampled op */
+
+    for(int i=0;i<pp->n_instrs;i++){
+        const DInstr *in=&pp->code[i];
+        vf *s=&bk->state[in->sb], x=r[in->a], y=r[in->b], v={0};
+        const float *k=in->k;
+
+        switch(in->op){
+        /* Arithmetic */
+        case OP_CONST: v=vsplat(k[0]); break;
+        case OP_ADD:   v=x+y; break;
+        case OP_SUB:   v=x-y; break;
+        case OP_MUL:   v=x*y; break;
+        case OP_DIV:   v=vsel(y!=0.f,x/y,vsplat(0.f)); break;
+        case OP_NEG:   v=-x; break;
+        case OP_ABS:   v=vabs(x); break;
+
+        /* Oscillators */
+        case OP_OSC:   v=k[0]==MATH_POLY?vsin_poly(vosc_tick(s,PITCH(x),dt)):vfsin(vosc_tick(s,PITCH(x),dt)); break;
+        case OP_SAW: case OP_SQUARE: case OP_TRI: {
+            vf f=PITCH(x), p=vosc_tick(s,f,dt);
+            if(k[0]!=0.f){
+                vf inc=vbl_inc(f,dt);
+                v=in->op==OP_SAW?vsaw_bl(p,inc):in->op==OP_SQUARE?vsqr_bl(p,inc):vtri_bl(p,inc);
+            } else
+                v=in->op==OP_SAW?vsaw_w(p):in->op==OP_SQUARE?vsqr_w(p):vtri_w(p);
+            break;
+        }
+        case OP_PHASE: vosc_tick(s,PITCH(x),dt); v=s[0]; break;
+
+        /* Modulation */
+        case OP_FM:
+            s[0]+=TWO_PI*PITCH(x)*dt+k[0]*y;
+            s[0]=vsel(s[0]>=TWO_PI,s[0]-TWO_PI,s[0]);
+            v=vfsin(s[0]); break;
+        case OP_PM:    v=vfsin(vosc_tick(s,PITCH(x),dt)+y); break;
+        case OP_AM:    v=x*(1.f+k[0]*y); break;
+        case OP_SYNC: {
+            vi rs=(s[0]<=0.f)&(x>0.f); s[0]=x;
+            s[1]=vsel(rs,vsplat(0.f),s[1]);
+            v=vfsin(vosc_tick(&s[1],freq*vsel(y>0.f,y,vsplat(2.f)),dt)); break;
+        }
+
+        /* Noise */
+        case OP_NOISE:    v=vrng(&bk->rng); break;
+        case OP_LP_NOISE: { vf nz=vrng(&bk->rng); s[0]+=k[0]*(nz-s[0]); v=s[0]; break; }
+        case OP_RAND_STEP: {
+            vi due=__builtin_convertvector(s[1],vi)<=0;
+            vu g=bk->rng; vf nz=vrng(&g);
+            bk->rng=(vu)vsel(due,(vf)g,(vf)bk->rng);
+            s[0]=vsel(due,nz,s[0]); s[1]=vsel(due,vsplat(k[0]),s[1]);
+            s[1]-=1.f; v=s[0]; break;
+        }
+
+        /* Nonlinearities */
+        case OP_TANH: case OP_FOLD:
+        case OP_CLIP: v=k[1]!=0.f?vos(s,in->op,k[0],(int)k[1],k[2]!=0.f,x,osv):vnl(in->op,k[0],x); break;
+        case OP_SIGN: v=vsel(x>0.f,vsplat(1.f),vsel(x<0.f,vsplat(-1.f),vsplat(0.f))); break;
+
+        /* Filters */
+        case OP_LPF: s[0]+=k[0]*(x-s[0]); v=s[0]; break;
+        case OP_HPF: { vf lp=s[0]+k[0]*(x-s[0]); s[0]=lp; v=x-lp; break; }
+        case OP_BPF: {
+            vf lv=s[0], bv=s[1], hv=x-lv-k[1]*bv;
+            bv+=k[0]*hv; lv+=k[0]*bv;
+            s[0]=lv; s[1]=bv; v=bv; break;
+        }
+        case OP_ONEPOLE: s[0]=k[0]*x+k[1]*s[0]; v=s[0]; break;
+        case OP_SVF:     v=vsvf(s,x,y,r[in->c],k[0],dt); break;
+
+        /* Envelope */
+        case OP_ADSR:      v=vadsr(s,k[0],k[1],k[2],k[3],dt); break;
+        case OP_RAMP:      v=vmin(vsplat(1.f),bk->note_time/k[0]); break;
+        case OP_EXP_DECAY:
+            if(k[1]==MATH_RECUR)     v=vsel(bk->note_time==0.f,vsplat(1.f),s[0]*k[2]);
+            else if(k[1]==MATH_POLY) v=vexp_poly(-k[0]*bk->note_time);
+            else                     LANEWISE(v,expf(-k[0]*bk->note_time[l]));
+            s[0]=v; break;
+
+        /* Utility */
+        case OP_MIN:  v=vmin(x,y); break;
+        case OP_MAX:  v=vmax(x,y); break;
+        case OP_MIXN: v=x*k[0]+y*k[1]; break;
+        case OP_OUT:
+            bk->note_time+=dt;
+            return x*bk->note_vel;
+
+        default: continue;
+        }
+        r[in->dst]=v;
+    }
+    bk->note_time+=dt;
+    return r[0]*bk->note_vel;
+}
+
+/* ---- Lane management ---- */
+
+static int lane_done(const PatchBank *bk, int lane){
+    const PreparedProgram *pp=bk->pp;
+    for(int g=0;g<pp->n_envs;g++)
+        if(bk->state[pp->env_sb[g]][lane]<(float)ADSR_DONE) return 0;
+    return pp->n_envs>0;
+}
+
+static void reclaim(PatchBank *bk){
+    for(int l=0;l<BANK_LANES;l++){
+        uint32_t m=1u<<l;
+        if((bk->released&m)&&lane_done(bk,l)){ bk->active&=~m; bk->released&=~m; }
+    }
+}
+
+int bank_init(PatchBank *bk, const PreparedProgram *pp){
+    memset(bk,0,sizeof(*bk));
+    if(!pp->src||pp->n_regs>PATCH_REGS||pp->n_state>PATCH_STATE) return -1;
+    bk->pp=pp; bk->dt=pp->dt;
+    return 0;
+}
+
+int bank_note_on(PatchBank *bk, int midi, float vel){
+    if(!bk->pp) return -1;
+    int lane=-1;
+    for(int l=0;l<BANK_LANES&&lane<0;l++) if(!(bk->active&(1u<<l))) lane=l;
+    for(int pass=0;pass<2&&lane<0;pass++){
+        /* Steal: oldest released lane first, then oldest overall */
+        uint32_t best=UINT32_MAX;
+        for(int l=0;l<BANK_LANES;l++){
+            if(pass==0&&!(bk->released&(1u<<l))) continue;
+            if(bk->age[l]<best){ best=bk->age[l]; lane=l; }
+        }
+    }
+    for(int i=0;i<bk->pp->n_regs;i++)  bk->regs[i][lane]=0.f;
+    for(int i=0;i<bk->pp->n_state;i++) bk->state[i][lane]=0.f;
+    bk->note_freq[lane]=freq_from_midi(midi);
+    bk->note_vel[lane]=vel;
+    bk->note_time[lane]=0.f;
+    bk->rng[lane]=0xDEADBEEFu;
+    bk->regs[REG_FREQ][lane]=bk->note_freq[lane];
+    bk->regs[REG_VEL][lane]=vel;
+    bk->regs[REG_ONE][lane]=1.f;
+    bk->pitch[lane]=(uint8_t)midi;
+    bk->age[lane]=bk->serial++;
+    bk->active|=1u<<lane; bk->released&=~(1u<<lane);
+    return lane;
+}
+
+void bank_release_lane(PatchBank *bk, int lane){
+    const PreparedProgram *pp=bk->pp;
+    if(lane<0||lane>=BANK_LANES||!(bk->active&(1u<<lane))) return;
+    for(int g=0;g<pp->n_envs;g++)
+        adsr_gate_off_lane((float*)&bk->state[pp->env_sb[g]]+lane,BANK_LANES);
+    bk->released|=1u<<lane;
+}
+
+void bank_note_off(PatchBank *bk, int midi){
+    for(int l=0;l<BANK_LANES;l++)
+        if((bk->active&~bk->released&(1u<<l))&&bk->pitch[l]==(uint8_t)midi)
+            bank_release_lane(bk,l);
+}
+
+int bank_active(const PatchBank *bk){ return __builtin_popcount(bk->active); }
+
+/* ---- Rendering ---- */
+
+int bank_step_lanes(PatchBank *bk, float *out, int n){
+    if(!bk||!bk->pp||!out) return -1;
+    for(int k=0;k<n;k++){
+        vf v=bank_exec1(bk);
+        for(int l=0;l<BANK_LANES;l++)
+            out[k*BANK_LANES+l]=(bk->active&(1u<<l))?v[l]:0.f;
+    }
+    reclaim(bk);
+    return 0;
+}
+
+int bank_step(PatchBank *bk, float *out, int n){
+    if(!bk||!bk->pp||!out) return -1;
+    for(int k=0;k<n;k++){
+        vf v=bank_exec1(bk); float acc=0.f;
+        for(int l=0;l<BANK_LANES;l++)
+            if(bk->active&(1u<<l)) acc+=v[l];
+        out[k]=acc;
+    }
+    reclaim(bk);
+    return 0;
+}
@@ -0,0 +1,51 @@
+#pragma once
+/*
+ * SHMC Layer 0 — block engine internals shared by the interpreter, the
+ * native backend and the C generator (patch_interp.c, patch_jit.c,
+ * patch_cgen.c).  Internal header.
+ */
+#include "../include/patch.h"
+#include <string.h>
+
+typedef struct {
+    float      (*rb)[AUDIO_BLOCK];  /* per-register sample buffers */
+    PatchState  *ps;
+    const float *tm;                /* note_time per sample        */
+    float        freq, dt;
+    int          n;
+    float       *osv;               /* sub-samples of the last oversampled
+                                       op, 4*AUDIO_BLOCK               */
+} BlockCtx;
+
+typedef void (*BlockKernel)(const DInstr *in, BlockCtx *c);
+
+/* Block kernel per opcode (patch_interp.c) */
+extern const BlockKernel patch_kernels[OP_COUNT];
+
+/* Native block function: runs code[0..OUT) over c->rb and returns the
+   OUT register's buffer.  Unlike the interpreter loop it does not copy
+   the last sample of each register back to PatchState.regs — nothing
+   reads them for block-eligible programs. */
+typedef const float *(*PatchJitFn)(float (*rb)[AUDIO_BLOCK], BlockCtx *c,
+                                   const DInstr *code);
+
+/* Every register written before it is read and at most one RNG op: the
+   program may run one instruction at a time over a whole block */
+static inline int block_ok(const PatchProgram *prog){
+    uint8_t def[MAX_REGS]; int rng=0;
+    memset(def,0,sizeof(def));
+    for(int r=0;r<REG_FREE;r++) def[r]=1;
+    for(int i=0;i<prog->n_instrs;i++){
+        Instr   ins=prog->code[i];
+        uint8_t op=INSTR_OP(ins), rd=op_reads(op);
+        if((rd&1)&&!def[INSTR_SRC_A(ins)]) return 0;
+        if((rd&2)&&!def[INSTR_SRC_B(ins)]) return 0;
+        if((rd&4)&&!def[INSTR_SRC_C(ins)]) return 0;
+        if(op==OP_OUT) break;
+        if(op==OP_NOISE||op==OP_LP_NOISE||op==OP_RAND_STEP){ if(++rng>1) return 0; }
+        if(op>=OP_COUNT) continue;
+        if(INSTR_DST(ins)<REG_FREE) return 0;
+        def[INSTR_DST(ins)]=1;
+    }
+    return 1;
+}
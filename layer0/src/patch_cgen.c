@@ -0,0 +1,263 @@
+/*
+ * SHMC Layer 0 — ahead-of-time C code generator
+ *
+ * Mirrors exec1() opcode by opcode, in the block form below when the
+ * program allows it.  Every constant exec1() derives from an immediate
+ * is computed here with the same expression and printed as a hex-float
+ * literal, so the generated code rounds exactly as the interpreter does;
+ * ADSR constants come from adsr_params(), as in exec1().
+ */
+#include "../include/patch_cgen.h"
+#include "patch_dsp.h"
+#include "patch_block.h"
+#include <string.h>
+
+/* Exact float literal; four rotating buffers per statement */
+static const char *lit(float v){
+    static char buf[4][40]; static int k;
+    char *b=buf[k++&3];
+    snprintf(b,40,"%af",(double)v); return b;
+}
+static float mod_or(uint16_t i, float dflt){ return (i<32)?g_mod[i]:dflt; }
+static float cut_or(uint16_t i, float dt, float dflt){ return (i<64)?lpc(g_cutoff[i],dt):dflt; }
+
+/* prev: the instruction before ins, for oversampled regions */
+static void emit_instr(FILE *f, Instr prev, Instr ins, int sb, float dt){
+    uint8_t  op=INSTR_OP(ins), d=INSTR_DST(ins), a=INSTR_SRC_A(ins), b=INSTR_SRC_B(ins);
+    uint16_t hi=INSTR_IMM_HI(ins), lo=INSTR_IMM_LO(ins);
+    const char *wave=NULL;
+    switch(op){
+    /* Arithmetic */
+    case OP_CONST: fprintf(f,"        r%d=%s;\n",d,lit(decode_const(hi,lo))); break;
+    case OP_ADD:   fprintf(f,"        r%d=r%d+r%d;\n",d,a,b); break;
+    case OP_SUB:   fprintf(f,"        r%d=r%d-r%d;\n",d,a,b); break;
+    case OP_MUL:   fprintf(f,"        r%d=r%d*r%d;\n",d,a,b); break;
+    case OP_DIV:   fprintf(f,"        r%d=(r%d!=0.f)?r%d/r%d:0.f;\n",d,b,a,b); break;
+    case OP_NEG:   fprintf(f,"        r%d=-r%d;\n",d,a); break;
+    case OP_ABS:   fprintf(f,"        r%d=fabsf(r%d);\n",d,a); break;
+
+    /* Oscillators */
+    case OP_OSC:    wave=lo==MATH_POLY?"sin_poly":"fsin"; goto osc;
+    case OP_SAW:    wave="saw_w"; goto osc;
+    case OP_SQUARE: wave="sqr_w"; goto osc;
+    case OP_TRI:    wave="tri_w";
+    osc:
+        if(op!=OP_OSC&&lo==OSC_BLEP)
+            fprintf(f,"        { float f=freq*(r%d>0?r%d:1.f); r%d=%.3s_bl(osc_tick(&s[%d],f,dt),bl_inc(f,dt)); }\n",
+                    a,a,d,wave,sb);
+        else
+            fprintf(f,"        r%d=%s(osc_tick(&s[%d],freq*(r%d>0?r%d:1.f),dt));\n",d,wave,sb,a,a);
+        break;
+    case OP_PHASE:
+        fprintf(f,"        osc_tick(&s[%d],freq*(r%d>0?r%d:1.f),dt); r%d=s[%d];\n",sb,a,a,d,sb);
+        break;
+
+    /* Modulation */
+    case OP_FM:
+        fprintf(f,"        s[%d]+=TWO_PI*(freq*(r%d>0?r%d:1.f))*dt+%s*r%d;\n"
+                  "        if(s[%d]>=TWO_PI)s[%d]-=TWO_PI;\n"
+                  "        r%d=fsin(s[%d]);\n",
+                sb,a,a,lit(mod_or(hi,0.5f)),b,sb,sb,d,sb);
+        break;
+    case OP_PM:
+        fprintf(f,"        r%d=fsin(osc_tick(&s[%d],freq*(r%d>0?r%d:1.f),dt)+r%d);\n",d,sb,a,a,b);
+        break;
+    case OP_AM:
+        fprintf(f,"        r%d=r%d*(1.f+%s*r%d);\n",d,a,lit(mod_or(hi,0.5f)),b);
+        break;
+    case OP_SYNC:
+        fprintf(f,"        { float prev=s[%d]; s[%d]=r%d; if(prev<=0.f&&r%d>0.f)s[%d]=0.f;\n"
+                  "          r%d=fsin(osc_tick(&s[%d],freq*(r%d>0?r%d:2.f),dt)); }\n",
+                sb,sb,a,a,sb+1,d,sb+1,b,b);
+        break;
+
+    /* Noise */
+    case OP_NOISE: fprintf(f,"        r%d=rng_f(&rng);\n",d); break;
+    case OP_LP_NOISE:
+        fprintf(f,"        { float v=rng_f(&rng); s[%d]+=%s*(v-s[%d]); r%d=s[%d]; }\n",
+                sb,lit(cut_or(hi,dt,0.05f)),sb,d,sb);
+        break;
+    case OP_RAND_STEP:
+        fprintf(f,"        if((int)s[%d]<=0){s[%d]=rng_f(&rng);s[%d]=%d.f;}\n"
+                  "        s[%d]-=1.f; r%d=s[%d];\n",
+                sb+1,sb,sb+1,(hi>0)?(int)hi:100,sb+1,d,sb);
+        break;
+
+    /* Nonlinearities */
+    case OP_TANH: case OP_FOLD: case OP_CLIP:
+        if(hi==OS_2X||hi==OS_4X){
+            fprintf(f,"        os_region(&s[%d],%d,%d.f,%d,%d,&r%d,osv,&r%d,1);\n",
+                    sb,op,lo,hi,instr_os_continues(prev,ins),a,d);
+            break;
+        }
+        if(op==OP_FOLD){ fprintf(f,"        r%d=fold_w(r%d);\n",d,a); break; }
+        if(op==OP_CLIP){ fprintf(f,"        r%d=fmaxf(-1.f,fminf(1.f,r%d));\n",d,a); break; }
+        fprintf(f,"        r%d=%s(r%d);\n",d,lo==MATH_POLY?"tanh_poly":"tanhf",a); break;
+    case OP_SIGN: fprintf(f,"        r%d=(r%d>0.f)?1.f:(r%d<0.f)?-1.f:0.f;\n",d,a,a); break;
+
+    /* Filters */
+    case OP_LPF:
+        fprintf(f,"        s[%d]+=%s*(r%d-s[%d]); r%d=s[%d];\n",sb,lit(cut_or(hi,dt,0.1f)),a,sb,d,sb);
+        break;
+    case OP_HPF:
+        fprintf(f,"        { float lp=s[%d]+%s*(r%d-s[%d]); s[%d]=lp; r%d=r%d-lp; }\n",
+                sb,lit(cut_or(hi,dt,0.1f)),a,sb,sb,d,a);
+        break;
+    case OP_BPF:
+        fprintf(f,"        { float lv=s[%d],bv=s[%d],hv=r%d-lv-%s*bv;\n"
+                  "          bv+=%s*hv; lv+=%s*bv; s[%d]=lv; s[%d]=bv; r%d=bv; }\n",
+                sb,sb+1,a,lit((lo<32)?g_mod[lo]+0.1f:0.5f),
+                lit(cut_or(hi,dt,0.1f)),lit(cut_or(hi,dt,0.1f)),sb,sb+1,d);
+        break;
+    case OP_ONEPOLE: {
+        float c=(float)(uint8_t)(hi>>8)/255.f;
+        fprintf(f,"        s[%d]=%s*r%d+%s*s[%d]; r%d=s[%d];\n",sb,lit(c),a,lit(1.f-c),sb,d,sb);
+        break;
+    }
+    case OP_SVF:
+        fprintf(f,"        r%d=svf_run(&s[%d],r%d,r%d,r%d,%d.f,dt);\n",d,sb,a,b,INSTR_SRC_C(ins),lo);
+        break;
+
+    /* Envelope */
+    case OP_ADSR: {
+        float k[4]; adsr_params(hi,lo,k);
+        fprintf(f,"        r%d=adsr_run(&s[%d],%s,%s,%s,%s,dt);\n",d,sb,
+                lit(k[0]),lit(k[1]),lit(k[2]),lit(k[3]));
+        break;
+    }
+    case OP_RAMP:
+        fprintf(f,"        r%d=fminf(1.f,t/%s);\n",d,lit((hi<32)?g_env[hi]:0.1f));
+        break;
+    case OP_EXP_DECAY: {
+        float rate=(hi<32)?g_mod[hi]*20.f:2.f;
+        if(lo==MATH_RECUR)
+            fprintf(f,"        s[%d]=(t==0.f)?1.f:s[%d]*%s; r%d=s[%d];\n",sb,sb,lit(expf(-rate*dt)),d,sb);
+        else
+            fprintf(f,"        s[%d]=r%d=%s(-%s*t);\n",sb,d,lo==MATH_POLY?"exp_poly":"expf",lit(rate));
+        break;
+    }
+
+    /* Utility */
+    case OP_MIN:  fprintf(f,"        r%d=fminf(r%d,r%d);\n",d,a,b); break;
+    case OP_MAX:  fprintf(f,"        r%d=fmaxf(r%d,r%d);\n",d,a,b); break;
+    case OP_MIXN:
+        fprintf(f,"        r%d=r%d*%s+r%d*%s;\n",d,a,lit(mod_or(hi,0.5f)),b,lit(mod_or(lo,0.5f)));
+        break;
+    default: break;
+    }
+}
+
+void patch_cgen_begin(FILE *f, float sr){
+    fprintf(f,"/* Generated by patch_cgen for %g Hz — do not edit.\n"
+              "   Build with -ffp-contract=off (and -Ilayer0/src) for output\n"
+              "   bit-identical to the interpreter. */\n"
+              "#include \"patch_dsp.h\"\n",(double)sr);
+}
+
+/* ---- Block form ----
+   A program block_ok() accepts is cut into per-sample segments, each
+   looping over a chunk of up to AUDIO_BLOCK samples: a segment ends
+   after every stateful op, so each state recurrence gets its own loop
+   and the pure work around it pipelines across samples, and every
+   oversampled op runs once per chunk through os_region(), like the
+   interpreter's block kernel, rather than once per sample.  A value that
+   crosses a cut goes through a chunk buffer b<i>, named after the
+   instruction i that wrote it.  Called once with f NULL to find the
+   buffers (need) and again to emit; returns -1 if an oversampled op
+   reads a reserved register, which leaves the program per-sample. */
+static int emit_blocks(FILE *f, const PatchProgram *prog, int n, int out, float dt, uint8_t *need){
+    int     wr[MAX_REGS], open=0;             /* instruction holding each register */
+    uint8_t seen[MAX_REGS];                   /* read or written in this segment   */
+    for(int r=0;r<MAX_REGS;r++) wr[r]=-1;
+    memset(seen,0,sizeof(seen));
+#define OPEN  if(!open&&(open=1)&&f) fprintf(f,"      t=t0; for(int i=0;i<m;i++){\n        r%d=t;\n",REG_TIME)
+#define CLOSE if(open&&!(open=0)&&f) fprintf(f,"        t+=dt;\n      }\n")
+    for(int i=0,sb=0;i<=n;i++){
+        Instr   ins=i<n?prog->code[i]:INSTR_PACK(OP_OUT,0,out,0,0,0);
+        uint8_t op=INSTR_OP(ins), d=INSTR_DST(ins), a=INSTR_SRC_A(ins), rd=op_reads(op);
+        if(instr_os(ins)){
+            int w=wr[a];
+            if(w<0) return -1;
+            CLOSE;
+            need[w]=need[i]=1;
+            if(f) fprintf(f,"      os_region(&s[%d],%d,%d.f,%d,%d,b%d,osv,b%d,m); r%d=b%d[m-1];\n",
+                          sb,op,INSTR_IMM_LO(ins),INSTR_IMM_HI(ins),
+                          instr_os_continues(i?prog->code[i-1]:0,ins),w,i,d,i);
+            wr[d]=i; memset(seen,0,sizeof(seen));
+        }
+        else if(op<OP_COUNT){
+            uint8_t src[3]={a,INSTR_SRC_B(ins),INSTR_SRC_C(ins)};
+            OPEN;
+            for(int k=0;k<3;k++){
+                uint8_t r=src[k];
+                if(!(rd>>k&1)||seen[r]) continue;
+                seen[r]=1;
+                if(wr[r]<0) continue;
+                need[wr[r]]=1;
+                if(f) fprintf(f,"        r%d=b%d[i];\n",r,wr[r]);
+            }
+            if(op==OP_OUT){ if(f) fprintf(f,"        out[i0+i]=r%d*vel;\n",out); break; }
+            if(f) emit_instr(f,i?prog->code[i-1]:0,ins,sb,dt);
+            seen[d]=1; wr[d]=i;
+            if(f&&need[i]) fprintf(f,"        b%d[i]=r%d;\n",i,d);
+            if(instr_state_slots(ins)){ CLOSE; memset(seen,0,sizeof(seen)); }
+        }
+        if(i<n) sb+=instr_state_slots(ins);
+    }
+    CLOSE;
+#undef OPEN
+#undef CLOSE
+    return 0;
+}
+
+int patch_cgen(FILE *f, const PatchProgram *prog, const char *name, float sr){
+    if(prog->n_instrs>MAX_INSTRS) return -1;
+    float   dt=1.f/sr;
+    uint8_t used[MAX_REGS];
+    int     n=prog->n_instrs, out=-1;
+    memset(used,0,sizeof(used));
+    used[REG_TIME]=1;
+
+    /* Executed span and the registers it touches */
+    for(int i=0;i<prog->n_instrs;i++){
+        Instr ins=prog->code[i]; uint8_t op=INSTR_OP(ins), rd=op_reads(op);
+        if(rd&1) used[INSTR_SRC_A(ins)]=1;
+        if(rd&2) used[INSTR_SRC_B(ins)]=1;
+        if(rd&4) used[INSTR_SRC_C(ins)]=1;
+        if(op==OP_OUT){ n=i; out=INSTR_SRC_A(ins); break; }
+        if(op<OP_COUNT) used[INSTR_DST(ins)]=1;
+    }
+    if(out<0) used[out=0]=1;
+
+    uint8_t need[MAX_INSTRS+1];
+    memset(need,0,sizeof(need));
+    int blocked=block_ok(prog)&&emit_blocks(NULL,prog,n,out,dt,need)==0;
+
+    fprintf(f,"\nvoid %s(PatchState *ps, float *out, int n){\n",name);
+    fprintf(f,"    float *s=ps->state, t=ps->note_time;\n"
+              "    const float freq=ps->note_freq, vel=ps->note_vel, dt=%s;\n"
+              "    uint32_t rng=ps->rng;\n",lit(dt));
+    for(int r=0;r<MAX_REGS;r++) if(used[r]) fprintf(f,"    float r%d=ps->regs[%d];\n",r,r);
+    if(blocked){
+        fprintf(f,"    float osv[4*AUDIO_BLOCK];\n");
+        for(int i=0;i<n;i++) if(need[i]) fprintf(f,"    float b%d[AUDIO_BLOCK];\n",i);
+        fprintf(f,"    (void)s; (void)freq; (void)dt; (void)osv;\n"
+                  "    for(int i0=0;i0<n;i0+=AUDIO_BLOCK){\n"
+                  "      const int m=n-i0<AUDIO_BLOCK?n-i0:AUDIO_BLOCK;\n"
+                  "      const float t0=t;\n");
+        emit_blocks(f,prog,n,out,dt,need);
+        fprintf(f,"    }\n");
+    } else {
+        fprintf(f,"    float osv[4];\n");
+        fprintf(f,"    (void)s; (void)freq; (void)dt; (void)osv;\n");
+        fprintf(f,"    for(int i=0;i<n;i++){\n        r%d=t;\n",REG_TIME);
+        for(int i=0,sb=0;i<n;i++){
+            emit_instr(f,i?prog->code[i-1]:0,prog->code[i],sb,dt);
+            sb+=instr_state_slots(prog->code[i]);
+        }
+        fprintf(f,"        out[i]=r%d*vel; t+=dt;\n    }\n",out);
+    }
+    for(int r=0;r<MAX_REGS;r++) if(used[r]) fprintf(f,"    ps->regs[%d]=r%d;\n",r,r);
+    fprintf(f,"    ps->note_time=t; ps->rng=rng;\n}\n");
+    return 0;
+}
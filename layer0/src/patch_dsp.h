@@ -0,0 +1,269 @@
+#pragma once
+/*
+ * SHMC Layer 0 — DSP primitives shared by the execution engines
+ * (patch_interp.c, patch_bank.c).  Internal header: every engine must
+ * compute these exactly the same way to stay bit-compatible.
+ */
+#include "../include/patch.h"
+#include <math.h>
+#include <string.h>
+
+#define TWO_PI 6.28318530718f
+
+/* ---- xorshift32 RNG mapped to [-1,1] ---- */
+static inline float rng_f(uint32_t *s){
+    *s^=*s<<13; *s^=*s>>17; *s^=*s<<5;
+    return (float)(int32_t)*s*(1.f/2147483648.f);
+}
+
+/* ---- Waveform helpers ---- */
+static inline float osc_tick(float *ph, float freq, float dt){
+    float p=*ph; *ph+=TWO_PI*freq*dt;
+    if(*ph>=TWO_PI)*ph-=TWO_PI;
+    return p;
+}
+static inline float fsin(float x){
+    /* degree-5 Taylor sine on [-pi,pi], not minimax: off by up to 0.52
+       near +-pi (see the MATH_POLY error table below) */
+    x-=TWO_PI*floorf(x/TWO_PI+0.5f);
+    float s=x*x; return x*(1.f-s*(1.f/6.f-s/120.f));
+}
+static inline float saw_w(float p){ return 2.f*(p/TWO_PI)-1.f; }
+static inline float sqr_w(float p){ return p<3.14159265f?1.f:-1.f; }
+static inline float tri_w(float p){ float t=p/TWO_PI; return t<.5f?4.f*t-1.f:3.f-4.f*t; }
+static inline float fold_w(float x){ x=x*.5f+.5f; x-=floorf(x); return fabsf(x*2.f-1.f)*2.f-1.f; }
+
+/* ---- Band-limited waveforms (OSC_BLEP) ----
+   t: phase in cycles [0,1), inc: phase advance per sample in cycles.
+   Two-sample polynomial residuals round off each jump (PolyBLEP: saw,
+   square) or corner (PolyBLAMP: triangle) of the naive waveform.       */
+static inline float bl_inc(float f, float dt){ float i=f*dt; return i<.5f?i:.5f; }
+static inline float blep(float t, float inc){
+    if(t<inc){ t/=inc; return t+t-t*t-1.f; }
+    if(t>1.f-inc){ t=(t-1.f)/inc; return t*t+t+t+1.f; }
+    return 0.f;
+}
+static inline float blamp(float t, float inc){
+    if(t<inc){ t=t/inc-1.f; return -(1.f/3.f)*t*t*t; }
+    if(t>1.f-inc){ t=(t-1.f)/inc+1.f; return (1.f/3.f)*t*t*t; }
+    return 0.f;
+}
+static inline float half_wrap(float t){ t+=.5f; return t>=1.f?t-1.f:t; }
+static inline float saw_bl(float p, float inc){ float t=p/TWO_PI; return 2.f*t-1.f-blep(t,inc); }
+static inline float sqr_bl(float p, float inc){
+    float t=p/TWO_PI; return sqr_w(p)+blep(t,inc)-blep(half_wrap(t),inc);
+}
+static inline float tri_bl(float p, float inc){
+    float t=p/TWO_PI; return tri_w(p)+4.f*inc*(blamp(t,inc)-blamp(half_wrap(t),inc));
+}
+
+/* ---- Polynomial math kernels (MATH_POLY) ----
+   Branch-free and libm-free, so the block loops vectorize.  Max error
+   against double-precision libm, measured by test_layer0 [math]:
+     sin_poly   |x| <= 2pi      abs 1.1e-6   odd degree 7 on [-pi/2,pi/2]
+                                             (+|x|*6e-8 from the reduction)
+     exp_poly   -87 <= x <= 0   rel 2.2e-7   2^n * degree 5, Cody-Waite
+     tanh_poly  all x           abs 3.9e-7   rational 13/6, |x| <= 7.9
+   MATH_RECUR decay (z *= g per sample) drifts by at most n*2^-24
+   relative after n samples: 0.3% (0.02 dB) after 2 s at 44.1 kHz.
+   For comparison fsin(), the MATH_REF sine, is off by up to 0.52 near
+   +-pi.                                                                */
+/* floorf() for |x| < 2^31 through an int conversion, which vectorizes */
+static inline float floor_cvt(float x){ float t=(float)(int32_t)x; return t-(float)(t>x); }
+static inline float sin_poly(float x){
+    x-=TWO_PI*floor_cvt(x*(1.f/TWO_PI)+.5f);               /* [-pi, pi]     */
+    float r=(x>0.f?3.14159265f:-3.14159265f)-x;           /* sin(pi-x)     */
+    x=fabsf(x)>1.57079633f?r:x;                           /* [-pi/2, pi/2] */
+    float s=x*x;
+    return x*(0.999999061f+s*(-0.166655539f+s*(0.00831189735f+s*-0.000184880597f)));
+}
+static inline float exp_poly(float x){
+    x=x<-87.f?-87.f:x>88.f?88.f:x;
+    float n=floor_cvt(x*1.44269504f+.5f);                 /* round(x/ln2)  */
+    float r=x-n*0.693145752f-n*1.42860677e-06f;           /* Cody-Waite    */
+    float p=1.00000007f+r*(0.999999692f+r*(0.499988945f+r*(0.166675748f+
+            r*(0.0419154167f+r*0.00829766935f))));
+    uint32_t u=(uint32_t)((int32_t)n+127)<<23; float e;
+    memcpy(&e,&u,sizeof(e));
+    return p*e;
+}
+static inline float tanh_poly(float x){
+    x=x<-7.90531111f?-7.90531111f:x>7.90531111f?7.90531111f:x;
+    float s=x*x;
+    float p=-2.76076847742355e-16f;
+    p=p*s+2.00018790482477e-13f; p=p*s-8.60467152213735e-11f;
+    p=p*s+5.12229709037114e-08f; p=p*s+1.48572235717979e-05f;
+    p=p*s+6.37261928875436e-04f; p=p*s+4.89352455891786e-03f;
+    float q=1.19825839466702e-06f;
+    q=q*s+1.18534705686654e-04f; q=q*s+2.26843463243900e-03f;
+    q=q*s+4.89352518554385e-03f;
+    return x*p/q;
+}
+
+/* ---- Oversampled nonlinearities (OS_2X / OS_4X) ----
+   Only the nonlinear op runs at the higher rate: its input is
+   interpolated by a polyphase half-band FIR, the op is applied to every
+   sub-sample, and the result is filtered and decimated back.  Half-band
+   taps are zero at even offsets, so each stage costs K multiplies per
+   output sample and one branch is a pure delay.  Coefficients are
+   minimax designs (odd taps c[i] at offsets +-(2i+1), centre 1/2):
+     HB1  K=8  31 taps  passband 0.4 fs  ripple/rejection 57 dB   (2x)
+     HB2  K=3  11 taps  passband 0.2 fs  ripple/rejection 68 dB   (2x -> 4x)
+   Latency is 2*HB1_K-1 = 15 samples at 2x, 17.5 at 4x; dry signals mixed
+   with an oversampled one see that offset.  A chain of oversampled ops
+   (instr_os_continues()) stays at the high rate: each op after the first
+   starts from the previous op's sub-samples, so the chain's output pays
+   that latency once, not once per op.
+   State: HB1 up (2K newest-first inputs) | HB1 down (2K odd, K even
+   sub-samples) | at 4x, the same for HB2.  The block form below is the
+   only implementation: exec1() runs it with n=1.                         */
+#define HB1_K 8
+#define HB2_K 3
+_Static_assert(OS_2X_SLOTS==5*HB1_K&&OS_4X_SLOTS==5*(HB1_K+HB2_K),"OS_*_SLOTS");
+static const float hb1_c[HB1_K]={ 0.31567809f, -0.0984177664f, 0.0515222587f, -0.0297816191f,
+                                  0.0172065571f, -0.00942522008f, 0.00464843167f, -0.00210743444f };
+static const float hb2_c[HB2_K]={ 0.298593879f, -0.0581217445f, 0.00971242413f };
+
+/* y[2k], y[2k+1] = 2x interpolation of x[k], k < n <= 2*AUDIO_BLOCK */
+static inline void hb_up(float *h, int K, const float *c, const float *x, float *y, int n){
+    float X[2*HB1_K+2*AUDIO_BLOCK];                       /* oldest first */
+    for(int j=0;j<2*K;j++) X[j]=h[2*K-1-j];
+    for(int k=0;k<n;k++) X[2*K+k]=x[k];
+    float a[2*AUDIO_BLOCK], *p=X+K;       /* taps outer: same sums, vectorized over k */
+    for(int k=0;k<n;k++) a[k]=c[0]*(p[k+1]+p[k]);
+    for(int i=1;i<K;i++) for(int k=0;k<n;k++) a[k]+=c[i]*(p[k+1+i]+p[k-i]);
+    for(int k=0;k<n;k++){ y[2*k]=p[k]; y[2*k+1]=a[k]+a[k]; }
+    for(int m=0;m<2*K;m++) h[m]=X[2*K+n-1-m];
+}
+/* w[k] = half-band filtered v[2k], v[2k+1], decimated */
+static inline void hb_down(float *h, int K, const float *c, const float *v, float *w, int n){
+    float O[2*HB1_K+2*AUDIO_BLOCK], E[HB1_K+2*AUDIO_BLOCK], *o=h, *e=h+2*K;
+    for(int j=0;j<2*K;j++) O[j]=o[2*K-1-j];
+    for(int j=0;j<K;j++)   E[j]=e[K-1-j];
+    for(int k=0;k<n;k++){ O[2*K+k]=v[2*k+1]; E[K+k]=v[2*k]; }
+    float a[2*AUDIO_BLOCK], *p=O+K;
+    for(int k=0;k<n;k++) a[k]=c[0]*(p[k+1]+p[k]);
+    for(int i=1;i<K;i++) for(int k=0;k<n;k++) a[k]+=c[i]*(p[k+1+i]+p[k-i]);
+    for(int k=0;k<n;k++) w[k]=.5f*E[k+1]+a[k];
+    for(int m=0;m<2*K;m++) o[m]=O[2*K+n-1-m];
+    for(int m=0;m<K;m++)   e[m]=E[K+n-1-m];
+}
+/* The memoryless op itself, in place; tier is OP_TANH's imm lo */
+static inline void nl_run(uint8_t op, float tier, float *x, int n){
+    if(op==OP_TANH&&tier==MATH_POLY) for(int k=0;k<n;k++) x[k]=tanh_poly(x[k]);
+    else if(op==OP_TANH)             for(int k=0;k<n;k++) x[k]=tanhf(x[k]);
+    else if(op==OP_FOLD)             for(int k=0;k<n;k++) x[k]=fold_w(x[k]);
+    else                             for(int k=0;k<n;k++) x[k]=fmaxf(-1.f,fminf(1.f,x[k]));
+}
+/* v = x interpolated to os (OS_2X / OS_4X) times the rate: 2n or 4n
+   sub-samples */
+static inline void os_up(float *s, int os, const float *x, float *v, int n){
+    if(os==OS_4X){
+        float u[2*AUDIO_BLOCK];
+        hb_up(s,HB1_K,hb1_c,x,u,n);
+        hb_up(s+5*HB1_K,HB2_K,hb2_c,u,v,2*n);
+    }
+    else hb_up(s,HB1_K,hb1_c,x,v,n);
+}
+/* y = sub-samples v filtered and decimated back to the base rate */
+static inline void os_down(float *s, int os, const float *v, float *y, int n){
+    if(os==OS_4X){
+        float u[2*AUDIO_BLOCK];
+        hb_down(s+5*HB1_K+2*HB2_K,HB2_K,hb2_c,v,u,2*n);
+        hb_down(s+2*HB1_K,HB1_K,hb1_c,u,y,n);
+    }
+    else hb_down(s+2*HB1_K,HB1_K,hb1_c,v,y,n);
+}
+/* y = op(x) at os times the rate; v holds the op's sub-samples
+   (4*AUDIO_BLOCK) and is taken as the input instead of x when cont is
+   set, see instr_os_continues().  Leaves the op's sub-samples in v for
+   the next op of the region; y may alias x. */
+static inline void os_region(float *s, uint8_t op, float tier, int os, int cont,
+                             const float *x, float *v, float *y, int n){
+    if(!cont) os_up(s,os,x,v,n);
+    nl_run(op,tier,v,(os==OS_4X?4:2)*n);
+    os_down(s,os,v,y,n);
+}
+
+/* ---- One-pole LP coefficient ---- */
+static inline float lpc(float cut, float dt){
+    float w=TWO_PI*cut*dt; return w/(1.f+w);
+}
+
+/* ---- TPT state-variable filter (OP_SVF) ----
+   Zavalishin's trapezoidal (topology-preserving) SVF: g=tan(pi*fc/sr)
+   prewarps the cutoff, so tuning holds and the loop stays stable all the
+   way to Nyquist, unlike the Euler one-poles above.  The coefficients
+   live in state next to the (fc, Q) they were computed for and are
+   rebuilt only when either input changes: a held or stepped cutoff pays
+   for tan_pade() and the two divisions once, audio-rate modulation once
+   per sample.  State: ic1 ic2 | fc q | k a1 a2 a3 (a1==0: not yet built).
+   tan_pade() is the [5/4] Pade approximant: rel error 1e-7 below 0.3 sr,
+   3e-4 at the 0.49 sr clamp.                                              */
+static inline float tan_pade(float x){
+    float s=x*x; return x*(945.f-105.f*s+s*s)/(945.f-420.f*s+15.f*s*s);
+}
+static inline void svf_coef(float *c, float fc, float q, float dt){
+    float w=3.14159265f*fc*dt; w=w<0.f?0.f:w>1.53938040f?1.53938040f:w;
+    q=q<0.5f?0.5f:q>100.f?100.f:q;
+    float g=tan_pade(w), k=1.f/q, a1=1.f/(1.f+g*(g+k));
+    c[0]=k; c[1]=a1; c[2]=g*a1; c[3]=g*c[2];
+}
+static inline float svf_run(float *s, float x, float fc, float q, float mode, float dt){
+    if(fc!=s[2]||q!=s[3]||s[5]==0.f){ s[2]=fc; s[3]=q; svf_coef(&s[4],fc,q,dt); }
+    float v3=x-s[1], v1=s[5]*s[0]+s[6]*v3, v2=s[1]+s[6]*s[0]+s[7]*v3;
+    s[0]=2.f*v1-s[0]; s[1]=2.f*v2-s[1];
+    return mode==SVF_LP?v2:mode==SVF_BP?s[4]*v1:mode==SVF_HP?x-s[4]*v1-v2:x-s[4]*v1;
+}
+
+/* ---- CONST decoding ----
+   lo==0 → mod-table index (hi < 32), else Q8.8 signed float
+   lo==1 → Q8.8 signed float (from pb_const_f)                */
+static inline float decode_const(uint16_t hi, uint16_t lo){
+    extern const float g_mod[32];
+    if(lo==0){ if(hi<32)return g_mod[hi]; return (float)(int16_t)hi/256.f; }
+    return (float)(int16_t)hi/256.f;
+}
+
+/* ---- ADSR ----
+   State layout: [0]=stage  [1]=level  [2]=timer
+   Encoding: hi = att(6b)|dec(5b)|sus(5b),  lo = rel(5b)|0
+   Stages: 0 attack, 1 decay, 2 sustain, 3 release, 4 done
+   Release ends on its timer, not on the level: with sustain 0 the
+   level is already 0 (-0.0) and would never go below it.       */
+#define ADSR_RELEASE 3
+#define ADSR_DONE    4
+
+/* Gate off: enter release with a fresh timer.  The _lane form is for
+   state whose slots lie stride floats apart (PatchBank lanes). */
+static inline void adsr_gate_off_lane(float *st, int stride){
+    st[0]=(float)ADSR_RELEASE; st[2*stride]=0.f;
+}
+static inline void adsr_gate_off(float *st){ adsr_gate_off_lane(st,1); }
+
+static inline float adsr_run(float *st, float att, float dec,
+                             float sus, float rel, float dt){
+    int   stg=(int)st[0]; float lv=st[1],tm=st[2];
+    tm+=dt;
+    switch(stg){
+        case 0: lv=tm/att; if(tm>=att){lv=1.f;tm=0;stg=1;} break;
+        case 1: lv=1.f-(1.f-sus)*(tm/dec); if(tm>=dec){lv=sus;tm=0;stg=2;} break;
+        case 2: lv=sus; break;
+        case 3: lv=sus*(1.f-tm/rel); if(tm>=rel){lv=0.f;stg=4;} break;
+        default: lv=0.f;
+    }
+    st[0]=(float)stg; st[1]=lv; st[2]=tm; return lv;
+}
+/* att, dec, sus, rel of an ADSR's immediates.  The 6-bit attack field
+   can index past the 32-entry env table; those clamp to its last entry
+   (patch_file rejects them on load, builders can still emit them). */
+static inline void adsr_params(uint16_t hi, uint16_t lo, float k[4]){
+    extern const float g_env[32]; extern const float g_mod[32];
+    int ai=(hi>>10)&0x3F;
+    k[0]=g_env[ai<32?ai:31]; k[1]=g_env[(hi>>5)&0x1F];
+    k[2]=g_mod[hi&0x1F];     k[3]=g_env[(lo>>11)&0x1F];
+}
+static inline float adsr_tick(float *st, uint16_t hi, uint16_t lo, float dt){
+    float k[4]; adsr_params(hi,lo,k);
+    return adsr_run(st,k[0],k[1],k[2],k[3],dt);
+}
@@ -0,0 +1,237 @@
+/*
+ * SHMC Layer 0 — binary patch / sequence library
+ *
+ * Readers never trust the file: every offset is checked against the
+ * mapped size before it is dereferenced, and patch words are validated
+ * before they reach an engine (the interpreter indexes registers, state
+ * and constant tables straight from the instruction fields).
+ */
+#include "../include/patch_file.h"
+#include <string.h>
+
+#if defined(__linux__) || defined(__APPLE__) || defined(__FreeBSD__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define PF_MMAP 1
+#endif
+
+/* FNV-1a, 32-bit */
+static uint32_t fnv(uint32_t h, const void *p, size_t n){
+    const uint8_t *b=(const uint8_t*)p;
+    for(size_t i=0;i<n;i++){ h^=b[i]; h*=16777619u; }
+    return h;
+}
+#define FNV0 2166136261u
+
+static uint32_t table_sum(const PfHeader *h, const PfEntry *ent){
+    PfHeader c=*h; c.table_sum=0;
+    return fnv(fnv(FNV0,&c,sizeof(c)),ent,(size_t)h->n_entries*sizeof(PfEntry));
+}
+
+/* ---- Validation ---- */
+
+int patch_validate_code(const Instr *code, int n, int n_regs, int n_state,
+                        int *fp_regs, int *fp_state){
+    int lr=n_regs>0?n_regs:PATCH_REGS, ls=n_regs>0?n_state:PATCH_STATE;
+    int nr=REG_FREE, ns=0;
+    if(n<0||n>MAX_INSTRS) return PF_E_OPERAND;
+    if(lr>PATCH_REGS) return PF_E_REG;
+    if(ls>PATCH_STATE) return PF_E_STATE;
+    for(int i=0;i<n;i++){
+        Instr   ins=code[i];
+        uint8_t op=INSTR_OP(ins);
+        if(op>=OP_COUNT) return PF_E_OPCODE;
+        int rd=op_reads(op), hi=INSTR_IMM_HI(ins);
+        int m=op==OP_OUT?0:INSTR_DST(ins);
+        if((rd&1)&&INSTR_SRC_A(ins)>m) m=INSTR_SRC_A(ins);
+        if((rd&2)&&INSTR_SRC_B(ins)>m) m=INSTR_SRC_B(ins);
+        if((rd&4)&&INSTR_SRC_C(ins)>m) m=INSTR_SRC_C(ins);
+        if(m>=lr) return PF_E_REG;
+        if(m>=nr) nr=m+1;
+        if(op==OP_ADSR&&(hi>>10)>=32) return PF_E_OPERAND;   /* g_env index */
+        if(op==OP_OUT) break;
+        ns+=instr_state_slots(ins);
+        if(ns>ls) return PF_E_STATE;
+    }
+    if(nr>lr) return PF_E_REG;      /* declared below the reserved registers */
+    if(fp_regs)  *fp_regs=nr;
+    if(fp_state) *fp_state=ns;
+    return PF_OK;
+}
+
+int patch_validate(const PatchProgram *prog){
+    return patch_validate_code(prog->code,prog->n_instrs,prog->n_regs,prog->n_state,NULL,NULL);
+}
+
+/* ---- Writing ---- */
+
+void pf_writer_init(PfWriter *w, void *buf, size_t cap){
+    memset(w,0,sizeof(*w));
+    w->buf=(uint8_t*)buf; w->cap=cap;
+    w->used=sizeof(PfHeader);
+    if(cap<sizeof(PfHeader)) w->err=PF_E_FULL;
+}
+
+static PfEntry *slot(PfWriter *w, int i){
+    return (PfEntry*)(w->buf+w->cap-(size_t)(i+1)*sizeof(PfEntry));
+}
+
+static int add(PfWriter *w, const char *name, uint32_t kind, const void *p,
+               int n, size_t word, int n_regs, int n_state){
+    if(w->err) return w->err;
+    size_t bytes=(size_t)n*word, pad=(bytes+7)&~(size_t)7;
+    size_t table=(size_t)(w->n+1)*sizeof(PfEntry);
+    if(w->cap<table||w->used+pad>w->cap-table){ w->err=PF_E_FULL; return w->err; }
+    PfEntry e; memset(&e,0,sizeof(e));
+    strncpy(e.name,name,PF_NAME-1);
+    e.kind=kind; e.n=(uint32_t)n; e.off=w->used;
+    e.n_regs=(uint16_t)n_regs; e.n_state=(uint16_t)n_state;
+    e.sum=fnv(FNV0,p,bytes);
+    memcpy(w->buf+w->used,p,bytes);
+    memset(w->buf+w->used+bytes,0,pad-bytes);
+    w->used+=pad;
+    memcpy(slot(w,w->n),&e,sizeof(e));
+    return w->n++;
+}
+
+int pf_add_patch(PfWriter *w, const char *name, const PatchProgram *prog){
+    int nr, ns, r=patch_validate_code(prog->code,prog->n_instrs,prog->n_regs,prog->n_state,&nr,&ns);
+    if(r){ if(!w->err) w->err=r; return r; }
+    return add(w,name,PF_PATCH,prog->code,prog->n_instrs,sizeof(Instr),nr,ns);
+}
+
+int pf_add_voice(PfWriter *w, const char *name, const uint32_t *code, int n){
+    if(n<0){ if(!w->err) w->err=PF_E_OPERAND; return PF_E_OPERAND; }
+    return add(w,name,PF_VOICE,code,n,sizeof(uint32_t),0,0);
+}
+
+size_t pf_finish(PfWriter *w){
+    if(w->err) return 0;
+    /* entries were stored last-to-first below cap: reverse them in
+       place, then move the block down behind the payloads */
+    for(int i=0,j=w->n-1;i<j;i++,j--){
+        PfEntry t; memcpy(&t,slot(w,i),sizeof(t));
+        memcpy(slot(w,i),slot(w,j),sizeof(t)); memcpy(slot(w,j),&t,sizeof(t));
+    }
+    if(w->n) memmove(w->buf+w->used,slot(w,w->n-1),(size_t)w->n*sizeof(PfEntry));
+    PfHeader h; memset(&h,0,sizeof(h));
+    memcpy(h.magic,PF_MAGIC,4);
+    h.version=PF_VERSION; h.hdr_size=sizeof(PfHeader);
+    h.n_entries=(uint32_t)w->n;
+    h.table_off=w->used;
+    h.file_size=w->used+(size_t)w->n*sizeof(PfEntry);
+    h.table_sum=table_sum(&h,(const PfEntry*)(w->buf+w->used));
+    memcpy(w->buf,&h,sizeof(h));
+    return (size_t)h.file_size;
+}
+
+/* ---- Reading ---- */
+
+int pf_view(PatchFile *f, const void *buf, size_t size){
+    memset(f,0,sizeof(*f));
+    const PfHeader *h=(const PfHeader*)buf;
+    if(((uintptr_t)buf&7)||size<sizeof(PfHeader)||memcmp(h->magic,PF_MAGIC,4)||
+       h->hdr_size!=sizeof(PfHeader)) return PF_E_FORMAT;
+    if(h->version!=PF_VERSION) return PF_E_VERSION;
+    if(h->file_size!=size||(h->table_off&7)||h->table_off<sizeof(PfHeader)||
+       h->table_off>size||(size-h->table_off)/sizeof(PfEntry)<h->n_entries)
+        return PF_E_BOUNDS;
+    const PfEntry *ent=(const PfEntry*)((const uint8_t*)buf+h->table_off);
+    if(table_sum(h,ent)!=h->table_sum) return PF_E_CHECKSUM;
+    for(uint32_t i=0;i<h->n_entries;i++){
+        const PfEntry *e=&ent[i];
+        size_t word=e->kind==PF_PATCH?sizeof(Instr):sizeof(uint32_t);
+        if(e->kind!=PF_PATCH&&e->kind!=PF_VOICE) return PF_E_ENTRY;
+        if((e->off&7)||e->off<sizeof(PfHeader)||e->off>h->table_off||
+           (h->table_off-e->off)/word<e->n) return PF_E_BOUNDS;
+    }
+    f->base=(const uint8_t*)buf; f->size=size;
+    f->ent=ent; f->n=(int)h->n_entries;
+    return PF_OK;
+}
+
+int pf_open(PatchFile *f, const char *path){
+    memset(f,0,sizeof(*f));
+#ifdef PF_MMAP
+    int fd=open(path,O_RDONLY);
+    if(fd<0) return PF_E_IO;
+    struct stat st;
+    if(fstat(fd,&st)){ close(fd); return PF_E_IO; }
+    if(st.st_size<(off_t)sizeof(PfHeader)){ close(fd); return PF_E_FORMAT; }
+    void *m=mmap(NULL,(size_t)st.st_size,PROT_READ,MAP_SHARED,fd,0);
+    close(fd);                      /* the mapping keeps the file */
+    if(m==MAP_FAILED) return PF_E_IO;
+    int r=pf_view(f,m,(size_t)st.st_size);
+    if(r){ munmap(m,(size_t)st.st_size); return r; }
+    f->map=m;
+    return PF_OK;
+#else
+    (void)path; return PF_E_IO;
+#endif
+}
+
+void pf_close(PatchFile *f){
+#ifdef PF_MMAP
+    if(f->map) munmap(f->map,f->size);
+#endif
+    memset(f,0,sizeof(*f));
+}
+
+int pf_find(const PatchFile *f, const char *name){
+    for(int i=0;i<f->n;i++)
+        if(!strncmp(f->ent[i].name,name,PF_NAME)) return i;
+    return PF_E_ENTRY;
+}
+
+static const void *payload(const PatchFile *f, int i, uint32_t kind, size_t word,
+                           int *n, int *err){
+    int r=PF_OK; const void *p=NULL;
+    if(i<0||i>=f->n||f->ent[i].kind!=kind) r=PF_E_ENTRY;
+    else {
+        const PfEntry *e=&f->ent[i];
+        p=f->base+e->off;
+        if(fnv(FNV0,p,(size_t)e->n*word)!=e->sum){ r=PF_E_CHECKSUM; p=NULL; }
+        else if(n) *n=(int)e->n;
+    }
+    if(err) *err=r;
+    return p;
+}
+
+const Instr *pf_patch_code(const PatchFile *f, int i, int *n, int *err){
+    return (const Instr*)payload(f,i,PF_PATCH,sizeof(Instr),n,err);
+}
+const uint32_t *pf_voice_code(const PatchFile *f, int i, int *n, int *err){
+    return (const uint32_t*)payload(f,i,PF_VOICE,sizeof(uint32_t),n,err);
+}
+
+int pf_patch_load(const PatchFile *f, int i, PatchProgram *out){
+    int n, r;
+    const Instr *code=pf_patch_code(f,i,&n,&r);
+    if(!code) return r;
+    const PfEntry *e=&f->ent[i];
+    r=patch_validate_code(code,n,e->n_regs,e->n_state,NULL,NULL);
+    if(r) return r;
+    memcpy(out->code,code,(size_t)n*sizeof(Instr));
+    out->n_instrs=n; out->n_regs=e->n_regs; out->n_state=e->n_state;
+    return PF_OK;
+}
+
+const char *pf_strerror(int err){
+    switch(err){
+    case PF_OK:         return "ok";
+    case PF_E_IO:       return "i/o error";
+    case PF_E_FORMAT:   return "not a patch file";
+    case PF_E_VERSION:  return "unsupported version";
+    case PF_E_CHECKSUM: return "checksum mismatch";
+    case PF_E_BOUNDS:   return "offset out of bounds";
+    case PF_E_ENTRY:    return "no such entry";
+    case PF_E_OPCODE:   return "unknown opcode";
+    case PF_E_REG:      return "register out of range";
+    case PF_E_STATE:    return "state slot out of range";
+    case PF_E_OPERAND:  return "operand out of range";
+    case PF_E_FULL:     return "buffer full";
+    default:            return "unknown error";
+    }
+}
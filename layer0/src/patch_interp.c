@@ -1,83 +1,38 @@
 /*
  * SHMC Layer 0 — Patch Interpreter
  *
- * Executes a PatchProgram sample-by-sample.
- * State layout: instruction i owns state slots [i*4 .. i*4+3] mod MAX_STATE.
- * No dynamic allocation; designed for eventual LLVM JIT backend.
+ * Executes a PatchProgram block-at-a-time (exec_block) or
+ * sample-by-sample (exec1, the reference path).
+ * State layout: dense, in program order — each stateful instruction owns
+ * instr_state_slots(ins) slots right after those of the previous one, so
+ * stateless ops cost nothing and programs up to MAX_INSTRS never alias.
+ * No dynamic allocation.  patch_jit.c compiles prepared programs to
+ * native code that drives the same block kernels.
  */
 #include "../include/patch_builder.h"
-#include <math.h>
+#include "patch_dsp.h"
+#include "patch_block.h"
+#include "patch_prof_hooks.h"
 #include <string.h>
 
-#define TWO_PI 6.28318530718f
-
-/* ---- xorshift32 RNG mapped to [-1,1] ---- */
-static inline float rng_f(uint32_t *s){
-    *s^=*s<<13; *s^=*s>>17; *s^=*s<<5;
-    return (float)(int32_t)*s*(1.f/2147483648.f);
-}
-
-/* ---- Waveform helpers ---- */
-static inline float osc_tick(float *ph, float freq, float dt){
-    float p=*ph; *ph+=TWO_PI*freq*dt;
-    if(*ph>=TWO_PI)*ph-=TWO_PI;
-    return p;
-}
-static inline float fsin(float x){
-    /* minimax sine, error <0.002 */
-    x-=TWO_PI*floorf(x/TWO_PI+0.5f);
-    float s=x*x; return x*(1.f-s*(1.f/6.f-s/120.f));
-}
-static inline float saw_w(float p){ return 2.f*(p/TWO_PI)-1.f; }
-static inline float sqr_w(float p){ return p<3.14159265f?1.f:-1.f; }
-static inline float tri_w(float p){ float t=p/TWO_PI; return t<.5f?4.f*t-1.f:3.f-4.f*t; }
-static inline float fold_w(float x){ x=x*.5f+.5f; x-=floorf(x); return fabsf(x*2.f-1.f)*2.f-1.f; }
-
-/* ---- One-pole LP coefficient ---- */
-static inline float lpc(float cut, float dt){
-    float w=TWO_PI*cut*dt; return w/(1.f+w);
-}
-
-/* ---- CONST decoding ----
-   lo==0 → mod-table index (hi < 32), else Q8.8 signed float
-   lo==1 → Q8.8 signed float (from pb_const_f)                */
-static inline float decode_const(uint16_t hi, uint16_t lo){
-    extern const float g_mod[32];
-    if(lo==0){ if(hi<32)return g_mod[hi]; return (float)(int16_t)hi/256.f; }
-    return (float)(int16_t)hi/256.f;
-}
-
-/* ---- ADSR ----
-   State layout: [0]=stage  [1]=level  [2]=timer
-   Encoding: hi = att(6b)|dec(5b)|sus(5b),  lo = rel(5b)|0     */
-static inline float adsr_tick(float *st, uint16_t hi, uint16_t lo, float dt){
-    extern float g_env[32]; extern const float g_mod[32];
-    int   stg=(int)st[0]; float lv=st[1],tm=st[2];
-    int   ai=(hi>>10)&0x3F, di=(hi>>5)&0x1F, si=hi&0x1F, ri=(lo>>11)&0x1F;
-    float att=g_env[ai], dec=g_env[di], sus=g_mod[si], rel=g_env[ri];
-    tm+=dt;
-    switch(stg){
-        case 0: lv=tm/att; if(tm>=att){lv=1.f;tm=0;stg=1;} break;
-        case 1: lv=1.f-(1.f-sus)*(tm/dec); if(tm>=dec){lv=sus;tm=0;stg=2;} break;
-        case 2: lv=sus; break;
-        case 3: lv=sus*(1.f-tm/rel); if(lv<0.f){lv=0.f;stg=4;} break;
-        default: lv=0.f;
-    }
-    st[0]=(float)stg; st[1]=lv; st[2]=tm; return lv;
-}
+#define BLOCK_MIN 8
 
 /* ---- Core: execute one sample ---- */
 static float exec1(PatchState *ps, const PatchProgram *prog){
     float *r=ps->regs, *s=ps->state;
     float dt=ps->dt, freq=ps->note_freq;
-    extern float g_cutoff[64]; extern float g_env[32]; extern const float g_mod[32];
+    extern const float g_cutoff[64]; extern const float g_env[32]; extern const float g_mod[32];
 
+    int next_sb=0;
+    float osv[4];                     /* sub-samples of the last oversampled op */
     for(int i=0;i<prog->n_instrs;i++){
         Instr    ins=prog->code[i];
         uint8_t  op=INSTR_OP(ins), dst=INSTR_DST(ins);
         uint8_t  a=INSTR_SRC_A(ins), b=INSTR_SRC_B(ins);
         uint16_t hi=INSTR_IMM_HI(ins), lo=INSTR_IMM_LO(ins);
-        int      sb=(i*4)%MAX_STATE;  /* 4 state slots per instruction */
+        int      sb=next_sb;          /* dense state offset */
+        next_sb+=instr_state_slots(ins);
+        PROF_T0(t0);
 
         switch(op){
         /* Arithmetic */
@@ -90,10 +45,16 @@ static float exec1(PatchState *ps, const PatchProgram *prog){
         case OP_ABS:   r[dst]=fabsf(r[a]); break;
 
         /* Oscillators */
-        case OP_OSC:   { float p=osc_tick(&s[sb],freq*(r[a]>0?r[a]:1.f),dt); r[dst]=fsin(p); break; }
-        case OP_SAW:   { float p=osc_tick(&s[sb],freq*(r[a]>0?r[a]:1.f),dt); r[dst]=saw_w(p); break; }
-        case OP_SQUARE:{ float p=osc_tick(&s[sb],freq*(r[a]>0?r[a]:1.f),dt); r[dst]=sqr_w(p); break; }
-        case OP_TRI:   { float p=osc_tick(&s[sb],freq*(r[a]>0?r[a]:1.f),dt); r[dst]=tri_w(p); break; }
+        case OP_OSC:   { float p=osc_tick(&s[sb],freq*(r[a]>0?r[a]:1.f),dt); r[dst]=lo==MATH_POLY?sin_poly(p):fsin(p); break; }
+        case OP_SAW: case OP_SQUARE: case OP_TRI: {
+            float f=freq*(r[a]>0?r[a]:1.f), p=osc_tick(&s[sb],f,dt);
+            if(lo==OSC_BLEP){
+                float inc=bl_inc(f,dt);
+                r[dst]=op==OP_SAW?saw_bl(p,inc):op==OP_SQUARE?sqr_bl(p,inc):tri_bl(p,inc);
+            } else
+                r[dst]=op==OP_SAW?saw_w(p):op==OP_SQUARE?sqr_w(p):tri_w(p);
+            break;
+        }
         case OP_PHASE: { osc_tick(&s[sb],freq*(r[a]>0?r[a]:1.f),dt); r[dst]=s[sb]; break; }
 
         /* Modulation */
@@ -133,9 +94,14 @@ static float exec1(PatchState *ps, const PatchProgram *prog){
         }
 
         /* Nonlinearities */
-        case OP_TANH: r[dst]=tanhf(r[a]); break;
-        case OP_CLIP: r[dst]=fmaxf(-1.f,fminf(1.f,r[a])); break;
-        case OP_FOLD: r[dst]=fold_w(r[a]); break;
+        case OP_TANH: case OP_FOLD: case OP_CLIP:
+            if(hi==OS_2X||hi==OS_4X){
+                int cont=i>0&&instr_os_continues(prog->code[i-1],ins);
+                os_region(&s[sb],op,(float)lo,hi,cont,&r[a],osv,&r[dst],1); break;
+            }
+            if(op==OP_FOLD){ r[dst]=fold_w(r[a]); break; }
+            if(op==OP_CLIP){ r[dst]=fmaxf(-1.f,fminf(1.f,r[a])); break; }
+            r[dst]=lo==MATH_POLY?tanh_poly(r[a]):tanhf(r[a]); break;
         case OP_SIGN: r[dst]=(r[a]>0.f)?1.f:(r[a]<0.f)?-1.f:0.f; break;
 
         /* Filters */
@@ -159,6 +125,7 @@ static float exec1(PatchState *ps, const PatchProgram *prog){
             float c=(float)(uint8_t)(hi>>8)/255.f;
             s[sb]=c*r[a]+(1.f-c)*s[sb]; r[dst]=s[sb]; break;
         }
+        case OP_SVF: r[dst]=svf_run(&s[sb],r[a],r[b],r[INSTR_SRC_C(ins)],(float)lo,dt); break;
 
         /* Envelope */
         case OP_ADSR:      r[dst]=adsr_tick(&s[sb],hi,lo,dt); break;
@@ -168,7 +135,10 @@ static float exec1(PatchState *ps, const PatchProgram *prog){
         }
         case OP_EXP_DECAY: {
             float rate=(hi<32)?g_mod[hi]*20.f:2.f;
-            r[dst]=expf(-rate*ps->note_time); break;
+            if(lo==MATH_RECUR)     s[sb]=(ps->note_time==0.f)?1.f:s[sb]*expf(-rate*dt);
+            else if(lo==MATH_POLY) s[sb]=exp_poly(-rate*ps->note_time);
+            else                   s[sb]=expf(-rate*ps->note_time);
+            r[dst]=s[sb]; break;
         }
 
         /* Utility */
@@ -181,15 +151,283 @@ static float exec1(PatchState *ps, const PatchProgram *prog){
         }
         case OP_OUT:
             ps->note_time+=dt;
+            PROF_ADD(i,1,t0);
             return r[a]*ps->note_vel;
 
         default: break;
         }
+        PROF_ADD(i,1,t0);
     }
     ps->note_time+=dt;
     return r[0]*ps->note_vel;
 }
 
+/* ---- Block engine ----
+   Runs each instruction across the whole block into per-register sample
+   buffers, so dispatch happens once per block instead of once per sample
+   and the stateless ops become plain element-wise loops.  Instructions
+   are first decoded into DInstr (patch_prepare() does this once per
+   program; a bare patch_note_on() decodes per block) and dispatched
+   through the patch_kernels[] handler table.
+   Output is bit-identical to exec1() as long as every register is written
+   before it is read (no sample-to-sample feedback through registers) and
+   at most one instruction draws from the shared RNG (block_ok(),
+   patch_block.h); other programs are routed through exec1() by
+   patch_step().                                                         */
+
+/* Decode one instruction: table lookups and coefficient math done here.
+   prev is the instruction before it (0 for the first). */
+static void decode_instr(DInstr *d, Instr prev, Instr ins, int sb, float dt){
+    extern const float g_cutoff[64]; extern const float g_env[32]; extern const float g_mod[32];
+    uint16_t hi=INSTR_IMM_HI(ins), lo=INSTR_IMM_LO(ins);
+    memset(d,0,sizeof(*d));
+    d->op=INSTR_OP(ins); d->dst=INSTR_DST(ins);
+    d->a=INSTR_SRC_A(ins); d->b=INSTR_SRC_B(ins);
+    if(op_reads(d->op)&4) d->c=INSTR_SRC_C(ins);
+    d->sb=(uint16_t)sb;
+    switch(d->op){
+    case OP_CONST:     d->k[0]=decode_const(hi,lo); break;
+    case OP_SAW: case OP_SQUARE:
+    case OP_TRI:       d->k[0]=(lo==OSC_BLEP)?1.f:0.f; break;
+    case OP_FM:
+    case OP_AM:        d->k[0]=(hi<32)?g_mod[hi]:0.5f; break;
+    case OP_LP_NOISE:  d->k[0]=(hi<64)?lpc(g_cutoff[hi],dt):0.05f; break;
+    case OP_RAND_STEP: d->k[0]=(float)((hi>0)?(int)hi:100); break;
+    case OP_LPF:
+    case OP_HPF:       d->k[0]=(hi<64)?lpc(g_cutoff[hi],dt):0.1f; break;
+    case OP_BPF:       d->k[0]=(hi<64)?lpc(g_cutoff[hi],dt):0.1f;
+                       d->k[1]=(lo<32)?g_mod[lo]+0.1f:0.5f; break;
+    case OP_ONEPOLE:   d->k[0]=(float)(uint8_t)(hi>>8)/255.f; d->k[1]=1.f-d->k[0]; break;
+    case OP_SVF:       d->k[0]=(float)lo; break;
+    case OP_ADSR:      adsr_params(hi,lo,d->k); break;
+    case OP_RAMP:      d->k[0]=(hi<32)?g_env[hi]:0.1f; break;
+    case OP_EXP_DECAY: d->k[0]=(hi<32)?g_mod[hi]*20.f:2.f;
+                       d->k[1]=(float)lo; d->k[2]=expf(-d->k[0]*dt); break;
+    case OP_OSC:       d->k[0]=(float)lo; break;
+    case OP_TANH: case OP_FOLD:
+    case OP_CLIP:      d->k[0]=(float)lo; d->k[1]=(float)instr_os(ins);
+                       d->k[2]=(float)instr_os_continues(prev,ins); break;
+    case OP_MIXN:      d->k[0]=(hi<32)?g_mod[hi]:0.5f;
+                       d->k[1]=(lo<32)?g_mod[lo]:0.5f; break;
+    default: break;
+    }
+}
+
+#define KERNEL(name) static void name(const DInstr *in, BlockCtx *c)
+#define K_IO  float *d=c->rb[in->dst]; const float *x=c->rb[in->a], *y=c->rb[in->b]; \
+              float *s=c->ps->state+in->sb; int n=c->n; float freq=c->freq, dt=c->dt;  \
+              (void)x; (void)y; (void)s; (void)freq; (void)dt
+#define PITCH(v) (freq*((v)>0?(v):1.f))
+
+/* Arithmetic */
+KERNEL(k_const){ K_IO; for(int k=0;k<n;k++) d[k]=in->k[0]; }
+KERNEL(k_add)  { K_IO; for(int k=0;k<n;k++) d[k]=x[k]+y[k]; }
+KERNEL(k_sub)  { K_IO; for(int k=0;k<n;k++) d[k]=x[k]-y[k]; }
+KERNEL(k_mul)  { K_IO; for(int k=0;k<n;k++) d[k]=x[k]*y[k]; }
+KERNEL(k_div)  { K_IO; for(int k=0;k<n;k++) d[k]=(y[k]!=0.f)?x[k]/y[k]:0.f; }
+KERNEL(k_neg)  { K_IO; for(int k=0;k<n;k++) d[k]=-x[k]; }
+KERNEL(k_abs)  { K_IO; for(int k=0;k<n;k++) d[k]=fabsf(x[k]); }
+
+/* Oscillators */
+KERNEL(k_osc){
+    K_IO;
+    if(in->k[0]==MATH_POLY) for(int k=0;k<n;k++) d[k]=sin_poly(osc_tick(s,PITCH(x[k]),dt));
+    else                    for(int k=0;k<n;k++) d[k]=fsin(osc_tick(s,PITCH(x[k]),dt));
+}
+/* k[0]!=0: band-limited (OSC_BLEP) */
+#define BL_OSC(naive,bl) \
+    if(in->k[0]==0.f){ for(int k=0;k<n;k++) d[k]=naive(osc_tick(s,PITCH(x[k]),dt)); } \
+    else for(int k=0;k<n;k++){ float f=PITCH(x[k]); d[k]=bl(osc_tick(s,f,dt),bl_inc(f,dt)); }
+KERNEL(k_saw)  { K_IO; BL_OSC(saw_w,saw_bl) }
+KERNEL(k_sqr)  { K_IO; BL_OSC(sqr_w,sqr_bl) }
+KERNEL(k_tri)  { K_IO; BL_OSC(tri_w,tri_bl) }
+KERNEL(k_phase){ K_IO; for(int k=0;k<n;k++){ osc_tick(s,PITCH(x[k]),dt); d[k]=s[0]; } }
+
+/* Modulation */
+KERNEL(k_fm){
+    K_IO; float md=in->k[0], ph=s[0];
+    for(int k=0;k<n;k++){
+        ph+=TWO_PI*PITCH(x[k])*dt+md*y[k];
+        if(ph>=TWO_PI)ph-=TWO_PI;
+        d[k]=fsin(ph);
+    }
+    s[0]=ph;
+}
+KERNEL(k_pm){ K_IO; for(int k=0;k<n;k++) d[k]=fsin(osc_tick(s,PITCH(x[k]),dt)+y[k]); }
+KERNEL(k_am){ K_IO; float md=in->k[0]; for(int k=0;k<n;k++) d[k]=x[k]*(1.f+md*y[k]); }
+KERNEL(k_sync){
+    K_IO;
+    for(int k=0;k<n;k++){
+        float prev=s[0]; s[0]=x[k];
+        if(prev<=0.f&&x[k]>0.f)s[1]=0.f;
+        d[k]=fsin(osc_tick(&s[1],freq*(y[k]>0?y[k]:2.f),dt));
+    }
+}
+
+/* Noise */
+KERNEL(k_noise){ K_IO; uint32_t *g=&c->ps->rng; for(int k=0;k<n;k++) d[k]=rng_f(g); }
+KERNEL(k_lp_noise){
+    K_IO; uint32_t *g=&c->ps->rng; float cf=in->k[0], z=s[0];
+    for(int k=0;k<n;k++){ float v=rng_f(g); z+=cf*(v-z); d[k]=z; }
+    s[0]=z;
+}
+KERNEL(k_rand_step){
+    K_IO; uint32_t *g=&c->ps->rng;
+    for(int k=0;k<n;k++){
+        if((int)s[1]<=0){s[0]=rng_f(g);s[1]=in->k[0];}
+        s[1]-=1.f; d[k]=s[0];
+    }
+}
+
+/* Nonlinearities */
+/* k[1]: oversampling factor (OS_2X / OS_4X), 0 at the base rate;
+   k[2]: continues the previous op's region (instr_os_continues()) */
+#define OS_NL(op) if(in->k[1]!=0.f){ os_region(s,op,in->k[0],(int)in->k[1],in->k[2]!=0.f,x,c->osv,d,n); return; }
+KERNEL(k_tanh){
+    K_IO; OS_NL(OP_TANH)
+    if(in->k[0]==MATH_POLY) for(int k=0;k<n;k++) d[k]=tanh_poly(x[k]);
+    else                    for(int k=0;k<n;k++) d[k]=tanhf(x[k]);
+}
+KERNEL(k_clip){ K_IO; OS_NL(OP_CLIP) for(int k=0;k<n;k++) d[k]=fmaxf(-1.f,fminf(1.f,x[k])); }
+KERNEL(k_fold){ K_IO; OS_NL(OP_FOLD) for(int k=0;k<n;k++) d[k]=fold_w(x[k]); }
+KERNEL(k_sign){ K_IO; for(int k=0;k<n;k++) d[k]=(x[k]>0.f)?1.f:(x[k]<0.f)?-1.f:0.f; }
+
+/* Filters */
+KERNEL(k_lpf){ K_IO; float cf=in->k[0], z=s[0]; for(int k=0;k<n;k++){ z+=cf*(x[k]-z); d[k]=z; } s[0]=z; }
+KERNEL(k_hpf){ K_IO; float cf=in->k[0], z=s[0]; for(int k=0;k<n;k++){ z=z+cf*(x[k]-z); d[k]=x[k]-z; } s[0]=z; }
+KERNEL(k_bpf){
+    K_IO; float cf=in->k[0], q=in->k[1], lv=s[0], bv=s[1];
+    for(int k=0;k<n;k++){
+        float hv=x[k]-lv-q*bv;
+        bv+=cf*hv; lv+=cf*bv; d[k]=bv;
+    }
+    s[0]=lv; s[1]=bv;
+}
+KERNEL(k_onepole){
+    K_IO; float cf=in->k[0], cz=in->k[1], z=s[0];
+    for(int k=0;k<n;k++){ z=cf*x[k]+cz*z; d[k]=z; }
+    s[0]=z;
+}
+/* x = input, y = cutoff, q = Q; coefficients rebuilt only on change */
+KERNEL(k_svf){
+    K_IO; const float *q=c->rb[in->c]; float mode=in->k[0], z[8];
+    memcpy(z,s,sizeof(z));               /* a local copy stays in registers */
+    for(int k=0;k<n;k++) d[k]=svf_run(z,x[k],y[k],q[k],mode,dt);
+    memcpy(s,z,sizeof(z));
+}
+
+/* Envelope */
+KERNEL(k_adsr){
+    K_IO;
+    for(int k=0;k<n;k++) d[k]=adsr_run(s,in->k[0],in->k[1],in->k[2],in->k[3],dt);
+}
+KERNEL(k_ramp)     { K_IO; float dur=in->k[0];  for(int k=0;k<n;k++) d[k]=fminf(1.f,c->tm[k]/dur); }
+KERNEL(k_exp_decay){
+    K_IO; float rate=in->k[0];
+    if(in->k[1]==MATH_RECUR){
+        float g=in->k[2], z=s[0];
+        for(int k=0;k<n;k++){ z=(c->tm[k]==0.f)?1.f:z*g; d[k]=z; }
+    }
+    else if(in->k[1]==MATH_POLY) for(int k=0;k<n;k++) d[k]=exp_poly(-rate*c->tm[k]);
+    else                         for(int k=0;k<n;k++) d[k]=expf(-rate*c->tm[k]);
+    s[0]=d[n-1];
+}
+
+/* Utility */
+KERNEL(k_min) { K_IO; for(int k=0;k<n;k++) d[k]=fminf(x[k],y[k]); }
+KERNEL(k_max) { K_IO; for(int k=0;k<n;k++) d[k]=fmaxf(x[k],y[k]); }
+KERNEL(k_mixn){ K_IO; float wa=in->k[0], wb=in->k[1]; for(int k=0;k<n;k++) d[k]=x[k]*wa+y[k]*wb; }
+
+const BlockKernel patch_kernels[OP_COUNT]={
+    [OP_CONST]=k_const, [OP_ADD]=k_add, [OP_SUB]=k_sub, [OP_MUL]=k_mul,
+    [OP_DIV]=k_div,     [OP_NEG]=k_neg, [OP_ABS]=k_abs,
+    [OP_OSC]=k_osc, [OP_SAW]=k_saw, [OP_SQUARE]=k_sqr, [OP_TRI]=k_tri, [OP_PHASE]=k_phase,
+    [OP_FM]=k_fm, [OP_PM]=k_pm, [OP_AM]=k_am, [OP_SYNC]=k_sync,
+    [OP_NOISE]=k_noise, [OP_LP_NOISE]=k_lp_noise, [OP_RAND_STEP]=k_rand_step,
+    [OP_TANH]=k_tanh, [OP_CLIP]=k_clip, [OP_FOLD]=k_fold, [OP_SIGN]=k_sign,
+    [OP_LPF]=k_lpf, [OP_HPF]=k_hpf, [OP_BPF]=k_bpf, [OP_ONEPOLE]=k_onepole,
+    [OP_ADSR]=k_adsr, [OP_RAMP]=k_ramp, [OP_EXP_DECAY]=k_exp_decay,
+    [OP_MIN]=k_min, [OP_MAX]=k_max, [OP_MIXN]=k_mixn,
+    [OP_SVF]=k_svf,
+};
+
+/* Run one block (n <= AUDIO_BLOCK).  pp may be NULL, in which case the
+   raw program is decoded on the fly — still once per block, not sample. */
+static void exec_block(PatchState *ps, const PatchProgram *prog,
+                       const PreparedProgram *pp, float *out, int n){
+    float rb[PATCH_REGS][AUDIO_BLOCK] __attribute__((aligned(32)));
+    float osv[4*AUDIO_BLOCK];
+    float *r=ps->regs;
+    const float *res=rb[0];
+    BlockCtx c={rb,ps,rb[REG_TIME],ps->note_freq,ps->dt,n,osv};
+
+    for(int k=0;k<n;k++){
+        rb[REG_FREQ][k]=r[REG_FREQ]; rb[REG_VEL][k]=r[REG_VEL];
+        rb[REG_ONE][k]=r[REG_ONE];
+        rb[REG_TIME][k]=ps->note_time; ps->note_time+=ps->dt;
+    }
+    r[REG_TIME]=rb[REG_TIME][n-1];
+
+    int ni=pp?pp->n_instrs:prog->n_instrs, sb=0, o=-1;
+    /* profiling attributes per instruction, so it runs the kernels */
+    if(pp&&pp->jit&&!PROF_ON){ res=((PatchJitFn)pp->jit)(rb,&c,pp->code); ni=0; }
+    PROF_SCOPE(prog,n);
+    for(int i=0;i<ni;i++){
+        DInstr tmp; const DInstr *in;
+        if(pp) in=&pp->code[i];
+        else {
+            decode_instr(&tmp,i?prog->code[i-1]:0,prog->code[i],sb,ps->dt); in=&tmp;
+            sb+=instr_state_slots(prog->code[i]);
+        }
+        if(in->op==OP_OUT){ res=rb[in->a]; o=i; break; }
+        if(in->op>=OP_COUNT) continue;
+        PROF_T0(t0);
+        patch_kernels[in->op](in,&c);
+        r[in->dst]=rb[in->dst][n-1];
+        PROF_ADD(i,n,t0);
+    }
+    PROF_T0(t0);
+    for(int k=0;k<n;k++) out[k]=res[k]*ps->note_vel;
+    if(o>=0) PROF_ADD(o,n,t0);
+}
+
+/* ---- Prepared programs ---- */
+
+/* Register/state footprint from a scan of the executed instructions */
+static void footprint(const PatchProgram *prog, int *n_regs, int *n_state){
+    int nr=REG_FREE, ns=0;
+    for(int i=0;i<prog->n_instrs;i++){
+        Instr   ins=prog->code[i];
+        uint8_t op=INSTR_OP(ins), rd=op_reads(op);
+        if((rd&1)&&INSTR_SRC_A(ins)>=nr) nr=INSTR_SRC_A(ins)+1;
+        if((rd&2)&&INSTR_SRC_B(ins)>=nr) nr=INSTR_SRC_B(ins)+1;
+        if((rd&4)&&INSTR_SRC_C(ins)>=nr) nr=INSTR_SRC_C(ins)+1;
+        if(op==OP_OUT) break;
+        if(op<OP_COUNT&&INSTR_DST(ins)>=nr) nr=INSTR_DST(ins)+1;
+        ns+=instr_state_slots(ins);
+    }
+    *n_regs=nr; *n_state=ns;
+}
+
+int patch_prepare(PreparedProgram *pp, const PatchProgram *prog, float sr){
+    if(!pp) return -1;
+    pp->src=NULL; pp->jit=NULL;
+    if(!prog||prog->n_instrs>MAX_INSTRS) return -1;
+    footprint(prog,&pp->n_regs,&pp->n_state);
+    if(pp->n_regs>PATCH_REGS||pp->n_state>PATCH_STATE) return -1;
+    pp->src=prog; pp->sr=sr; pp->dt=1.f/sr;
+    pp->block_ok=block_ok(prog);
+    pp->n_instrs=0; pp->n_envs=0;
+    for(int i=0,sb=0;i<prog->n_instrs;i++){
+        DInstr *d=&pp->code[pp->n_instrs++];
+        decode_instr(d,i?prog->code[i-1]:0,prog->code[i],sb,pp->dt);
+        sb+=instr_state_slots(prog->code[i]);
+        if(d->op==OP_ADSR) pp->env_sb[pp->n_envs++]=d->sb;
+        if(d->op==OP_OUT) break;
+    }
+    return 0;
+}
+
 /* ---- Public API ---- */
 
 void patch_reset(Patch *p){
@@ -197,10 +435,14 @@ void patch_reset(Patch *p){
     p->st.rng=0xDEADBEEFu;
 }
 
-void patch_note_on(Patch *p, const PatchProgram *prog,
-                   float sr, int midi, float vel){
-    tables_init();
-    patch_reset(p);
+/* Note-on: clear only the first n_regs registers and n_state slots */
+static void note_start(Patch *p, const PatchProgram *prog, float sr,
+                       int n_regs, int n_state, int midi, float vel){
+    p->prep=NULL;
+    if(n_regs>PATCH_REGS||n_state>PATCH_STATE){ p->prog=NULL; return; }
+    memset(p->st.regs, 0,(size_t)n_regs *sizeof(float));
+    memset(p->st.state,0,(size_t)n_state*sizeof(float));
+    p->st.rng=0xDEADBEEFu;
     p->prog=prog;
     p->st.sr=sr; p->st.dt=1.f/sr;
     p->st.note_freq=freq_from_midi(midi);
@@ -212,11 +454,71 @@ void patch_note_on(Patch *p, const PatchProgram *prog,
     p->st.regs[REG_ONE] =1.f;
 }
 
-int patch_step(Patch *p, float *out, int n){
+/* The footprint is scanned, as patch_prepare() does, not taken from
+   n_regs/n_state: an under-declared program would otherwise overrun
+   regs[] or keep the previous note's state */
+void patch_note_on(Patch *p, const PatchProgram *prog,
+                   float sr, int midi, float vel){
+    int nr, ns;
+    footprint(prog,&nr,&ns);
+    note_start(p,prog,sr,nr,ns,midi,vel);
+}
+
+int patch_step_scalar(Patch *p, float *out, int n){
     if(!p||!p->prog||!out)return -1;
+    PROF_SCOPE(p->prog,n);
     for(int i=0;i<n;i++){
         p->st.regs[REG_TIME]=p->st.note_time;
         out[i]=exec1(&p->st,p->prog);
     }
     return 0;
 }
+
+void patch_note_on_prepared(Patch *p, const PreparedProgram *pp,
+                            int midi, float vel){
+    if(!pp->src){ p->prog=NULL; p->prep=NULL; return; }
+    note_start(p,pp->src,pp->sr,pp->n_regs,pp->n_state,midi,vel);
+    if(p->prog) p->prep=pp;
+}
+
+/* Envelope state offsets: the prepared gate table, or a scan of the raw
+   program (into buf) for voices started without one */
+static const uint16_t *env_offsets(const Patch *p, uint16_t *buf, int *n){
+    if(p->prep){ *n=p->prep->n_envs; return p->prep->env_sb; }
+    *n=0;
+    for(int i=0,sb=0;i<p->prog->n_instrs;i++){
+        uint8_t op=INSTR_OP(p->prog->code[i]);
+        if(op==OP_ADSR) buf[(*n)++]=(uint16_t)sb;
+        sb+=instr_state_slots(p->prog->code[i]);
+    }
+    return buf;
+}
+
+void patch_note_off(Patch *p){
+    if(!p||!p->prog) return;
+    uint16_t buf[MAX_INSTRS]; int n;
+    const uint16_t *sb=env_offsets(p,buf,&n);
+    for(int g=0;g<n;g++) adsr_gate_off(&p->st.state[sb[g]]);
+}
+
+int patch_done(const Patch *p){
+    if(!p||!p->prog) return -1;
+    uint16_t buf[MAX_INSTRS]; int n;
+    const uint16_t *sb=env_offsets(p,buf,&n);
+    if(n==0) return -1;
+    for(int g=0;g<n;g++) if(p->st.state[sb[g]]<(float)ADSR_DONE) return 0;
+    return 1;
+}
+
+int patch_step(Patch *p, float *out, int n){
+    if(!p||!p->prog||!out)return -1;
+    const PreparedProgram *pp=p->prep;
+    /* Short spans don't amortize the block setup */
+    if(n<BLOCK_MIN||!(pp?pp->block_ok:block_ok(p->prog)))
+        return patch_step_scalar(p,out,n);
+    for(int i=0;i<n;i+=AUDIO_BLOCK){
+        int c=n-i<AUDIO_BLOCK?n-i:AUDIO_BLOCK;
+        exec_block(&p->st,p->prog,pp,out+i,c);
+    }
+    return 0;
+}
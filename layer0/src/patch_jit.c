@@ -0,0 +1,211 @@
+/*
+ * SHMC Layer 0 — native x86-64 backend
+ *
+ * A small self-contained emitter, System V ABI.  The generated function
+ *   const float *fn(float (*rb)[AUDIO_BLOCK], BlockCtx *c, const DInstr *code)
+ * keeps rb in rbx, c in r12 and code in r13 for its whole body.  Inline
+ * ops address register buffers as [rbx + reg*AUDIO_BLOCK*4 + k*16] with
+ * constants broadcast into spare xmm registers once per instruction; they
+ * always process the full AUDIO_BLOCK, so short blocks just compute a
+ * few unused lanes.  Kernel calls pass &code[i] and c, as the interpreter
+ * loop does.
+ *
+ * Code is emitted into a scratch buffer, then copied into a fresh
+ * mapping that is switched to read+exec (never writable and executable).
+ */
+#include "../include/patch_jit.h"
+#include "patch_block.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__) || defined(__FreeBSD__))
+#include <sys/mman.h>
+
+#define JIT_CACHE     64
+#define JIT_MAX_INSTR 1024          /* bytes of code per instruction, upper bound */
+
+typedef struct {
+    uint64_t   hash;
+    int        n;
+    Instr     *code;                /* copy of the source, to confirm hits */
+    void      *fn;
+    size_t     size;
+} JitEntry;
+
+static JitEntry s_cache[JIT_CACHE];
+static int      s_n_cache;
+
+/* FNV-1a over the executed instructions */
+static uint64_t prog_hash(const Instr *code, int n){
+    uint64_t h=1469598103934665603ull;
+    const uint8_t *p=(const uint8_t*)code;
+    for(size_t i=0;i<(size_t)n*sizeof(Instr);i++){ h^=p[i]; h*=1099511628211ull; }
+    return h;
+}
+
+typedef struct { uint8_t *p; size_t n; } Emit;
+
+static void b1(Emit *e, uint8_t x){ e->p[e->n++]=x; }
+static void b4(Emit *e, uint32_t x){ memcpy(e->p+e->n,&x,4); e->n+=4; }
+static void b8(Emit *e, uint64_t x){ memcpy(e->p+e->n,&x,8); e->n+=8; }
+
+/* Byte offset of sample group k (4 lanes) of register r */
+#define RB(r,k) ((uint32_t)((r)*AUDIO_BLOCK*4+(k)*16))
+#define GROUPS  (AUDIO_BLOCK/4)
+
+enum { MOVUPS_LD=0x10, MOVUPS_ST=0x11, ANDPS=0x54, XORPS=0x57,
+       ADDPS=0x58, MULPS=0x59, SUBPS=0x5C, DIVPS=0x5E };
+
+/* op xmm(x), [rbx+disp32]   (or the store form for MOVUPS_ST) */
+static void sse_m(Emit *e, uint8_t op, int x, uint32_t disp){
+    b1(e,0x0F); b1(e,op); b1(e,(uint8_t)(0x83|(x<<3))); b4(e,disp);
+}
+/* op xmm(d), xmm(s) */
+static void sse_r(Emit *e, uint8_t op, int d, int s){
+    b1(e,0x0F); b1(e,op); b1(e,(uint8_t)(0xC0|(d<<3)|s));
+}
+/* xmm(x) = {bits,bits,bits,bits} */
+static void bcast(Emit *e, int x, uint32_t bits){
+    b1(e,0xB8); b4(e,bits);                                   /* mov eax, imm32   */
+    b1(e,0x66); b1(e,0x0F); b1(e,0x6E); b1(e,(uint8_t)(0xC0|(x<<3)));  /* movd x, eax */
+    b1(e,0x0F); b1(e,0xC6); b1(e,(uint8_t)(0xC0|(x<<3)|x)); b1(e,0); /* shufps x,x,0 */
+}
+static void bcastf(Emit *e, int x, float v){ uint32_t u; memcpy(&u,&v,4); bcast(e,x,u); }
+
+/* Inline SSE body for op, or 0 if it goes through its kernel */
+static int emit_inline(Emit *e, const DInstr *in){
+    int d=in->dst, a=in->a, b=in->b;
+    switch(in->op){
+    case OP_CONST:
+        bcastf(e,7,in->k[0]);
+        for(int k=0;k<GROUPS;k++) sse_m(e,MOVUPS_ST,7,RB(d,k));
+        return 1;
+    case OP_ADD: case OP_SUB: case OP_MUL: {
+        uint8_t op=in->op==OP_ADD?ADDPS:in->op==OP_SUB?SUBPS:MULPS;
+        for(int k=0;k<GROUPS;k++){
+            sse_m(e,MOVUPS_LD,0,RB(a,k)); sse_m(e,op,0,RB(b,k));
+            sse_m(e,MOVUPS_ST,0,RB(d,k));
+        }
+        return 1;
+    }
+    case OP_DIV:                                  /* (y!=0) ? x/y : 0 */
+        sse_r(e,XORPS,3,3);
+        for(int k=0;k<GROUPS;k++){
+            sse_m(e,MOVUPS_LD,1,RB(b,k)); sse_m(e,MOVUPS_LD,0,RB(a,k));
+            sse_r(e,DIVPS,0,1);
+            b1(e,0x0F); b1(e,0xC2); b1(e,0xCB); b1(e,4);  /* cmpneqps xmm1, xmm3 */
+            sse_r(e,ANDPS,0,1);
+            sse_m(e,MOVUPS_ST,0,RB(d,k));
+        }
+        return 1;
+    case OP_NEG: case OP_ABS: {
+        int neg=in->op==OP_NEG;
+        bcast(e,7,neg?0x80000000u:0x7FFFFFFFu);
+        for(int k=0;k<GROUPS;k++){
+            sse_m(e,MOVUPS_LD,0,RB(a,k)); sse_r(e,neg?XORPS:ANDPS,0,7);
+            sse_m(e,MOVUPS_ST,0,RB(d,k));
+        }
+        return 1;
+    }
+    case OP_AM:                                   /* x*(1+md*y) */
+        bcastf(e,7,in->k[0]); bcastf(e,6,1.f);
+        for(int k=0;k<GROUPS;k++){
+            sse_m(e,MOVUPS_LD,1,RB(b,k)); sse_r(e,MULPS,1,7); sse_r(e,ADDPS,1,6);
+            sse_m(e,MOVUPS_LD,0,RB(a,k)); sse_r(e,MULPS,0,1);
+            sse_m(e,MOVUPS_ST,0,RB(d,k));
+        }
+        return 1;
+    case OP_MIXN:                                 /* x*wa+y*wb */
+        bcastf(e,6,in->k[0]); bcastf(e,7,in->k[1]);
+        for(int k=0;k<GROUPS;k++){
+            sse_m(e,MOVUPS_LD,0,RB(a,k)); sse_r(e,MULPS,0,6);
+            sse_m(e,MOVUPS_LD,1,RB(b,k)); sse_r(e,MULPS,1,7);
+            sse_r(e,ADDPS,0,1);
+            sse_m(e,MOVUPS_ST,0,RB(d,k));
+        }
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/* call patch_kernels[op](&code[i], c) */
+static void emit_call(Emit *e, const DInstr *in, int i){
+    uint64_t fn=(uint64_t)(uintptr_t)patch_kernels[in->op];
+    b1(e,0x49); b1(e,0x8D); b1(e,0xBD); b4(e,(uint32_t)(i*sizeof(DInstr))); /* lea rdi,[r13+disp] */
+    b1(e,0x4C); b1(e,0x89); b1(e,0xE6);                                      /* mov rsi, r12       */
+    b1(e,0x48); b1(e,0xB8); b8(e,fn);                                        /* mov rax, imm64     */
+    b1(e,0xFF); b1(e,0xD0);                                                  /* call rax           */
+}
+
+static size_t compile(const PreparedProgram *pp, uint8_t *buf){
+    Emit e={buf,0};
+    int out=0;
+    b1(&e,0x53); b1(&e,0x41); b1(&e,0x54); b1(&e,0x41); b1(&e,0x55); /* push rbx, r12, r13 */
+    b1(&e,0x48); b1(&e,0x89); b1(&e,0xFB);                           /* mov rbx, rdi */
+    b1(&e,0x49); b1(&e,0x89); b1(&e,0xF4);                           /* mov r12, rsi */
+    b1(&e,0x49); b1(&e,0x89); b1(&e,0xD5);                           /* mov r13, rdx */
+    for(int i=0;i<pp->n_instrs;i++){
+        const DInstr *in=&pp->code[i];
+        if(in->op==OP_OUT){ out=in->a; break; }
+        if(!emit_inline(&e,in)) emit_call(&e,in,i);
+    }
+    b1(&e,0x48); b1(&e,0x8D); b1(&e,0x83); b4(&e,RB(out,0));       /* lea rax,[rbx+out] */
+    b1(&e,0x41); b1(&e,0x5D); b1(&e,0x41); b1(&e,0x5C); b1(&e,0x5B); /* pop r13, r12, rbx */
+    b1(&e,0xC3);
+    return e.n;
+}
+
+static void *map_code(const uint8_t *buf, size_t n, size_t *size){
+    *size=(n+4095)&~(size_t)4095;
+    void *m=mmap(NULL,*size,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS,-1,0);
+    if(m==MAP_FAILED) return NULL;
+    memcpy(m,buf,n);
+    if(mprotect(m,*size,PROT_READ|PROT_EXEC)!=0){ munmap(m,*size); return NULL; }
+    return m;
+}
+
+int patch_jit(PreparedProgram *pp){
+    if(!pp||!pp->src) return -1;
+    pp->jit=NULL;
+    if(!pp->block_ok) return -1;
+    for(int i=0;i<pp->n_instrs;i++) if(pp->code[i].op>=OP_COUNT) return -1;
+
+    const Instr *src=pp->src->code; int n=pp->n_instrs;
+    uint64_t h=prog_hash(src,n);
+    for(int c=0;c<s_n_cache;c++){
+        JitEntry *ce=&s_cache[c];
+        if(ce->hash==h&&ce->n==n&&!memcmp(ce->code,src,(size_t)n*sizeof(Instr))){
+            pp->jit=ce->fn; return 0;
+        }
+    }
+    if(s_n_cache>=JIT_CACHE) return -1;
+
+    uint8_t *buf=(uint8_t*)malloc((size_t)(n+1)*JIT_MAX_INSTR);
+    Instr   *cp =(Instr*)malloc((size_t)n*sizeof(Instr));
+    JitEntry *ce=&s_cache[s_n_cache];
+    ce->fn=NULL;
+    if(buf&&cp) ce->fn=map_code(buf,compile(pp,buf),&ce->size);
+    free(buf);
+    if(!ce->fn){ free(cp); return -1; }
+    memcpy(cp,src,(size_t)n*sizeof(Instr));
+    ce->hash=h; ce->n=n; ce->code=cp;
+    s_n_cache++;
+    pp->jit=ce->fn;
+    return 0;
+}
+
+void patch_jit_clear(void){
+    for(int c=0;c<s_n_cache;c++){
+        munmap(s_cache[c].fn,s_cache[c].size);
+        free(s_cache[c].code);
+    }
+    s_n_cache=0;
+}
+
+#else  /* no native backend on this platform */
+
+int  patch_jit(PreparedProgram *pp){ if(pp) pp->jit=NULL; return -1; }
+void patch_jit_clear(void){}
+
+#endif
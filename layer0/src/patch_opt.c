@@ -0,0 +1,217 @@
+/*
+ * SHMC Layer 0 — PatchProgram optimizer
+ *
+ * The executed part of the program (up to its first OUT) is lifted into
+ * a value graph: one node per computed value, each register mapped to the
+ * node it currently holds.  Folding, identities and CSE are applied while
+ * the graph is built; liveness and register allocation run over it after.
+ * Nodes stay in program order, so stateful ops and RNG draws keep their
+ * relative order and emission needs no scheduling.  Dropping a node can
+ * make two oversampled ops adjacent (instr_os_continues()); the program
+ * is then kept verbatim rather than change which ops share a region.
+ */
+#include "../include/patch_opt.h"
+#include "patch_dsp.h"
+#include <string.h>
+
+#define OP_INPUT 0xFF         /* node for a reserved register */
+
+typedef struct {
+    uint8_t  op, pure, konst, live;
+    uint8_t  cont;            /* continues an oversampled region  */
+    uint16_t hi, lo;
+    int      a, b, c;         /* operand nodes, -1 if not read    */
+    float    val;             /* value, when konst                */
+    int      reg, last;       /* register, node index of last use */
+} ONode;
+
+static int is_rng(uint8_t op){ return op==OP_NOISE||op==OP_LP_NOISE||op==OP_RAND_STEP; }
+static int same(float x, float y){ return memcmp(&x,&y,sizeof(float))==0; }
+static float mod_or_half(uint16_t i){ return (i<32)?g_mod[i]:0.5f; }
+
+/* Pure ops whose result depends on their immediates */
+static int uses_imm(uint8_t op){
+    return op==OP_CONST||op==OP_AM||op==OP_MIXN||op==OP_RAMP||op==OP_TANH;
+}
+
+/* Same expressions as exec1(), so folded values round identically */
+static float eval_pure(uint8_t op, float x, float y, uint16_t hi, uint16_t lo){
+    switch(op){
+    case OP_CONST: return decode_const(hi,lo);
+    case OP_ADD:   return x+y;
+    case OP_SUB:   return x-y;
+    case OP_MUL:   return x*y;
+    case OP_DIV:   return (y!=0.f)?x/y:0.f;
+    case OP_NEG:   return -x;
+    case OP_ABS:   return fabsf(x);
+    case OP_AM:    return x*(1.f+mod_or_half(hi)*y);
+    case OP_TANH:  return lo==MATH_POLY?tanh_poly(x):tanhf(x);
+    case OP_CLIP:  return fmaxf(-1.f,fminf(1.f,x));
+    case OP_FOLD:  return fold_w(x);
+    case OP_SIGN:  return (x>0.f)?1.f:(x<0.f)?-1.f:0.f;
+    case OP_MIN:   return fminf(x,y);
+    case OP_MAX:   return fmaxf(x,y);
+    case OP_MIXN:  { float wa=mod_or_half(hi), wb=mod_or_half(lo); return x*wa+y*wb; }
+    default:       return 0.f;
+    }
+}
+
+/* A CONST encoding that decodes to exactly v, if there is one */
+static int const_enc(float v, uint16_t *hi, uint16_t *lo){
+    float q=v*256.f;
+    if(q>=-32768.f&&q<=32767.f&&q==(float)(int)q&&same((float)(int16_t)(int)q/256.f,v)){
+        *hi=(uint16_t)(int16_t)(int)q; *lo=1; return 1;
+    }
+    for(int i=0;i<32;i++) if(same(g_mod[i],v)){ *hi=(uint16_t)i; *lo=0; return 1; }
+    return 0;
+}
+
+/* Operand node n is equivalent to, or -1: x*1 and zero-depth AM
+   (x*(1+0*y) == x for finite y) */
+static int identity(const ONode *nd, const ONode *n){
+    if(n->op==OP_MUL){
+        if(nd[n->a].konst&&same(nd[n->a].val,1.f)) return n->b;
+        if(nd[n->b].konst&&same(nd[n->b].val,1.f)) return n->a;
+    }
+    if(n->op==OP_AM&&mod_or_half(n->hi)==0.f) return n->a;
+    return -1;
+}
+
+/* Earlier node computing the same value, or -1 */
+static int find_same(const ONode *nd, int nn, const ONode *n){
+    for(int j=0;j<nn;j++){
+        const ONode *m=&nd[j];
+        if(n->konst){ if(m->konst&&same(m->val,n->val)) return j; continue; }
+        if(m->pure&&m->op==n->op&&m->a==n->a&&m->b==n->b&&m->hi==n->hi&&m->lo==n->lo)
+            return j;
+    }
+    return -1;
+}
+
+/* Register/state footprint of the executed instructions */
+static void measure(const PatchProgram *p, int *n_regs, int *n_state){
+    int nr=REG_FREE, ns=0;
+    for(int i=0;i<p->n_instrs&&i<MAX_INSTRS;i++){
+        Instr   ins=p->code[i];
+        uint8_t op=INSTR_OP(ins), rd=op_reads(op);
+        if((rd&1)&&INSTR_SRC_A(ins)>=nr) nr=INSTR_SRC_A(ins)+1;
+        if((rd&2)&&INSTR_SRC_B(ins)>=nr) nr=INSTR_SRC_B(ins)+1;
+        if((rd&4)&&INSTR_SRC_C(ins)>=nr) nr=INSTR_SRC_C(ins)+1;
+        if(op==OP_OUT) break;
+        if(op<OP_COUNT&&INSTR_DST(ins)>=nr) nr=INSTR_DST(ins)+1;
+        ns+=instr_state_slots(ins);
+    }
+    *n_regs=nr; *n_state=ns;
+}
+
+int patch_optimize(PatchProgram *dst, const PatchProgram *src, PatchOptStats *st){
+    ONode nd[REG_FREE+MAX_INSTRS];
+    int   cur[MAX_REGS], nn=REG_FREE, out=-1;
+    PatchOptStats s;
+    PatchProgram  o;
+    memset(&s,0,sizeof(s));
+    s.instrs_before=src->n_instrs;
+    measure(src,&s.regs_before,&s.state_before);
+    if(src->n_instrs>MAX_INSTRS) goto verbatim;
+
+    /* Build the value graph, folding and merging as we go */
+    memset(nd,0,sizeof(ONode)*REG_FREE);
+    for(int r=0;r<MAX_REGS;r++) cur[r]=(r<REG_FREE)?r:-1;
+    for(int r=0;r<REG_FREE;r++){ nd[r].op=OP_INPUT; nd[r].a=nd[r].b=nd[r].c=-1; nd[r].reg=r; }
+    nd[REG_ONE].konst=1; nd[REG_ONE].val=1.f;
+
+    for(int i=0;i<src->n_instrs;i++){
+        Instr   ins=src->code[i];
+        uint8_t op=INSTR_OP(ins), rd=op_reads(op);
+        if(op>=OP_COUNT) continue;            /* a no-op on every engine */
+        int a=(rd&1)?cur[INSTR_SRC_A(ins)]:-1, b=(rd&2)?cur[INSTR_SRC_B(ins)]:-1;
+        int c=(rd&4)?cur[INSTR_SRC_C(ins)]:-1;
+        if(((rd&1)&&a<0)||((rd&2)&&b<0)||((rd&4)&&c<0)) goto verbatim;
+        if(op==OP_OUT){ out=a; break; }
+        if(INSTR_DST(ins)<REG_FREE) goto verbatim;
+
+        ONode *n=&nd[nn]; int v;
+        memset(n,0,sizeof(*n));
+        n->op=op; n->a=a; n->b=b; n->c=c; n->reg=-1;
+        n->hi=INSTR_IMM_HI(ins); n->lo=INSTR_IMM_LO(ins);
+        n->cont=(uint8_t)instr_os_continues(i?src->code[i-1]:0,ins);
+        n->pure=!instr_state_slots(ins)&&!is_rng(op);
+        if(!n->pure) v=nn++;
+        else {
+            if(!uses_imm(op)) n->hi=n->lo=0;
+            if((op==OP_ADD||op==OP_MUL)&&a>b){ n->a=b; n->b=a; }
+            if(op!=OP_RAMP&&(a<0||nd[a].konst)&&(b<0||nd[b].konst)){
+                n->konst=1;
+                n->val=eval_pure(op,a<0?0.f:nd[a].val,b<0?0.f:nd[b].val,n->hi,n->lo);
+            }
+            if((v=identity(nd,n))>=0)         s.folded++;
+            else if((v=find_same(nd,nn,n))>=0){
+                if(op==OP_CONST) ;
+                else if(n->konst) s.folded++;
+                else              s.cse++;
+            }
+            else v=nn++;
+        }
+        cur[INSTR_DST(ins)]=v;
+    }
+    if(out<0) goto verbatim;
+
+    /* Liveness, backwards; encodable constants don't keep their inputs */
+    nd[out].live=1;
+    for(int j=nn-1;j>=REG_FREE;j--){
+        ONode *n=&nd[j];
+        if(n->op==OP_ADSR||is_rng(n->op)) n->live=1;
+        if(!n->live) continue;
+        uint16_t hi,lo;
+        if(n->konst&&const_enc(n->val,&hi,&lo)){
+            if(n->op!=OP_CONST) s.folded++;
+            n->op=OP_CONST; n->a=n->b=n->c=-1; n->hi=hi; n->lo=lo;
+            continue;
+        }
+        if(n->a>=0) nd[n->a].live=1;
+        if(n->b>=0) nd[n->b].live=1;
+        if(n->c>=0) nd[n->c].live=1;
+    }
+    for(int j=REG_FREE;j<nn;j++) if(nd[j].live){
+        if(nd[j].a>=0) nd[nd[j].a].last=j;
+        if(nd[j].b>=0) nd[nd[j].b].last=j;
+        if(nd[j].c>=0) nd[nd[j].c].last=j;
+    }
+
+    /* Linear scan: lowest free register; operands are released after the
+       destination is taken, so dst never aliases a source */
+    uint8_t busy[MAX_REGS]; int top=REG_FREE;
+    memset(busy,0,sizeof(busy));
+    o.n_instrs=0; o.n_state=0;
+    for(int j=REG_FREE;j<nn;j++){
+        ONode *n=&nd[j];
+        if(!n->live) continue;
+        int r=REG_FREE;
+        while(r<MAX_REGS&&busy[r]) r++;
+        if(r>=MAX_REGS) goto verbatim;
+        busy[r]=1; n->reg=r; if(r>=top) top=r+1;
+        if(n->a>=REG_FREE&&nd[n->a].last==j) busy[nd[n->a].reg]=0;
+        if(n->b>=REG_FREE&&nd[n->b].last==j) busy[nd[n->b].reg]=0;
+        if(n->c>=REG_FREE&&nd[n->c].last==j) busy[nd[n->c].reg]=0;
+        if(!n->last&&j!=out) busy[r]=0;   /* kept only for its side effect */
+        o.code[o.n_instrs++]=INSTR_PACK(n->op,r,n->a>=0?nd[n->a].reg:0,
+                                        n->b>=0?nd[n->b].reg:0,
+                                        n->c>=0?(n->hi&0xFF00)|nd[n->c].reg:n->hi,n->lo);
+        o.n_state+=instr_state_slots(o.code[o.n_instrs-1]);
+        if(instr_os_continues(o.n_instrs>1?o.code[o.n_instrs-2]:0,o.code[o.n_instrs-1])!=n->cont)
+            goto verbatim;
+    }
+    o.code[o.n_instrs++]=INSTR_PACK(OP_OUT,0,nd[out].reg,0,0,0);
+    o.n_regs=top;
+    *dst=o;
+    s.instrs_after=o.n_instrs; s.regs_after=o.n_regs; s.state_after=o.n_state;
+    if(st) *st=s;
+    return 0;
+
+verbatim:
+    if(dst!=src) *dst=*src;
+    s.instrs_after=s.instrs_before; s.regs_after=s.regs_before; s.state_after=s.state_before;
+    s.folded=s.cse=0;
+    if(st) *st=s;
+    return -1;
+}
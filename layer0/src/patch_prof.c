@@ -0,0 +1,193 @@
+/*
+ * SHMC Layer 0 — per-instruction profiling (see patch_prof.h)
+ *
+ * One record per program, found by hashing its address into a fixed
+ * table and claimed with a compare-and-swap, so engines on any thread
+ * can charge it without a lock.  Per-opcode and per-program totals are
+ * summed from the per-instruction counters at report time.
+ */
+#include "patch_prof_hooks.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef SHMC_PROFILE
+
+static const char *OP_NAME[OP_COUNT]={
+    "CONST","ADD","SUB","MUL","DIV","NEG","ABS",
+    "OSC","SAW","SQUARE","TRI","PHASE",
+    "FM","PM","AM","SYNC",
+    "NOISE","LP_NOISE","RAND_STEP",
+    "TANH","CLIP","FOLD","SIGN",
+    "LPF","HPF","BPF","ONEPOLE",
+    "ADSR","RAMP","EXP_DECAY",
+    "MIN","MAX","MIXN","OUT",
+    "SVF",
+};
+
+struct PatchProfProgram {
+    const PatchProgram *prog;
+    int      id, n_instrs;
+    char     name[24];
+    uint64_t samples;
+    uint8_t  op[MAX_INSTRS];
+    uint64_t count[MAX_INSTRS], ticks[MAX_INSTRS];
+};
+
+static PatchProfProgram s_prog[PROF_PROGRAMS];
+static int      s_ids;
+static uint64_t s_dropped;          /* samples of programs that found no slot */
+_Thread_local PatchProfProgram *patch_prof_cur;
+
+#define ADD64(p,v) __atomic_fetch_add((p),(v),__ATOMIC_RELAXED)
+
+static PatchProfProgram *find(const PatchProgram *prog, int create){
+    unsigned h=(unsigned)(((uintptr_t)prog>>4)*2654435761u);
+    for(int k=0;k<PROF_PROGRAMS;k++){
+        PatchProfProgram *p=&s_prog[(h+k)%PROF_PROGRAMS];
+        const PatchProgram *cur=__atomic_load_n(&p->prog,__ATOMIC_ACQUIRE);
+        if(!cur){
+            if(!create) return NULL;
+            if(__atomic_compare_exchange_n(&p->prog,&cur,prog,0,__ATOMIC_ACQ_REL,__ATOMIC_ACQUIRE)){
+                int n=prog->n_instrs<MAX_INSTRS?prog->n_instrs:MAX_INSTRS;
+                for(int i=0;i<n;i++) p->op[i]=INSTR_OP(prog->code[i]);
+                p->n_instrs=n;
+                p->id=__atomic_fetch_add(&s_ids,1,__ATOMIC_RELAXED);
+                return p;
+            }
+        }
+        if(cur==prog) return p;
+    }
+    return NULL;
+}
+
+PatchProfProgram *patch_prof_enter(const PatchProgram *prog, int n){
+    PatchProfProgram *p=find(prog,1);
+    if(p) ADD64(&p->samples,(uint64_t)n);
+    else  ADD64(&s_dropped,(uint64_t)n);
+    return p;
+}
+
+void patch_prof_add(PatchProfProgram *p, int i, int n, uint64_t ticks){
+    if(!p||i>=MAX_INSTRS) return;
+    ADD64(&p->count[i],(uint64_t)n);
+    ADD64(&p->ticks[i],ticks);
+}
+
+int patch_prof_enabled(void){ return 1; }
+
+void patch_prof_reset(void){
+    memset(s_prog,0,sizeof(s_prog));
+    s_ids=0; s_dropped=0;
+}
+
+void patch_prof_name(const PatchProgram *prog, const char *name){
+    PatchProfProgram *p=find(prog,1);
+    if(p) snprintf(p->name,sizeof(p->name),"%s",name);
+}
+
+int patch_prof_op(int op, PatchProfStat *st){
+    memset(st,0,sizeof(*st));
+    for(int k=0;k<PROF_PROGRAMS;k++){
+        const PatchProfProgram *p=&s_prog[k];
+        if(!p->prog) continue;
+        for(int i=0;i<p->n_instrs;i++)
+            if(p->op[i]==op){ st->count+=p->count[i]; st->ticks+=p->ticks[i]; }
+    }
+    return st->count>0;
+}
+
+int patch_prof_program(const PatchProgram *prog, PatchProfStat *st){
+    memset(st,0,sizeof(*st));
+    const PatchProfProgram *p=find(prog,0);
+    if(!p) return 0;
+    st->count=p->samples;
+    for(int i=0;i<p->n_instrs;i++) st->ticks+=p->ticks[i];
+    return 1;
+}
+
+/* ---- Report ---- */
+
+typedef struct { const PatchProfProgram *p; int i; uint64_t count, ticks; } Row;
+
+static int by_ticks(const void *a, const void *b){
+    uint64_t x=((const Row*)a)->ticks, y=((const Row*)b)->ticks;
+    return x<y?1:x>y?-1:0;
+}
+
+static const char *label(const PatchProfProgram *p, char *buf){
+    if(p->name[0]) return p->name;
+    snprintf(buf,24,"prog#%d",p->id);
+    return buf;
+}
+
+static double pct(uint64_t t, uint64_t total){ return total?100.0*(double)t/(double)total:0.0; }
+static double per(uint64_t t, uint64_t n){ return n?(double)t/(double)n:0.0; }
+
+void patch_prof_report(FILE *f, int top){
+    static Row rows[PROF_PROGRAMS*MAX_INSTRS];
+    Row ops[OP_COUNT], progs[PROF_PROGRAMS];
+    int nr=0, np=0, no=0;
+    uint64_t total=0;
+    char nb[24];
+    for(int k=0;k<PROF_PROGRAMS;k++){
+        const PatchProfProgram *p=&s_prog[k];
+        if(!p->prog) continue;
+        Row pr={p,0,p->samples,0};
+        for(int i=0;i<p->n_instrs;i++){
+            if(!p->count[i]) continue;
+            rows[nr++]=(Row){p,i,p->count[i],p->ticks[i]};
+            pr.ticks+=p->ticks[i];
+        }
+        progs[np++]=pr;
+        total+=pr.ticks;
+    }
+    for(int op=0;op<OP_COUNT;op++){
+        PatchProfStat st;
+        if(patch_prof_op(op,&st)) ops[no++]=(Row){NULL,op,st.count,st.ticks};
+    }
+    qsort(ops,(size_t)no,sizeof(Row),by_ticks);
+    qsort(progs,(size_t)np,sizeof(Row),by_ticks);
+    qsort(rows,(size_t)nr,sizeof(Row),by_ticks);
+#if defined(__x86_64__) || defined(__i386__)
+    const char *unit="rdtsc ticks";
+#else
+    const char *unit="ns";
+#endif
+    fprintf(f,"=== SHMC profile: %d programs, %llu %s ===\n",np,(unsigned long long)total,unit);
+    if(s_dropped) fprintf(f,"  (%llu samples of programs beyond PROF_PROGRAMS not counted)\n",
+                          (unsigned long long)s_dropped);
+    fprintf(f,"\n  %-12s %14s %16s %7s %12s\n","opcode","samples","ticks","%","ticks/sample");
+    for(int k=0;k<no;k++)
+        fprintf(f,"  %-12s %14llu %16llu %6.1f%% %12.2f\n",OP_NAME[ops[k].i],
+                (unsigned long long)ops[k].count,(unsigned long long)ops[k].ticks,
+                pct(ops[k].ticks,total),per(ops[k].ticks,ops[k].count));
+    fprintf(f,"\n  %-16s %10s %14s %16s %7s %12s\n","program","instrs","samples","ticks","%","ticks/sample");
+    for(int k=0;k<np;k++)
+        fprintf(f,"  %-16s %10d %14llu %16llu %6.1f%% %12.2f\n",label(progs[k].p,nb),
+                progs[k].p->n_instrs,(unsigned long long)progs[k].count,
+                (unsigned long long)progs[k].ticks,pct(progs[k].ticks,total),
+                per(progs[k].ticks,progs[k].count));
+    int n=top>0&&top<nr?top:nr;
+    fprintf(f,"\n  %-16s %5s %-12s %14s %16s %7s %12s\n","hotspot","#","opcode","samples","ticks","%","ticks/sample");
+    for(int k=0;k<n;k++)
+        fprintf(f,"  %-16s %5d %-12s %14llu %16llu %6.1f%% %12.2f\n",label(rows[k].p,nb),rows[k].i,
+                OP_NAME[rows[k].p->op[rows[k].i]],(unsigned long long)rows[k].count,
+                (unsigned long long)rows[k].ticks,pct(rows[k].ticks,total),
+                per(rows[k].ticks,rows[k].count));
+}
+
+#else  /* !SHMC_PROFILE */
+
+int  patch_prof_enabled(void){ return 0; }
+void patch_prof_reset(void){}
+void patch_prof_name(const PatchProgram *prog, const char *name){ (void)prog; (void)name; }
+int  patch_prof_op(int op, PatchProfStat *st){ (void)op; memset(st,0,sizeof(*st)); return 0; }
+int  patch_prof_program(const PatchProgram *prog, PatchProfStat *st){
+    (void)prog; memset(st,0,sizeof(*st)); return 0;
+}
+void patch_prof_report(FILE *f, int top){
+    (void)top;
+    fprintf(f,"=== SHMC profile: disabled (build with -DSHMC_PROFILE) ===\n");
+}
+
+#endif
@@ -0,0 +1,39 @@
+#pragma once
+/*
+ * SHMC Layer 0 — profiling hooks for the interpreter (patch_interp.c).
+ * Internal header: empty unless built with -DSHMC_PROFILE.
+ */
+#include "../include/patch_prof.h"
+
+#ifdef SHMC_PROFILE
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+static inline uint64_t prof_now(void){ return __rdtsc(); }
+#else
+#include <time.h>
+static inline uint64_t prof_now(void){
+    struct timespec t; clock_gettime(CLOCK_MONOTONIC,&t);
+    return (uint64_t)t.tv_sec*1000000000u+(uint64_t)t.tv_nsec;
+}
+#endif
+
+typedef struct PatchProfProgram PatchProfProgram;
+/* Program record for prog (claimed on first use, NULL when the table is
+   full); counts one call of n samples */
+PatchProfProgram *patch_prof_enter(const PatchProgram *prog, int n);
+void patch_prof_add(PatchProfProgram *p, int i, int n, uint64_t ticks);
+
+extern _Thread_local PatchProfProgram *patch_prof_cur;
+
+/* PROF_SCOPE: the program the next PROF_ADDs are charged to.
+   PROF_T0 / PROF_ADD: time one instruction i over n samples. */
+#define PROF_SCOPE(prog,n)  (patch_prof_cur=patch_prof_enter((prog),(n)))
+#define PROF_T0(t)          uint64_t t=prof_now()
+#define PROF_ADD(i,n,t)     patch_prof_add(patch_prof_cur,(i),(n),prof_now()-(t))
+#define PROF_ON             1
+#else
+#define PROF_SCOPE(prog,n)  ((void)0)
+#define PROF_T0(t)          ((void)0)
+#define PROF_ADD(i,n,t)     ((void)0)
+#define PROF_ON             0
+#endif
@@ -1,9 +1,58 @@
 #include "../include/patch.h"
-#include <math.h>
 
-float g_freq[128];
-float g_cutoff[64];
-float g_env[32];
+/* Literal tables: each entry is the float the generating expression
+   yields with powf (kept beside each table), so programs render exactly
+   as they did when these were computed at startup.  Read-only data —
+   nothing to initialize, safe from any thread.                        */
+
+/* g_freq[i]   = 440*2^((i-69)/12)      */
+/* g_cutoff[i] = 20*1000^(i/63)         */
+/* g_env[i]    = 0.001*4000^(i/31)      */
+const float g_freq[128] = {
+    8.17579842f,8.66195774f,9.17702293f,9.72271824f,10.3008623f,10.9133816f,
+    11.5623255f,12.2498589f,12.9782696f,13.75f,14.5676203f,15.4338512f,
+    16.3515968f,17.3239155f,18.3540459f,19.4454365f,20.6017246f,21.8267632f,
+    23.124651f,24.4997177f,25.9565392f,27.5f,29.1352329f,30.8677101f,
+    32.7031937f,34.6478271f,36.7080994f,38.890873f,41.2034416f,43.6535301f,
+    46.2493019f,48.999424f,51.9130898f,55.f,58.2704659f,61.7354202f,
+    65.4063873f,69.2956543f,73.4161987f,77.7817459f,82.4068832f,87.3070602f,
+    92.4986038f,97.998848f,103.82618f,110.f,116.540947f,123.470825f,
+    130.812775f,138.591324f,146.832382f,155.563492f,164.813782f,174.61412f,
+    184.997208f,195.997726f,207.652344f,220.f,233.081863f,246.94165f,
+    261.625549f,277.182648f,293.664764f,311.126984f,329.627563f,349.228241f,
+    369.994415f,391.995422f,415.304688f,440.f,466.163788f,493.883301f,
+    523.251099f,554.365295f,587.329529f,622.253967f,659.255127f,698.456482f,
+    739.988831f,783.990845f,830.609375f,880.f,932.327576f,987.766602f,
+    1046.5022f,1108.73059f,1174.65906f,1244.50793f,1318.51025f,1396.91296f,
+    1479.97766f,1567.98181f,1661.21875f,1760.f,1864.65491f,1975.53345f,
+    2093.00439f,2217.46094f,2349.31836f,2489.01587f,2637.02026f,2793.82593f,
+    2959.95532f,3135.96313f,3322.43774f,3520.f,3729.30981f,3951.06689f,
+    4186.00879f,4434.92188f,4698.63672f,4978.03174f,5274.04053f,5587.65186f,
+    5919.91064f,6271.92627f,6644.87549f,7040.f,7458.62158f,7902.13184f,
+    8372.01758f,8869.84473f,9397.27148f,9956.06348f,10548.083f,11175.3027f,
+    11839.8213f,12543.8555f
+};
+const float g_cutoff[64] = {
+    20.f,22.3176785f,24.9039421f,27.7899094f,31.0103149f,34.6039162f,
+    38.6139565f,43.0886917f,48.0819855f,53.6539154f,59.8715515f,66.8097f,
+    74.5518799f,83.1912384f,92.8317719f,103.589493f,115.593872f,128.989349f,
+    143.937149f,160.617157f,179.230118f,200.000015f,223.176804f,249.039444f,
+    277.899109f,310.10318f,346.039154f,386.139557f,430.886963f,480.819855f,
+    536.539185f,598.715454f,668.097168f,745.51886f,831.912598f,928.317932f,
+    1035.89514f,1155.93884f,1289.89355f,1439.37158f,1606.17175f,1792.30127f,
+    2000.00024f,2231.76831f,2490.39453f,2778.99146f,3101.03174f,3460.39185f,
+    3861.396f,4308.86963f,4808.19873f,5365.3916f,5987.15527f,6680.9707f,
+    7455.18799f,8319.125f,9283.17773f,10358.9502f,11559.3857f,12898.9346f,
+    14393.7129f,16061.7148f,17923.0098f,20000.f
+};
+const float g_env[32] = {
+    0.00100000005f,0.00130675908f,0.00170761906f,0.00223144633f,0.0029159626f,0.00381045998f,
+    0.00497935293f,0.00650681369f,0.00850283727f,0.0111111589f,0.0145196058f,0.0189736243f,
+    0.0247939546f,0.0323997214f,0.0423386246f,0.0553263761f,0.0722982362f,0.0944763944f,
+    0.123457842f,0.161329672f,0.210818931f,0.275489599f,0.359998405f,0.470431268f,
+    0.614740074f,0.803317308f,1.04974186f,1.37175977f,1.79255903f,2.34244323f,
+    3.06100774f,4.f
+};
 
 const float g_mod[32] = {
     0.000f,0.032f,0.065f,0.097f,0.129f,0.161f,0.194f,0.226f,
@@ -13,14 +62,18 @@ const float g_mod[32] = {
 };
 const float g_dur[7]={1.f/64,1.f/32,1.f/16,1.f/8,1.f/4,1.f/2,1.f};
 
-static int s_init=0;
-void tables_init(void){
-    if(s_init)return;
-    for(int i=0;i<128;i++) g_freq[i]=440.f*powf(2.f,(i-69)/12.f);
-    for(int i=0;i<64;i++)  g_cutoff[i]=20.f*powf(1000.f,(float)i/63.f);
-    for(int i=0;i<32;i++)  g_env[i]=0.001f*powf(4000.f,(float)i/31.f);
-    s_init=1;
-}
+void tables_init(void){}
+
 float freq_from_midi(int m){if(m<0)m=0;if(m>127)m=127;return g_freq[m];}
 float env_time(int i)      {if(i<0)i=0;if(i>31) i=31;  return g_env[i];}
 float cutoff_hz(int i)     {if(i<0)i=0;if(i>63) i=63;  return g_cutoff[i];}
+
+/* Fractional index: linear between neighbouring entries, clamped */
+static float lerp_tab(const float *t, int n, float x){
+    if(!(x>0.f)) return t[0];
+    if(x>=(float)(n-1)) return t[n-1];
+    int i=(int)x; float f=x-(float)i;
+    return t[i]+f*(t[i+1]-t[i]);
+}
+float env_time_f(float x)  { return lerp_tab(g_env,32,x); }
+float cutoff_hz_f(float x) { return lerp_tab(g_cutoff,64,x); }
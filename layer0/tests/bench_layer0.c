@@ -0,0 +1,274 @@
+/*
+ * SHMC Layer 0 — Benchmarks
+ * Build: make bench [SIMD=-mavx2]
+ *
+ * voices: N voices of one patch rendered as N scalar Patches vs. one
+ *         PatchBank, reported as ns per voice-sample and voices-per-core
+ *         (voices one core can sustain in real time at SR).
+ * opt:    one voice per patch, source program vs patch_optimize() output,
+ *         instruction counts and ns per sample.
+ * jit:    one voice per patch, block interpreter vs patch_jit() code.
+ * math:   MATH_POLY kernels vs libm / fsin, ns per element over an array.
+ * alias:  bare saw/square/tri, naive vs OSC_BLEP, across MIDI 0-127:
+ *         power outside the harmonic series (folded back from above
+ *         Nyquist) relative to total, and ns per sample for each form.
+ * asm:    a 4000-patch bank disassembled to text and assembled back.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include "patch_bank.h"
+#include "patch_opt.h"
+#include "patch_jit.h"
+#include "patch_asm.h"
+#include "patches.h"
+#include "../src/patch_dsp.h"
+
+#define SR     44100
+#define NSAMP  (SR/2)
+
+static double now_s(void){
+    struct timespec t; clock_gettime(CLOCK_MONOTONIC,&t);
+    return (double)t.tv_sec+(double)t.tv_nsec*1e-9;
+}
+
+static volatile float g_sink;
+
+static int count_patch(void *user, const char *name, const PatchProgram *pr, float sr){
+    (void)name; (void)sr; *(int*)user+=pr->n_instrs; return 0;
+}
+
+/* ns per voice-sample, scalar Patch engine */
+static double bench_scalar(const PreparedProgram *pp, int voices){
+    static Patch pa[BANK_LANES];
+    float blk[AUDIO_BLOCK];
+    for(int v=0;v<voices;v++) patch_note_on_prepared(&pa[v],pp,48+v*3,0.8f);
+    double t0=now_s();
+    for(int i=0;i<NSAMP;i+=AUDIO_BLOCK)
+        for(int v=0;v<voices;v++){ patch_step(&pa[v],blk,AUDIO_BLOCK); g_sink+=blk[0]; }
+    return (now_s()-t0)*1e9/((double)NSAMP*voices);
+}
+
+/* ns per voice-sample, SoA bank */
+static double bench_bank(const PreparedProgram *pp, int voices){
+    static PatchBank bk;
+    float blk[AUDIO_BLOCK];
+    bank_init(&bk,pp);
+    for(int v=0;v<voices;v++) bank_note_on(&bk,48+v*3,0.8f);
+    double t0=now_s();
+    for(int i=0;i<NSAMP;i+=AUDIO_BLOCK){ bank_step(&bk,blk,AUDIO_BLOCK); g_sink+=blk[0]; }
+    return (now_s()-t0)*1e9/((double)NSAMP*voices);
+}
+
+/* ns per sample, one prepared voice */
+static double bench_voice(const PatchProgram *pr, int jit){
+    static PreparedProgram pp; static Patch pa;
+    float blk[AUDIO_BLOCK];
+    patch_prepare(&pp,pr,(float)SR);
+    if(jit) patch_jit(&pp);
+    patch_note_on_prepared(&pa,&pp,60,0.8f);
+    double t0=now_s();
+    for(int r=0;r<8;r++)
+        for(int i=0;i<NSAMP;i+=AUDIO_BLOCK){ patch_step(&pa,blk,AUDIO_BLOCK); g_sink+=blk[0]; }
+    return (now_s()-t0)*1e9/(8.0*NSAMP);
+}
+
+/* ---- Math kernels: ns per element over a 4096-entry array ---- */
+#define NMATH 4096
+#define MATH_BENCH(name,expr) static double name(const float *x, float *y){ \
+        double t0=now_s();                                                  \
+        for(int r=0;r<256;r++){ for(int i=0;i<NMATH;i++) y[i]=(expr); g_sink+=y[r]; } \
+        return (now_s()-t0)*1e9/(256.0*NMATH); }
+MATH_BENCH(b_sinf,    sinf(x[i]))
+MATH_BENCH(b_fsin,    fsin(x[i]))
+MATH_BENCH(b_sin_poly,sin_poly(x[i]))
+MATH_BENCH(b_expf,    expf(-x[i]))
+MATH_BENCH(b_exp_poly,exp_poly(-x[i]))
+MATH_BENCH(b_tanhf,   tanhf(x[i]-3.f))
+MATH_BENCH(b_tanh_poly,tanh_poly(x[i]-3.f))
+
+/* ---- Filters: saw into each form, cutoff held or swept by an LFO ---- */
+static PatchProgram filt(int svf, int swept){
+    PatchBuilder b; pb_init(&b);
+    int x=pb_saw(&b,REG_ONE), y;
+    if(!svf) y=pb_bpf(&b,x,40,8);
+    else {
+        int c=pb_mul(&b,REG_FREQ,pb_const_f(&b,4.f));
+        if(swept) c=pb_mul(&b,c,pb_add(&b,REG_ONE,pb_mul(&b,pb_osc(&b,pb_const_f(&b,1.f/64.f)),pb_const_f(&b,.5f))));
+        else      pb_osc(&b,pb_const_f(&b,1.f/64.f));           /* LFO still runs */
+        y=pb_svf(&b,x,c,pb_const_f(&b,2.f),SVF_BP);
+    }
+    pb_out(&b,y);
+    return *pb_finish(&b);
+}
+
+/* ---- Aliasing measurement ---- */
+#define NFFT 16384
+
+static void fft(double *re, double *im, int n){
+    for(int i=1,j=0;i<n;i++){
+        int bit=n>>1;
+        for(;j&bit;bit>>=1) j^=bit;
+        j^=bit;
+        if(i<j){ double t=re[i]; re[i]=re[j]; re[j]=t; t=im[i]; im[i]=im[j]; im[j]=t; }
+    }
+    for(int len=2;len<=n;len<<=1){
+        double a=-2.0*M_PI/len, wr=cos(a), wi=sin(a);
+        for(int i=0;i<n;i+=len){
+            double cr=1, ci=0;
+            for(int k=0;k<len/2;k++){
+                int u=i+k, v=u+len/2;
+                double xr=re[v]*cr-im[v]*ci, xi=re[v]*ci+im[v]*cr;
+                re[v]=re[u]-xr; im[v]=im[u]-xi; re[u]+=xr; im[u]+=xi;
+                double t=cr*wr-ci*wi; ci=cr*wi+ci*wr; cr=t;
+            }
+        }
+    }
+}
+
+static PatchProgram bare_osc(uint8_t op, uint16_t quality){
+    PatchBuilder b; pb_init(&b);
+    int d=pb_reg(&b); pb_emit(&b,INSTR_PACK(op,d,REG_ONE,0,0,quality));
+    pb_out(&b,d);
+    return *pb_finish(&b);
+}
+
+/* Alias-to-total power in dB: 4-term Blackman-Harris window, bins more
+   than 6 away from every harmonic k*f0 count as alias.  Below ~32 Hz
+   the harmonics are too dense to resolve: reported as "-". */
+static double alias_db(const PatchProgram *pr, int midi){
+    static double re[NFFT], im[NFFT];
+    static float x[NFFT];
+    static PreparedProgram pp; static Patch pa;
+    patch_prepare(&pp,pr,(float)SR);
+    patch_note_on_prepared(&pa,&pp,midi,1.f);
+    for(int i=0;i<SR/10;i+=AUDIO_BLOCK) patch_step(&pa,x,AUDIO_BLOCK);  /* settle */
+    for(int i=0;i<NFFT;i+=AUDIO_BLOCK) patch_step(&pa,x+i,AUDIO_BLOCK);
+    for(int i=0;i<NFFT;i++){
+        double t=2.0*M_PI*i/NFFT;
+        re[i]=x[i]*(0.35875-0.48829*cos(t)+0.14128*cos(2*t)-0.01168*cos(3*t)); im[i]=0;
+    }
+    fft(re,im,NFFT);
+    double f0=freq_from_midi(midi), df=(double)SR/NFFT, al=0, tot=0;
+    if(f0<13*df) return NAN;
+    for(int k=7;k<NFFT/2;k++){
+        double pw=re[k]*re[k]+im[k]*im[k], f=k*df, h=floor(f/f0+0.5);
+        tot+=pw;
+        if(h<1||fabs(f-h*f0)>6*df) al+=pw;
+    }
+    return 10.0*log10(al/tot+1e-20);
+}
+
+int main(void){
+    struct { const char *name; PatchProgram prog; } P[]={
+        {"sine_adsr",p_sine_adsr()}, {"fm_2op",p_fm_2op()},
+        {"fm_fold",  p_fm_fold()},   {"pad",   p_pad()},
+        {"generated",p_generated()},
+    };
+    static PreparedProgram pp;
+
+    printf("=== SHMC Layer 0  —  voices: scalar Patch vs PatchBank (%d lanes) ===\n\n",BANK_LANES);
+    printf("%-10s %14s %14s %12s %12s %8s\n","patch","scalar ns/vs","bank ns/vs",
+           "scalar v/core","bank v/core","speedup");
+    for(size_t p=0;p<sizeof(P)/sizeof(P[0]);p++){
+        patch_prepare(&pp,&P[p].prog,(float)SR);
+        double ts=bench_scalar(&pp,BANK_LANES), tb=bench_bank(&pp,BANK_LANES);
+        printf("%-10s %14.2f %14.2f %12.0f %12.0f %7.2fx\n",P[p].name,ts,tb,
+               1e9/(ts*SR),1e9/(tb*SR),ts/tb);
+    }
+
+    printf("\n=== optimizer: source vs patch_optimize() ===\n\n");
+    printf("%-10s %8s %8s %12s %12s %8s\n","patch","instrs","opt","ns/sample","opt ns/s","speedup");
+    for(size_t p=0;p<sizeof(P)/sizeof(P[0]);p++){
+        static PatchProgram opt; PatchOptStats st;
+        patch_optimize(&opt,&P[p].prog,&st);
+        double ts=bench_voice(&P[p].prog,0), to=bench_voice(&opt,0);
+        printf("%-10s %8d %8d %12.2f %12.2f %7.2fx\n",P[p].name,
+               st.instrs_before,st.instrs_after,ts,to,ts/to);
+    }
+
+    printf("\n=== jit: block interpreter vs native code ===\n\n");
+    printf("%-10s %12s %12s %8s\n","patch","interp ns/s","jit ns/s","speedup");
+    for(size_t p=0;p<sizeof(P)/sizeof(P[0]);p++){
+        double ti=bench_voice(&P[p].prog,0), tj=bench_voice(&P[p].prog,1);
+        printf("%-10s %12.2f %12.2f %7.2fx\n",P[p].name,ti,tj,ti/tj);
+    }
+
+    printf("\n=== math: ns per element, x in [0, 2pi) ===\n\n");
+    {
+        static float x[NMATH], y[NMATH];
+        for(int i=0;i<NMATH;i++) x[i]=TWO_PI*(float)i/NMATH;
+        double ls=b_sinf(x,y), fs=b_fsin(x,y), ps=b_sin_poly(x,y);
+        double le=b_expf(x,y), pe=b_exp_poly(x,y), lt=b_tanhf(x,y), pt=b_tanh_poly(x,y);
+        printf("%-6s %10s %10s %10s\n","","libm","poly","speedup");
+        printf("%-6s %10.2f %10.2f %9.2fx   (fsin %.2f)\n","sin",ls,ps,ls/ps,fs);
+        printf("%-6s %10.2f %10.2f %9.2fx\n","exp",le,pe,le/pe);
+        printf("%-6s %10.2f %10.2f %9.2fx\n","tanh",lt,pt,lt/pt);
+    }
+
+    printf("\n=== oversampling: fm_fold chain, ns/sample ===\n\n");
+    {
+        PatchProgram D[3];
+        for(int q=0;q<3;q++){
+            PatchBuilder b; pb_init(&b);
+            int car=pb_fm(&b,REG_ONE,pb_osc(&b,pb_const_f(&b,3.0f)),25);
+            pb_oversample(&b,q);
+            int sat=pb_tanh_q(&b,pb_fold(&b,pb_mul(&b,car,pb_const_f(&b,1.5f))),MATH_POLY);
+            pb_out(&b,pb_mul(&b,sat,pb_adsr(&b,1,8,16,12)));
+            D[q]=*pb_finish(&b);
+        }
+        double t1=bench_voice(&D[0],0), t2=bench_voice(&D[1],0), t4=bench_voice(&D[2],0);
+        printf("%-22s %8.2f\n%-22s %8.2f\n%-22s %8.2f\n%-22s %8.2f\n",
+               "1x",t1,"fold+tanh at 2x",t2,"fold+tanh at 4x",t4,"whole voice at 4x sr",4.0*t1);
+    }
+
+    printf("\n=== filters: ns/sample, saw -> filter ===\n\n");
+    {
+        PatchProgram F[3]={filt(0,0),filt(1,0),filt(1,1)};
+        static const char *FN[3]={"bpf imm","svf held","svf swept"};
+        for(int f=0;f<3;f++) printf("%-10s %8.2f\n",FN[f],bench_voice(&F[f],0));
+    }
+
+    printf("\n=== alias: naive vs OSC_BLEP, alias/total power (dB) ===\n\n");
+    static const uint8_t W[3]={OP_SAW,OP_SQUARE,OP_TRI};
+    static const char *WN[3]={"saw","square","tri"};
+    PatchProgram ON[3], OB[3];
+    for(int w=0;w<3;w++){ ON[w]=bare_osc(W[w],OSC_NAIVE); OB[w]=bare_osc(W[w],OSC_BLEP); }
+    printf("%4s %9s","midi","Hz");
+    for(int w=0;w<3;w++) printf(" %8s %8s",WN[w],"blep");
+    printf("\n");
+    for(int m=0;m<=127;m+=(m<120?12:7)){
+        printf("%4d %9.1f",m,freq_from_midi(m));
+        for(int w=0;w<3;w++){
+            double a=alias_db(&ON[w],m), b=alias_db(&OB[w],m);
+            if(isnan(a)) printf(" %8s %8s","-","-"); else printf(" %8.1f %8.1f",a,b);
+        }
+        printf("\n");
+    }
+    printf("\n%-10s %12s %12s %8s\n","wave","naive ns/s","blep ns/s","cost");
+    for(int w=0;w<3;w++){
+        double tn=bench_voice(&ON[w],0), tb=bench_voice(&OB[w],0);
+        printf("%-10s %12.2f %12.2f %7.2fx\n",WN[w],tn,tb,tb/tn);
+    }
+
+    printf("\n=== asm: 4000-patch bank, text <-> PatchProgram ===\n\n");
+    {
+        char *src, name[16]; size_t len; int n_ins=0;
+        double t0=now_s();
+        FILE *m=open_memstream(&src,&len);
+        for(int i=0;i<4000;i++){
+            snprintf(name,sizeof(name),"p%d",i);
+            patch_disasm(m,name,&P[i%(sizeof(P)/sizeof(P[0]))].prog);
+        }
+        fclose(m);
+        double t1=now_s();
+        int n=patch_asm_bank(src,len,count_patch,&n_ins,NULL);
+        double t2=now_s();
+        printf("%-12s %8.2f ms\n%-12s %8.2f ms   (%d patches, %d instrs, %.1f MB/s)\n",
+               "disassemble",(t1-t0)*1e3,"assemble",(t2-t1)*1e3,n,n_ins,len/(t2-t1)/1e6);
+        free(src);
+    }
+    return 0;
+}
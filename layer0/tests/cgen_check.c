@@ -0,0 +1,73 @@
+/*
+ * SHMC Layer 0 — generated render functions vs the interpreter
+ * Build: make cgen
+ *
+ * Each <patch>_render from cgen_layer0 must match patch_step_scalar()
+ * bit for bit, over ragged call sizes on both sides of AUDIO_BLOCK, and
+ * must not be slower than the block interpreter (best of TRIALS runs).
+ */
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "patch_cgen.h"
+#include "patches.h"
+
+#define SR    44100
+#define NDUR  SR
+#define TRIALS 5
+
+extern const char *const cgen_names[];
+extern void (*const cgen_fns[])(PatchState*,float*,int);
+
+static double now_s(void){
+    struct timespec t; clock_gettime(CLOCK_MONOTONIC,&t);
+    return (double)t.tv_sec+(double)t.tv_nsec*1e-9;
+}
+
+static float ref[NDUR], gen[NDUR];
+
+/* Best time of TRIALS renders of NDUR samples from a fresh note, in
+   AUDIO_BLOCK calls through fn, or patch_step() when fn is NULL */
+static double best_s(const PatchProgram *pr, PatchRenderFn fn){
+    static Patch v; double best=1e30;
+    for(int r=0;r<TRIALS;r++){
+        patch_note_on(&v,pr,(float)SR,60,0.8f);
+        double t0=now_s();
+        for(int i=0;i<NDUR;i+=AUDIO_BLOCK){
+            int c=NDUR-i<AUDIO_BLOCK?NDUR-i:AUDIO_BLOCK;
+            if(fn) fn(&v.st,gen+i,c); else patch_step(&v,ref+i,c);
+        }
+        double t=now_s()-t0; if(t<best) best=t;
+    }
+    return best;
+}
+
+int main(void){
+    printf("=== SHMC Layer 0  —  AOT C vs interpreter ===\n\n");
+    struct { const char *name; PatchProgram prog; } P[]={
+#define ENT(p) {#p,p_##p()},
+        PATCH_LIST(ENT)
+#undef ENT
+    };
+    int np=sizeof(P)/sizeof(P[0]), pass=0;
+    static const int span[]={ 1, 7, AUDIO_BLOCK, 2*AUDIO_BLOCK+5, AUDIO_BLOCK-1, 64 };
+    static Patch a, b;
+    for(int p=0;p<np;p++){
+        PatchRenderFn fn=cgen_fns[p];
+        patch_note_on(&a,&P[p].prog,(float)SR,60,0.8f);
+        patch_note_on(&b,&P[p].prog,(float)SR,60,0.8f);
+        for(int i=0,k=0;i<NDUR;k++){
+            int c=span[k%6]; if(c>NDUR-i) c=NDUR-i;
+            patch_step_scalar(&a,ref+i,c); fn(&b.st,gen+i,c); i+=c;
+        }
+        int ok=!strcmp(cgen_names[p],P[p].name)&&!memcmp(ref,gen,sizeof(ref));
+
+        double ti=best_s(&P[p].prog,NULL), ta=best_s(&P[p].prog,fn);
+        int fast=ta<=ti;
+        printf("  %-10s %s  interp %6.2f ns/s  aot %6.2f ns/s  %5.2fx%s\n",P[p].name,
+               ok?"PASS":"FAIL",ti*1e9/NDUR,ta*1e9/NDUR,ti/ta,fast?"":"  SLOWER");
+        pass+=ok&&fast;
+    }
+    printf("\n=== %d / %d passed ===\n",pass,np);
+    return pass==np?0:1;
+}
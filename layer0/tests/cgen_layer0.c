@@ -0,0 +1,32 @@
+/*
+ * SHMC Layer 0 — AOT code generation for the reference patches
+ * Usage: cgen_layer0 out.c    (see `make cgen`)
+ *
+ * Writes one specialized render function per patch in patches.h, named
+ * <patch>_render, plus a name/function table for cgen_check.
+ */
+#include <stdio.h>
+#include "patch_cgen.h"
+#include "patches.h"
+
+#define SR 44100
+
+int main(int argc, char **argv){
+    if(argc<2){ fprintf(stderr,"usage: %s out.c\n",argv[0]); return 2; }
+    FILE *f=fopen(argv[1],"w");
+    if(!f){ perror(argv[1]); return 1; }
+    patch_cgen_begin(f,(float)SR);
+#define GEN(p) { PatchProgram pr=p_##p(); patch_cgen(f,&pr,#p "_render",(float)SR); }
+    PATCH_LIST(GEN)
+#undef GEN
+    fprintf(f,"\nconst char *const cgen_names[]={\n");
+#define NAME(p) fprintf(f,"    \"%s\",\n",#p);
+    PATCH_LIST(NAME)
+#undef NAME
+    fprintf(f,"};\nvoid (*const cgen_fns[])(PatchState*,float*,int)={\n");
+#define FN(p) fprintf(f,"    %s_render,\n",#p);
+    PATCH_LIST(FN)
+#undef FN
+    fprintf(f,"};\n");
+    return fclose(f)?1:0;
+}
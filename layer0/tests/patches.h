@@ -0,0 +1,156 @@
+#pragma once
+/*
+ * SHMC Layer 0 — reference patches shared by the test and bench programs
+ */
+#include "patch_builder.h"
+
+static PatchProgram p_sine_adsr(void){
+    PatchBuilder b; pb_init(&b);
+    int env=pb_adsr(&b,3,10,22,18);
+    int osc=pb_osc(&b,REG_ONE);
+    pb_out(&b,pb_mul(&b,osc,env));
+    return *pb_finish(&b);
+}
+static PatchProgram p_saw_lpf(void){
+    PatchBuilder b; pb_init(&b);
+    int env=pb_adsr(&b,2,8,20,15);
+    int saw=pb_saw(&b,REG_ONE);
+    int flt=pb_lpf(&b,saw,30);
+    pb_out(&b,pb_mul(&b,flt,env));
+    return *pb_finish(&b);
+}
+static PatchProgram p_fm_2op(void){
+    PatchBuilder b; pb_init(&b);
+    int two=pb_const_f(&b,2.0f);
+    int mod=pb_osc(&b,two);
+    int car=pb_fm(&b,REG_ONE,mod,20);
+    int env=pb_adsr(&b,2,12,18,14);
+    pb_out(&b,pb_mul(&b,car,env));
+    return *pb_finish(&b);
+}
+static PatchProgram p_fm_fold(void){
+    PatchBuilder b; pb_init(&b);
+    int three=pb_const_f(&b,3.0f);
+    int mod=pb_osc(&b,three);
+    int car=pb_fm(&b,REG_ONE,mod,25);
+    int fld=pb_fold(&b,car);
+    int flt=pb_lpf(&b,fld,38);
+    int env=pb_adsr(&b,1,8,16,12);
+    pb_out(&b,pb_mul(&b,flt,env));
+    return *pb_finish(&b);
+}
+static PatchProgram p_noise_bpf(void){
+    PatchBuilder b; pb_init(&b);
+    int n=pb_noise(&b);
+    int f=pb_bpf(&b,n,35,25);
+    int e=pb_exp_decay(&b,18);
+    pb_out(&b,pb_mul(&b,f,e));
+    return *pb_finish(&b);
+}
+static PatchProgram p_pad(void){
+    PatchBuilder b; pb_init(&b);
+    int o1=pb_osc(&b,REG_ONE);
+    int dt=pb_const_f(&b,1.008f);
+    int o2=pb_osc(&b,dt);
+    int mx=pb_mix(&b,o1,o2,15,15);
+    int lf=pb_const_f(&b,0.03f);
+    int lfo=pb_osc(&b,lf);
+    int am=pb_am(&b,mx,lfo,8);
+    int fl=pb_lpf(&b,am,40);
+    int en=pb_adsr(&b,15,5,28,20);
+    pb_out(&b,pb_mul(&b,fl,en));
+    return *pb_finish(&b);
+}
+static PatchProgram p_square_hpf(void){
+    PatchBuilder b; pb_init(&b);
+    int sq=pb_square(&b,REG_ONE);
+    int hp=pb_hpf(&b,sq,15);
+    int en=pb_adsr(&b,0,8,18,12);
+    pb_out(&b,pb_mul(&b,hp,en));
+    return *pb_finish(&b);
+}
+static PatchProgram p_tri_tanh(void){
+    PatchBuilder b; pb_init(&b);
+    int tr=pb_tri(&b,REG_ONE);
+    int gn=pb_const_f(&b,4.0f);
+    int dr=pb_mul(&b,tr,gn);
+    int st=pb_tanh(&b,dr);
+    int en=pb_adsr(&b,2,10,20,15);
+    pb_out(&b,pb_mul(&b,st,en));
+    return *pb_finish(&b);
+}
+/* Generator-style patch: constant subexpressions, a zero-depth AM, a
+   repeated stateless op and a dead tail after OUT */
+static PatchProgram p_generated(void){
+    PatchBuilder b; pb_init(&b);
+    int two=pb_const_f(&b,2.0f), half=pb_const_f(&b,0.5f);
+    int car=pb_saw(&b,pb_mul(&b,two,half));
+    int lfo=pb_osc(&b,pb_const_f(&b,0.25f));
+    int am=pb_am(&b,car,lfo,0);
+    int s1=pb_tanh(&b,am), s2=pb_tanh(&b,am);
+    int flt=pb_lpf(&b,pb_mix(&b,s1,s2,16,16),34);
+    int en=pb_adsr(&b,2,10,20,15);
+    pb_out(&b,pb_mul(&b,flt,en));
+    pb_out(&b,pb_neg(&b,flt));
+    return *pb_finish(&b);
+}
+
+/* Band-limited oscillators: BLEP saw + square an octave up, BLAMP
+   triangle sub */
+static PatchProgram p_bl_osc(void){
+    PatchBuilder b; pb_init(&b);
+    int saw=pb_saw_bl(&b,REG_ONE);
+    int sq =pb_square_bl(&b,pb_const_f(&b,2.0f));
+    int sub=pb_tri_bl(&b,pb_const_f(&b,0.5f));
+    int mx =pb_mix(&b,pb_mix(&b,saw,sq,16,10),sub,24,12);
+    int en =pb_adsr(&b,1,10,20,14);
+    pb_out(&b,pb_mul(&b,mx,en));
+    return *pb_finish(&b);
+}
+
+/* MATH_POLY / MATH_RECUR kernels: polynomial sines, rational tanh
+   drive, polynomial and recursive decays */
+static PatchProgram p_poly_math(void){
+    PatchBuilder b; pb_init(&b);
+    int o1=pb_osc_q(&b,REG_ONE,MATH_POLY);
+    int o2=pb_osc_q(&b,pb_const_f(&b,1.5f),MATH_POLY);
+    int dr=pb_mul(&b,pb_mix(&b,o1,o2,31,20),pb_const_f(&b,3.0f));
+    int st=pb_tanh_q(&b,dr,MATH_POLY);
+    int e1=pb_exp_decay_q(&b,6,MATH_POLY), e2=pb_exp_decay_q(&b,2,MATH_RECUR);
+    pb_out(&b,pb_mul(&b,st,pb_mix(&b,e1,e2,20,12)));
+    return *pb_finish(&b);
+}
+
+/* OP_SVF: key-tracked lowpass swept by the envelope (coefficients
+   rebuilt per sample only while it moves), plus a bandpass whose Q is
+   wobbled by a slow LFO */
+static PatchProgram p_svf_sweep(void){
+    PatchBuilder b; pb_init(&b);
+    int saw=pb_saw_bl(&b,REG_ONE);
+    int en =pb_adsr(&b,4,12,10,14);
+    int cut=pb_mul(&b,REG_FREQ,pb_add(&b,REG_ONE,pb_mul(&b,en,pb_const_f(&b,12.f))));
+    int lp =pb_svf(&b,saw,cut,pb_const_f(&b,4.f),SVF_LP);
+    int lfo=pb_osc(&b,pb_const_f(&b,1.f/64.f));
+    int q  =pb_add(&b,pb_const_f(&b,3.f),pb_mul(&b,lfo,pb_const_f(&b,2.f)));
+    int bp =pb_svf(&b,saw,pb_mul(&b,REG_FREQ,pb_const_f(&b,3.f)),q,SVF_BP);
+    pb_out(&b,pb_mul(&b,pb_mix(&b,lp,bp,20,16),en));
+    return *pb_finish(&b);
+}
+
+/* Oversampled nonlinear chain: fm_fold's carrier folded at 2x, then
+   driven into tanh at 4x; the oscillators and envelope stay at 1x */
+static PatchProgram p_drive_os(void){
+    PatchBuilder b; pb_init(&b);
+    int car=pb_fm(&b,REG_ONE,pb_osc(&b,pb_const_f(&b,3.0f)),25);
+    pb_oversample(&b,OS_2X);
+    int fld=pb_fold(&b,pb_mul(&b,car,pb_const_f(&b,1.5f)));
+    pb_oversample(&b,OS_4X);
+    int sat=pb_tanh_q(&b,pb_mul(&b,fld,pb_const_f(&b,4.0f)),MATH_POLY);
+    pb_out(&b,pb_mul(&b,sat,pb_adsr(&b,1,8,16,12)));
+    return *pb_finish(&b);
+}
+
+/* Every reference patch, for tools that walk the whole set */
+#define PATCH_LIST(X) X(sine_adsr) X(saw_lpf) X(fm_2op) X(fm_fold) \
+    X(noise_bpf) X(pad) X(square_hpf) X(tri_tanh) X(generated) X(bl_osc) \
+    X(poly_math) X(svf_sweep) X(drive_os)
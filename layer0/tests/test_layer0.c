@@ -7,9 +7,18 @@
 #include <string.h>
 #include <math.h>
 #include "patch_builder.h"
+#include "patch_bank.h"
+#include "patch_opt.h"
+#include "patch_jit.h"
+#include "patch_file.h"
+#include "patch_asm.h"
+#include "patch_prof.h"
+#include "patches.h"
+#include "../src/patch_dsp.h"
 
 #define SR    44100
 #define NDUR  44100   /* 1 second */
+#define MAX_REF 16    /* reference patches main() can hold */
 
 /* --- Minimal WAV writer --- */
 static void write_wav(const char *path, const float *b, int n){
@@ -26,101 +35,548 @@ static void write_wav(const char *path, const float *b, int n){
     fclose(f);free(p);
 }
 
-static float *render(const PatchProgram *pr, int midi, float vel, int n){
+typedef int (*StepFn)(Patch*,float*,int);
+
+static float *render_with(StepFn step, const PatchProgram *pr,
+                          int midi, float vel, int n){
     float *buf=(float*)calloc(n,sizeof(float));
     Patch pa; patch_note_on(&pa,pr,(float)SR,midi,vel);
     float blk[AUDIO_BLOCK]; int i=0;
     while(i<n){
         int c=n-i<AUDIO_BLOCK?n-i:AUDIO_BLOCK;
-        patch_step(&pa,blk,c); memcpy(buf+i,blk,c*sizeof(float)); i+=c;
+        step(&pa,blk,c); memcpy(buf+i,blk,c*sizeof(float)); i+=c;
     }
     return buf;
 }
+static float *render_prepared(const PatchProgram *pr, int midi, float vel, int n){
+    static PreparedProgram pp;
+    patch_prepare(&pp,pr,(float)SR);
+    float *buf=(float*)calloc(n,sizeof(float));
+    Patch pa; patch_note_on_prepared(&pa,&pp,midi,vel);
+    for(int i=0;i<n;i+=AUDIO_BLOCK)
+        patch_step(&pa,buf+i,n-i<AUDIO_BLOCK?n-i:AUDIO_BLOCK);
+    return buf;
+}
+static float *render(const PatchProgram *pr, int midi, float vel, int n){
+    return render_with(patch_step,pr,midi,vel,n);
+}
 
-/* ===== Patch definitions ===== */
+/* Bank lanes vs independent scalar voices: max abs difference */
+static float bank_err(const PatchProgram *pr, int midi, int n){
+    static PreparedProgram pp; static PatchBank bk;
+    static const int iv[3]={0,7,12};
+    patch_prepare(&pp,pr,(float)SR); bank_init(&bk,&pp);
+    for(int v=0;v<3;v++) bank_note_on(&bk,midi+iv[v],0.8f);
+    float *lanes=(float*)calloc((size_t)n*BANK_LANES,sizeof(float));
+    for(int i=0;i<n;i+=AUDIO_BLOCK)
+        bank_step_lanes(&bk,lanes+(size_t)i*BANK_LANES,n-i<AUDIO_BLOCK?n-i:AUDIO_BLOCK);
+    float md=0;
+    for(int v=0;v<3;v++){
+        float *ref=render_with(patch_step_scalar,pr,midi+iv[v],0.8f,n);
+        for(int i=0;i<n;i++){ float e=fabsf(lanes[(size_t)i*BANK_LANES+v]-ref[i]); if(e>md)md=e; }
+        free(ref);
+    }
+    free(lanes);
+    return md;
+}
 
-static PatchProgram p_sine_adsr(void){
-    PatchBuilder b; pb_init(&b);
-    int env=pb_adsr(&b,3,10,22,18);
-    int osc=pb_osc(&b,REG_ONE);
-    pb_out(&b,pb_mul(&b,osc,env));
-    return *pb_finish(&b);
+/* Stealing and reclaim: fill every lane, release one, next note takes it */
+static int bank_steal_ok(const PatchProgram *pr){
+    static PreparedProgram pp; static PatchBank bk;
+    float blk[AUDIO_BLOCK];
+    patch_prepare(&pp,pr,(float)SR); bank_init(&bk,&pp);
+    for(int v=0;v<BANK_LANES;v++) bank_note_on(&bk,48+v,0.8f);
+    bank_note_off(&bk,50);
+    int ok=bank_active(&bk)==BANK_LANES && bank_note_on(&bk,72,0.8f)==2;
+    ok&=bank_note_on(&bk,73,0.8f)==0;             /* oldest otherwise */
+    bank_note_off(&bk,73);
+    for(int i=0;i<SR;i+=AUDIO_BLOCK) bank_step(&bk,blk,AUDIO_BLOCK);
+    return ok && bank_active(&bk)==BANK_LANES-1;  /* released lane reclaimed */
 }
-static PatchProgram p_saw_lpf(void){
+
+/* Gate API: release through the prepared table and the raw scan alike;
+   a zero-sustain envelope finishes too, and its bank lane is reclaimed */
+static int gate_ok(const PatchProgram *pr, const PatchProgram *no_env){
+    static PreparedProgram pp; static PatchBank bk;
+    float blk[AUDIO_BLOCK]; int ok=1;
     PatchBuilder b; pb_init(&b);
-    int env=pb_adsr(&b,2,8,20,15);
-    int saw=pb_saw(&b,REG_ONE);
-    int flt=pb_lpf(&b,saw,30);
-    pb_out(&b,pb_mul(&b,flt,env));
-    return *pb_finish(&b);
+    pb_out(&b,pb_mul(&b,pb_osc(&b,REG_ONE),pb_adsr(&b,1,8,0,10)));
+    const PatchProgram *progs[2]={ pr, pb_finish(&b) };
+    for(int g=0;g<2;g++){
+        patch_prepare(&pp,progs[g],(float)SR);
+        for(int mode=0;mode<2;mode++){
+            Patch pa;
+            if(mode) patch_note_on_prepared(&pa,&pp,60,0.8f);
+            else     patch_note_on(&pa,progs[g],(float)SR,60,0.8f);
+            for(int i=0;i<SR/10;i+=AUDIO_BLOCK) patch_step(&pa,blk,AUDIO_BLOCK);
+            ok&=patch_done(&pa)==0;
+            patch_note_off(&pa);
+            for(int i=0;i<SR;i+=AUDIO_BLOCK) patch_step(&pa,blk,AUDIO_BLOCK);
+            ok&=patch_done(&pa)==1;
+        }
+        bank_init(&bk,&pp);
+        bank_note_on(&bk,60,0.8f); bank_note_off(&bk,60);
+        for(int i=0;i<SR;i+=AUDIO_BLOCK) bank_step(&bk,blk,AUDIO_BLOCK);
+        ok&=bank_active(&bk)==0;
+    }
+    Patch pn; patch_note_on(&pn,no_env,(float)SR,60,0.8f);
+    return ok && patch_done(&pn)==-1;
 }
-static PatchProgram p_fm_2op(void){
-    PatchBuilder b; pb_init(&b);
-    int two=pb_const_f(&b,2.0f);
-    int mod=pb_osc(&b,two);
-    int car=pb_fm(&b,REG_ONE,mod,20);
-    int env=pb_adsr(&b,2,12,18,14);
-    pb_out(&b,pb_mul(&b,car,env));
-    return *pb_finish(&b);
+
+/* Retrigger: note-on over a used voice resets its whole footprint, so
+   the second note renders exactly like one on a fresh voice — also when
+   the program under-declares it (n_state 0, as older builders wrote) */
+static int retrigger_ok(const PatchProgram *pr){
+    static Patch pa, fresh;
+    static PatchProgram lie;
+    float a[AUDIO_BLOCK], b[AUDIO_BLOCK]; int ok=1;
+    lie=*pr; lie.n_state=0;
+    const PatchProgram *progs[2]={ pr, &lie };
+    for(int g=0;g<2;g++){
+        memset(&fresh,0,sizeof(fresh));
+        patch_note_on(&pa,progs[g],(float)SR,48,1.0f);
+        for(int i=0;i<SR/4;i+=AUDIO_BLOCK) patch_step(&pa,a,AUDIO_BLOCK);
+        patch_note_on(&pa,progs[g],(float)SR,60,0.8f);
+        patch_note_on(&fresh,progs[g],(float)SR,60,0.8f);
+        for(int i=0;i<SR/4;i+=AUDIO_BLOCK){
+            patch_step(&pa,a,AUDIO_BLOCK); patch_step(&fresh,b,AUDIO_BLOCK);
+            ok&=memcmp(a,b,sizeof(a))==0;
+        }
+    }
+    return ok;
 }
-static PatchProgram p_fm_fold(void){
+
+/* Dense state: two oscillators 128 instructions apart used to share
+   slots under the old i*4 layout; with dense offsets the second one
+   renders exactly like it does on its own */
+static int dense_state_ok(void){
     PatchBuilder b; pb_init(&b);
-    int three=pb_const_f(&b,3.0f);
-    int mod=pb_osc(&b,three);
-    int car=pb_fm(&b,REG_ONE,mod,25);
-    int fld=pb_fold(&b,car);
-    int flt=pb_lpf(&b,fld,38);
-    int env=pb_adsr(&b,1,8,16,12);
-    pb_out(&b,pb_mul(&b,flt,env));
-    return *pb_finish(&b);
+    int two=pb_const_f(&b,2.0f), a=pb_osc(&b,REG_ONE);
+    for(int i=0;i<127;i++) a=pb_abs(&b,a);
+    pb_out(&b,pb_osc(&b,two));
+    PatchProgram padded=*pb_finish(&b);
+    pb_init(&b); two=pb_const_f(&b,2.0f);
+    pb_out(&b,pb_osc(&b,two));
+    PatchProgram bare=*pb_finish(&b);
+    float *p0=render_with(patch_step_scalar,&padded,60,0.8f,SR/4);
+    float *p1=render(&padded,60,0.8f,SR/4);
+    float *r =render_with(patch_step_scalar,&bare,60,0.8f,SR/4);
+    int ok=padded.n_state==2 && p_sine_adsr().n_state==4 &&
+           !memcmp(p0,r,sizeof(float)*(SR/4)) && !memcmp(p1,r,sizeof(float)*(SR/4));
+    free(p0); free(p1); free(r);
+    return ok;
 }
-static PatchProgram p_noise_bpf(void){
-    PatchBuilder b; pb_init(&b);
-    int n=pb_noise(&b);
-    int f=pb_bpf(&b,n,35,25);
-    int e=pb_exp_decay(&b,18);
-    pb_out(&b,pb_mul(&b,f,e));
-    return *pb_finish(&b);
+
+/* Constant tables match their generating expressions; the fractional
+   lookups hit the entries at integer indices and clamp outside, and so
+   do ADSR attack indices 32..63 on both engines */
+static int tables_ok(void){
+    int ok=1;
+    PatchProgram pr[2];
+    for(int q=0;q<2;q++){
+        PatchBuilder b; pb_init(&b);
+        pb_out(&b,pb_adsr(&b,q?63:31,8,16,12));
+        pr[q]=*pb_finish(&b);
+    }
+    float *y0=render(&pr[0],60,1.f,SR/2), *y1=render(&pr[1],60,1.f,SR/2);
+    float *y2=render_with(patch_step_scalar,&pr[1],60,1.f,SR/2);
+    ok&=!memcmp(y0,y1,SR/2*sizeof(float))&&!memcmp(y0,y2,SR/2*sizeof(float));
+    free(y0); free(y1); free(y2);
+    for(int i=0;i<128;i++) ok&=fabsf(g_freq[i]/(440.f*powf(2.f,(i-69)/12.f))-1.f)<1e-6f;
+    for(int i=0;i<64;i++)  ok&=fabsf(g_cutoff[i]/(20.f*powf(1000.f,(float)i/63.f))-1.f)<1e-6f;
+    for(int i=0;i<32;i++)  ok&=fabsf(g_env[i]/(0.001f*powf(4000.f,(float)i/31.f))-1.f)<1e-6f;
+    for(int i=0;i<64;i++)  ok&=cutoff_hz_f((float)i)==g_cutoff[i];
+    for(int i=0;i<32;i++)  ok&=env_time_f((float)i)==g_env[i];
+    for(float x=0.f;x<63.f;x+=0.125f){
+        float v=cutoff_hz_f(x); int i=(int)x;
+        ok&=v>=g_cutoff[i] && v<=g_cutoff[i+1];
+    }
+    ok&=cutoff_hz_f(-3.f)==g_cutoff[0] && cutoff_hz_f(99.f)==g_cutoff[63];
+    ok&=env_time_f(NAN)==g_env[0] && env_time_f(31.5f)==g_env[31];
+    return ok;
+}
+
+/* Band-limited oscillators: a 3080 Hz tone (A4 x 7).  Its 8th/9th
+   harmonics fold back to 19460/16380 Hz, between real harmonics.  The
+   OSC_BLEP form must cut that alias by >= 8 dB and keep the fundamental
+   within 1 dB of the naive waveform. */
+static float tone_db(const float *x, int n, float hz){
+    double re=0, im=0, w=2.0*M_PI*hz/SR;
+    for(int i=0;i<n;i++){
+        double h=0.5-0.5*cos(2.0*M_PI*i/(n-1));
+        re+=h*x[i]*cos(w*i); im-=h*x[i]*sin(w*i);
+    }
+    return (float)(10.0*log10(re*re+im*im+1e-30));
 }
-static PatchProgram p_pad(void){
+static int bl_alias_ok(void){
+    static const struct { int (*naive)(PatchBuilder*,int), (*bl)(PatchBuilder*,int); float alias; }
+        W[3]={{pb_saw,pb_saw_bl,19460.f},{pb_square,pb_square_bl,16380.f},{pb_tri,pb_tri_bl,16380.f}};
+    int ok=1, n=8820;
+    for(int w=0;w<3;w++){
+        float f0[2], al[2];
+        for(int q=0;q<2;q++){
+            PatchBuilder b; pb_init(&b);
+            int m=pb_const_f(&b,7.0f);
+            pb_out(&b,(q?W[w].bl:W[w].naive)(&b,m));
+            PatchProgram pr=*pb_finish(&b);
+            float *x=render_with(patch_step_scalar,&pr,69,1.f,n);
+            f0[q]=tone_db(x,n,3080.f); al[q]=tone_db(x,n,W[w].alias);
+            free(x);
+        }
+        printf("  %-6s fundamental %+.2f dB   alias %6.1f -> %6.1f dB\n",
+               w==0?"saw":w==1?"square":"tri",f0[1]-f0[0],al[0]-f0[0],al[1]-f0[1]);
+        ok&=fabsf(f0[1]-f0[0])<1.f && al[1]-f0[1] <= al[0]-f0[0]-8.f;
+    }
+    return ok;
+}
+
+/* MATH_POLY kernels within the error table in patch_dsp.h.  Over a 2 s
+   note the MATH_RECUR decay stays within n*2^-24 of exp(-rate*i/SR)
+   (the reference drifts too: its float note_time accumulates rounding) */
+static int math_ok(void){
+    double es=0, ee=0, et=0, er=0, ef=0;
+    for(double x=-6.3;x<=6.3;x+=1e-5){ double e=fabs(sin_poly((float)x)-sin((float)x)); if(e>es)es=e; }
+    for(double x=-87;x<=0;x+=1e-4){ double r=exp((float)x), e=fabs(exp_poly((float)x)-r)/r; if(e>ee)ee=e; }
+    for(double x=-10;x<=10;x+=1e-5){ double e=fabs(tanh_poly((float)x)-tanh((float)x)); if(e>et)et=e; }
+    PatchProgram pr[2];
+    for(int q=0;q<2;q++){
+        PatchBuilder b; pb_init(&b);
+        pb_out(&b,pb_exp_decay_q(&b,4,q?MATH_RECUR:MATH_REF));
+        pr[q]=*pb_finish(&b);
+    }
+    float *ref=render(&pr[0],60,1.f,2*SR), *rec=render(&pr[1],60,1.f,2*SR);
+    double rate=g_mod[4]*20.f;
+    for(int i=0;i<2*SR;i++){
+        double x=exp(-rate*i/SR), e=fabs(rec[i]-x)/x, f=fabs(ref[i]-x)/x;
+        if(e>er)er=e;
+        if(f>ef)ef=f;
+    }
+    free(ref); free(rec);
+    printf("  sin_poly %.2g  exp_poly %.2g (rel)  tanh_poly %.2g\n"
+           "  2 s decay, rel: recursive %.2g  reference %.2g\n",es,ee,et,er,ef);
+    return es<=1.2e-6 && ee<=2.4e-7 && et<=4e-7 && er<=2.0*SR/16777216.0;
+}
+
+/* Oversampling: tanh(8 sin) at 2093 Hz (C7).  Its 15th harmonic,
+   31395 Hz, folds back to 12705 Hz at 1x; at 2x/4x it is generated
+   below the raised Nyquist and removed by the decimator.  The alias must
+   drop by >= 40 dB while the fundamental moves by < 0.1 dB.  A clip ->
+   clip chain shares one filter pair: on a signal inside +-1 it renders
+   bit-identically to a single clip, with no extra latency. */
+static int oversample_ok(void){
+    float f0[3], al[3]; int n=8820, ok=1;
+    for(int q=1;q<3;q++){
+        PatchProgram pr[2];
+        for(int k=0;k<2;k++){
+            PatchBuilder b; pb_init(&b);
+            int x=pb_mul(&b,pb_osc_q(&b,REG_ONE,MATH_POLY),pb_const_f(&b,0.5f));
+            pb_oversample(&b,q==1?OS_2X:OS_4X);
+            x=pb_clip(&b,x);
+            pb_out(&b,k?pb_clip(&b,x):x);
+            pr[k]=*pb_finish(&b);
+        }
+        float *y0=render_with(patch_step_scalar,&pr[0],69,1.f,n);
+        float *y1=render_with(patch_step_scalar,&pr[1],69,1.f,n);
+        float *y2=render(&pr[1],69,1.f,n);
+        ok&=!memcmp(y0,y1,n*sizeof(float))&&!memcmp(y0,y2,n*sizeof(float));
+        free(y0); free(y1); free(y2);
+    }
+    for(int q=0;q<3;q++){
+        PatchBuilder b; pb_init(&b);
+        int x=pb_mul(&b,pb_osc_q(&b,REG_ONE,MATH_POLY),pb_const_f(&b,8.f));
+        pb_oversample(&b,q==0?OS_1X:q==1?OS_2X:OS_4X);
+        pb_out(&b,pb_tanh(&b,x));
+        PatchProgram pr=*pb_finish(&b);
+        float *y=render_with(patch_step_scalar,&pr,96,1.f,n);
+        f0[q]=tone_db(y,n,2093.005f); al[q]=tone_db(y,n,12705.f);
+        free(y);
+    }
+    printf("  alias rel. fundamental: 1x %.1f  2x %.1f  4x %.1f dB\n",
+           al[0]-f0[0],al[1]-f0[1],al[2]-f0[2]);
+    for(int q=1;q<3;q++) ok&=fabsf(f0[q]-f0[0])<0.1f && al[q]-f0[q]<=al[0]-f0[0]-40.f;
+    return ok;
+}
+
+/* SVF: steady-state gain of a 440 Hz sine at cutoff == 440 Hz against
+   the analog prototype (LP/HP -3 dB at Q=1/sqrt2, LP +12 dB at Q=4, BP
+   0 dB, notch null), and a unity passband with cutoff and Q past
+   their clamps */
+static float svf_gain_db(int mode, float q, float ratio, float *peak){
     PatchBuilder b; pb_init(&b);
-    int o1=pb_osc(&b,REG_ONE);
-    int dt=pb_const_f(&b,1.008f);
-    int o2=pb_osc(&b,dt);
-    int mx=pb_mix(&b,o1,o2,15,15);
-    int lf=pb_const_f(&b,0.03f);
-    int lfo=pb_osc(&b,lf);
-    int am=pb_am(&b,mx,lfo,8);
-    int fl=pb_lpf(&b,am,40);
-    int en=pb_adsr(&b,15,5,28,20);
-    pb_out(&b,pb_mul(&b,fl,en));
-    return *pb_finish(&b);
+    int x=pb_osc_q(&b,REG_ONE,MATH_POLY);
+    int c=pb_mul(&b,REG_FREQ,pb_const_f(&b,ratio));
+    pb_out(&b,pb_svf(&b,x,c,pb_const_f(&b,q),mode));
+    PatchProgram pr=*pb_finish(&b);
+    int n=SR/2; float *y=render_with(patch_step_scalar,&pr,69,1.f,n), pk=0;
+    for(int i=n/2;i<n;i++) if(fabsf(y[i])>pk||!isfinite(y[i])) pk=fabsf(y[i]);
+    free(y); *peak=pk;
+    return 20.f*log10f(pk+1e-12f);
 }
-static PatchProgram p_square_hpf(void){
+static int svf_ok(void){
+    float pk, lp=svf_gain_db(SVF_LP,0.7071f,1.f,&pk), hp=svf_gain_db(SVF_HP,0.7071f,1.f,&pk);
+    float rs=svf_gain_db(SVF_LP,4.f,1.f,&pk), bp=svf_gain_db(SVF_BP,4.f,1.f,&pk);
+    float nt=svf_gain_db(SVF_NOTCH,0.7071f,1.f,&pk);
+    svf_gain_db(SVF_LP,127.f,64.f,&pk);         /* 28 kHz, Q 127: both clamped */
+    printf("  at fc: LP %+.2f  HP %+.2f  LP(Q=4) %+.2f  BP %+.2f  notch %+.1f dB\n"
+           "  clamped cutoff/Q passband peak %.4f\n",lp,hp,rs,bp,nt,pk);
+    return fabsf(lp+3.01f)<0.05f && fabsf(hp+3.01f)<0.05f && fabsf(rs-12.04f)<0.05f &&
+           fabsf(bp)<0.05f && nt<-40.f && isfinite(pk) && fabsf(pk-1.f)<0.01f;
+}
+
+/* Optimizer: the rewritten program renders bit-identically on the scalar
+   and block engines; feedback programs are passed through untouched */
+static int optimize_ok(const char *name, const PatchProgram *pr, int midi){
+    static PatchProgram opt; PatchOptStats st;
+    int ok=patch_optimize(&opt,pr,&st)==0;
+    float *ref=render_with(patch_step_scalar,pr,midi,0.8f,SR/2);
+    float *sc =render_with(patch_step_scalar,&opt,midi,0.8f,SR/2);
+    float *bl =render(&opt,midi,0.8f,SR/2);
+    ok&=!memcmp(ref,sc,sizeof(float)*(SR/2)) && !memcmp(ref,bl,sizeof(float)*(SR/2));
+    printf("  %-10s instrs %2d -> %2d  regs %2d -> %2d  state %d -> %d  folded %d  cse %d\n",
+           name,st.instrs_before,st.instrs_after,st.regs_before,st.regs_after,
+           st.state_before,st.state_after,st.folded,st.cse);
+    free(ref); free(sc); free(bl);
+    return ok && st.instrs_after<=st.instrs_before && st.regs_after<=st.regs_before;
+}
+static PatchProgram p_feedback(void){
     PatchBuilder b; pb_init(&b);
-    int sq=pb_square(&b,REG_ONE);
-    int hp=pb_hpf(&b,sq,15);
-    int en=pb_adsr(&b,0,8,18,12);
-    pb_out(&b,pb_mul(&b,hp,en));
+    int fb=pb_reg(&b);                       /* read before written */
+    int o=pb_osc(&b,pb_add(&b,REG_ONE,fb));
+    pb_emit(&b,INSTR_PACK(OP_MUL,fb,o,o,0,0));
+    pb_out(&b,o);
     return *pb_finish(&b);
 }
-static PatchProgram p_tri_tanh(void){
+static int optimize_feedback_ok(void){
+    PatchProgram pr=p_feedback(), opt;
+    return patch_optimize(&opt,&pr,NULL)==-1 && !memcmp(opt.code,pr.code,sizeof(Instr)*pr.n_instrs);
+}
+
+/* JIT: native code vs the exec1 reference, whole and ragged blocks */
+static int jit_diff_ok(const PatchProgram *pr, int midi){
+    static PreparedProgram pp;
+    if(patch_prepare(&pp,pr,(float)SR)||patch_jit(&pp)||!pp.jit) return 0;
+    float *ref=render_with(patch_step_scalar,pr,midi,0.8f,SR/2);
+    float *buf=(float*)calloc(SR/2,sizeof(float));
+    Patch pa; patch_note_on_prepared(&pa,&pp,midi,0.8f);
+    for(int i=0,c=AUDIO_BLOCK;i<SR/2;i+=c,c=c==AUDIO_BLOCK?13:AUDIO_BLOCK)
+        patch_step(&pa,buf+i,SR/2-i<c?SR/2-i:c);
+    int ok=!memcmp(ref,buf,sizeof(float)*(SR/2));
+    free(ref); free(buf);
+    return ok;
+}
+static PatchProgram p_arith(void){
     PatchBuilder b; pb_init(&b);
-    int tr=pb_tri(&b,REG_ONE);
-    int gn=pb_const_f(&b,4.0f);
-    int dr=pb_mul(&b,tr,gn);
-    int st=pb_tanh(&b,dr);
-    int en=pb_adsr(&b,2,10,20,15);
-    pb_out(&b,pb_mul(&b,st,en));
+    int o=pb_osc(&b,REG_ONE), t=pb_tri(&b,pb_const_f(&b,1.5f));
+    int q=pb_div(&b,o,t), z=pb_div(&b,o,pb_sub(&b,t,t));
+    int v=pb_add(&b,pb_neg(&b,pb_abs(&b,q)),z);
+    pb_out(&b,pb_clip(&b,pb_mul(&b,v,pb_const_f(&b,0.25f))));
     return *pb_finish(&b);
 }
+static int jit_ok(const PatchProgram *T0, int nt, const PatchProgram *fb){
+    static PreparedProgram a, c;
+    PatchProgram ar=p_arith();
+    int ok=jit_diff_ok(&ar,60);
+    for(int t=0;t<nt;t++) ok&=jit_diff_ok(&T0[t],60);
+    patch_prepare(&a,&T0[0],(float)SR); patch_prepare(&c,&T0[0],48000.f);
+    ok&=!patch_jit(&a) && !patch_jit(&c) && a.jit==c.jit;       /* cache hit */
+    ok&=patch_prepare(&a,fb,(float)SR)==0 && patch_jit(&a)==-1 && !a.jit;
+    return ok;
+}
+
+/* Patch file: every test patch round-trips through a mapped file and
+   renders bit-identically; corrupt bytes and out-of-range operands are
+   refused before anything runs */
+static int file_ok(const PatchProgram *T0, int nt){
+    static uint64_t buf[8192], cp[8192];
+    const char *path="/tmp/shmc_layer0.shmc";
+    PfWriter w; pf_writer_init(&w,buf,sizeof(buf));
+    char name[PF_NAME];
+    for(int t=0;t<nt;t++){ snprintf(name,sizeof(name),"p%d",t); pf_add_patch(&w,name,&T0[t]); }
+    size_t sz=pf_finish(&w);
+    FILE *fo=fopen(path,"wb"); if(!fo||!sz) return 0;
+    fwrite(buf,1,sz,fo); fclose(fo);
+
+    PatchFile f; int ok=pf_open(&f,path)==PF_OK && f.n==nt, n, e;
+    for(int t=0;ok&&t<nt;t++){
+        static PatchProgram pr;
+        snprintf(name,sizeof(name),"p%d",t);
+        int i=pf_find(&f,name);
+        const Instr *code=pf_patch_code(&f,i,&n,NULL);
+        ok&=code && (const uint8_t*)code>=f.base && (const uint8_t*)code<f.base+f.size;
+        ok&=pf_patch_load(&f,i,&pr)==PF_OK && n==T0[t].n_instrs;
+        float *a=render_with(patch_step_scalar,&T0[t],60,0.8f,SR/10);
+        float *b=render_with(patch_step_scalar,&pr,60,0.8f,SR/10);
+        ok&=!memcmp(a,b,sizeof(float)*(SR/10));
+        free(a); free(b);
+    }
+    printf("  %d patches, %zu bytes, mapped\n",nt,sz);
+    ok&=pf_find(&f,"nope")==PF_E_ENTRY;
+    pf_close(&f);
+
+    /* Damage a copy: payload byte, table byte, truncation, bad magic */
+    PatchProgram tmp; PatchFile v;
+    memcpy(cp,buf,sz); ((uint8_t*)cp)[sizeof(PfHeader)+3]^=1;
+    ok&=pf_view(&v,cp,sz)==PF_OK && pf_patch_load(&v,0,&tmp)==PF_E_CHECKSUM;
+    ok&=pf_patch_code(&v,0,&n,&e)==NULL && e==PF_E_CHECKSUM;
+    memcpy(cp,buf,sz); ((uint8_t*)cp)[sz-5]^=1;
+    ok&=pf_view(&v,cp,sz)==PF_E_CHECKSUM;
+    ok&=pf_view(&v,buf,sz-8)==PF_E_BOUNDS;
+    memcpy(cp,buf,sz); ((uint8_t*)cp)[0]='X';
+    ok&=pf_view(&v,cp,sz)==PF_E_FORMAT;
+
+    /* Validator */
+    PatchProgram bad=T0[0];
+    bad.code[0]=INSTR_PACK(OP_COUNT,REG_FREE,0,0,0,0);
+    ok&=patch_validate(&bad)==PF_E_OPCODE;
+    bad=T0[0]; bad.code[bad.n_instrs-1]=INSTR_PACK(OP_OUT,0,bad.n_regs,0,0,0);
+    ok&=patch_validate(&bad)==PF_E_REG;
+    bad=T0[0]; bad.n_state--;
+    ok&=patch_validate(&bad)==PF_E_STATE;
+    bad=T0[0]; bad.code[0]=INSTR_PACK(OP_ADSR,REG_FREE,0,0,40<<10,0);
+    ok&=patch_validate(&bad)==PF_E_OPERAND;
+    pf_writer_init(&w,buf,sizeof(buf));
+    ok&=pf_add_patch(&w,"bad",&bad)==PF_E_OPERAND && pf_finish(&w)==0;
+    pf_writer_init(&w,buf,100);      /* header + 32 B of code + 48 B entry > 100 */
+    ok&=pf_add_patch(&w,"big",&T0[0])==PF_E_FULL;
+    return ok;
+}
+
+/* Assembler: every test patch survives disassemble + assemble word for
+   word (a bank in one source), odd encodings fall back to .word,
+   synth.asm assembles, and errors carry their line */
+typedef struct { const PatchProgram *ref; int n, ok; PatchProgram last; } AsmCheck;
+static int asm_cmp(void *user, const char *name, const PatchProgram *pr, float sr){
+    AsmCheck *c=(AsmCheck*)user; (void)name; (void)sr;
+    if(c->ref){
+        const PatchProgram *r=&c->ref[c->n];
+        c->ok&=pr->n_instrs==r->n_instrs && pr->n_regs==r->n_regs && pr->n_state==r->n_state &&
+               !memcmp(pr->code,r->code,sizeof(Instr)*r->n_instrs);
+    }
+    c->last=*pr; c->n++;
+    return 0;
+}
+static int asm_ok(const PatchProgram *T0, int nt, const PatchProgram *fb){
+    static PatchProgram P[32];
+    char *src; size_t len; char name[16];
+    FILE *m=open_memstream(&src,&len);
+    for(int t=0;t<nt;t++){ P[t]=T0[t]; snprintf(name,sizeof(name),"p%d",t); patch_disasm(m,name,&P[t]); }
+    PatchBuilder b; pb_init(&b);                /* stray bits -> .word */
+    pb_emit(&b,INSTR_PACK(OP_NEG,REG_FREE,REG_ONE,7,0,0));
+    pb_emit(&b,INSTR_PACK(OP_OSC,REG_FREE+1,REG_FREE,0,0,5));
+    pb_out(&b,REG_FREE+1); b.rc=REG_FREE+2;
+    P[nt]=*pb_finish(&b); patch_disasm(m,"odd",&P[nt]);
+    fclose(m);
+    AsmCheck c={ P,0,1 }; PatchAsmError e;
+    int ok=patch_asm_bank(src,len,asm_cmp,&c,&e)==nt+1 && c.ok && strstr(src,".word");
+    printf("  round trip: %d patches, %zu bytes of source\n",c.n,len);
+    free(src);
+
+    FILE *f=fopen("../synth.asm","rb"); static char buf[8192]; size_t n=0;
+    if(f){ n=fread(buf,1,sizeof(buf),f); fclose(f); }
+    c=(AsmCheck){ NULL,0,1 };
+    ok&=patch_asm_bank(buf,n,asm_cmp,&c,&e)==3 && c.n==3;
+    ok&=c.last.n_instrs==10 && !patch_validate(&c.last);
+    PatchProgram one;
+    const char *fbs="REG fb\nADD ph one fb\nOSC o ph\nMUL fb o o\nOUT o\n";
+    ok&=patch_asm(fbs,strlen(fbs),&one,&e)==0 && one.n_instrs==fb->n_instrs &&
+        !memcmp(one.code,fb->code,sizeof(Instr)*fb->n_instrs);
+    const char *units="LPF a one 1.2kHz\nLPF b one #40\nADSR c 0.002s 150ms 0.5 #3\nOUT c\n";
+    ok&=patch_asm(units,strlen(units),&one,&e)==0 && INSTR_IMM_HI(one.code[0])==37 &&
+        INSTR_IMM_HI(one.code[1])==40 && INSTR_IMM_LO(one.code[2])==(3<<11);
+    const char *q88="CONST a -128\nCONST b 127.99609375\nOUT a\n";   /* Q8.8 ends */
+    ok&=patch_asm(q88,strlen(q88),&one,&e)==0 && INSTR_IMM_HI(one.code[0])==0x8000 &&
+        INSTR_IMM_HI(one.code[1])==0x7FFF;
+
+    const char *bad[]={ "ADD x one\nOUT x\n", "ADD x one y\nOUT x\n", "WOBBLE x\n",
+                        "PATCH a\nOUT one\n", "LPF x one 5V\n", "OSC x one blep\n",
+                        "CONST x 128\nOUT x\n" };
+    for(int i=0;i<7;i++) ok&=patch_asm(bad[i],strlen(bad[i]),&one,&e)==-1 && e.line>=1;
+    patch_asm(bad[1],strlen(bad[1]),&one,&e);
+    printf("  error: line %d: %s\n",e.line,e.msg);
+    return ok && e.line==1;
+}
+
+/* Every instruction up to OUT is counted once per sample, on the block
+   and the scalar path; a build without SHMC_PROFILE counts nothing */
+static int prof_ok(const PatchProgram *pr){
+    static PreparedProgram pp;
+    float buf[4096];
+    patch_prof_reset();
+    patch_prof_name(pr,"sine_adsr");
+    patch_prepare(&pp,pr,(float)SR);
+    Patch pa; patch_note_on_prepared(&pa,&pp,60,0.8f);
+    for(int i=0;i<4096;i+=AUDIO_BLOCK) patch_step(&pa,buf+i,AUDIO_BLOCK);
+    patch_step_scalar(&pa,buf,100);
+    PatchProfStat ps, os, as;
+    int on=patch_prof_program(pr,&ps);
+    patch_prof_op(OP_OUT,&os); patch_prof_op(OP_ADSR,&as);
+    if(!patch_prof_enabled()){
+        printf("  disabled: nothing recorded\n");
+        return !on && ps.count==0 && os.count==0;
+    }
+    patch_prof_report(stdout,4);
+    return on && ps.count==4196 && os.count==4196 && as.count==4196 && ps.ticks>0;
+}
 
 /* ===== Main ===== */
+/* ---- Checks ----
+   One row per check; main() runs every row, so the count can't drift.
+   The reference patches are in REF while the checks run. */
+typedef struct { const char *name, *desc; PatchProgram prog; int note; } RefPatch;
+static const RefPatch *REF;
+static int NREF;
+
+static int ref_progs(PatchProgram *P){
+    for(int t=0;t<NREF;t++) P[t]=REF[t].prog;
+    return NREF;
+}
+static int gate_t(void){ return gate_ok(&REF[0].prog,&REF[4].prog); }
+static int retrigger_t(void){
+    int ok=1;
+    printf("  sizeof(PatchState)=%zu\n",sizeof(PatchState));
+    for(int t=0;t<NREF;t++) ok&=retrigger_ok(&REF[t].prog);
+    return ok;
+}
+static int bank_steal_t(void){ return bank_steal_ok(&REF[0].prog); }
+static int optimize_t(void){
+    int ok=optimize_feedback_ok();
+    for(int t=0;t<NREF;t++) ok&=optimize_ok(REF[t].name,&REF[t].prog,REF[t].note);
+    PatchProgram go, gp=p_generated(); PatchOptStats gs;
+    patch_optimize(&go,&gp,&gs);
+    return ok&&gs.instrs_after==7;
+}
+static int jit_t(void){
+    PatchProgram P[MAX_REF], fb=p_feedback();
+    return jit_ok(P,ref_progs(P),&fb);
+}
+static int file_t(void){ PatchProgram P[MAX_REF]; return file_ok(P,ref_progs(P)); }
+static int asm_t(void){
+    PatchProgram P[MAX_REF], fb=p_feedback();
+    return asm_ok(P,ref_progs(P),&fb);
+}
+static int prof_t(void){ return prof_ok(&REF[0].prog); }
+
+static const struct { const char *name, *desc; int (*fn)(void); } CHECKS[]={
+    {"gate",        "patch_note_off / patch_done",                        gate_t},
+    {"retrigger",   "Footprint-only reset",                               retrigger_t},
+    {"bank_steal",  "Voice stealing + reclaim",                           bank_steal_t},
+    {"dense_state", "Program-order state offsets, no aliasing",           dense_state_ok},
+    {"tables",      "Constant tables, interpolated lookups",              tables_ok},
+    {"bl_alias",    "PolyBLEP / PolyBLAMP oscillators",                   bl_alias_ok},
+    {"math",        "Polynomial kernels vs libm, recursive decay",        math_ok},
+    {"oversample",  "2x / 4x half-band nonlinearities",                   oversample_ok},
+    {"svf",         "TPT state-variable filter response",                 svf_ok},
+    {"optimize",    "Folding / CSE / DCE / register compaction",          optimize_t},
+    {"jit",         "Native code == exec1, cache, interpreter fallback",  jit_t},
+    {"patch_file",  "Binary library: mmap, checksums, validation",        file_t},
+    {"asm",         "Assembler / disassembler round trip",                asm_t},
+    {"prof",        "Per-instruction profiling counters",                 prof_t},
+};
+
 int main(void){
-    tables_init();
     printf("=== SHMC Layer 0  —  Patch Interpreter Test ===\n\n");
 
-    struct { const char *name, *desc; PatchProgram prog; int note; } T[]={
+    const RefPatch T[]={
         {"sine_adsr",  "Sine + ADSR",             p_sine_adsr(),   69},
         {"saw_lpf",    "Sawtooth + LPF",           p_saw_lpf(),     60},
         {"fm_2op",     "FM 2-operator",             p_fm_2op(),      60},
@@ -129,10 +585,17 @@ int main(void){
         {"pad",        "Detuned OSC + AM LFO + LPF",p_pad(),         60},
         {"square_hpf", "Square + HPF (buzz)",       p_square_hpf(),  60},
         {"tri_tanh",   "Triangle + tanh saturation",p_tri_tanh(),    60},
+        {"generated",  "Generator-style redundancy",p_generated(),   60},
+        {"bl_osc",     "Band-limited saw/square/tri",p_bl_osc(),     84},
+        {"poly_math",  "Polynomial sin/tanh/exp",   p_poly_math(),   57},
+        {"svf_sweep",  "TPT SVF, register cutoff/Q",p_svf_sweep(),   48},
+        {"drive_os",   "Fold 2x + tanh 4x oversampled",p_drive_os(),  60},
     };
-    int nt=sizeof(T)/sizeof(T[0]), pass=0, fail=0;
+    int np=sizeof(T)/sizeof(T[0]), nc=sizeof(CHECKS)/sizeof(CHECKS[0]), pass=0;
+    _Static_assert(sizeof(T)/sizeof(T[0])<=MAX_REF,"MAX_REF");
+    REF=T; NREF=np;
 
-    for(int t=0;t<nt;t++){
+    for(int t=0;t<np;t++){
         printf("[%s]  %s\n", T[t].name, T[t].desc);
         float *buf=render(&T[t].prog, T[t].note, 0.8f, NDUR);
         float pk=0; int nans=0;
@@ -143,10 +606,25 @@ int main(void){
         char path[256];
         snprintf(path,sizeof(path),"/mnt/user-data/outputs/%s.wav",T[t].name);
         write_wav(path,buf,NDUR);
-        if(nans==0 && pk>1e-5f){ printf("  PASS  peak=%.4f\n\n",pk); pass++; }
-        else                    { printf("  FAIL  peak=%g  nans=%d\n\n",pk,nans); fail++; }
-        free(buf);
+        /* Block and prepared engines must match the per-sample reference exactly */
+        float *ref=render_with(patch_step_scalar,&T[t].prog,T[t].note,0.8f,NDUR);
+        float *prp=render_prepared(&T[t].prog,T[t].note,0.8f,NDUR);
+        float md=0;
+        for(int i=0;i<NDUR;i++){
+            float e=fabsf(buf[i]-ref[i]); if(e>md)md=e;
+            e=fabsf(prp[i]-ref[i]);       if(e>md)md=e;
+        }
+        float be=bank_err(&T[t].prog,T[t].note,NDUR/4); if(be>md)md=be;
+        if(nans==0 && pk>1e-5f && md==0.f){ printf("  PASS  peak=%.4f  block==prepared==bank==scalar\n\n",pk); pass++; }
+        else printf("  FAIL  peak=%g  nans=%d  engine_err=%g\n\n",pk,nans,md);
+        free(prp); free(ref); free(buf);
+    }
+    for(int c=0;c<nc;c++){
+        printf("[%s]  %s\n",CHECKS[c].name,CHECKS[c].desc);
+        int ok=CHECKS[c].fn();
+        printf(ok?"  PASS\n\n":"  FAIL\n\n");
+        pass+=ok;
     }
-    printf("=== %d / %d passed ===\n", pass, nt);
-    return fail ? 1 : 0;
+    printf("=== %d / %d passed ===\n", pass, np+nc);
+    return pass==np+nc ? 0 : 1;
 }
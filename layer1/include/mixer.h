@@ -0,0 +1,76 @@
+#pragma once
+/*
+ * SHMC Layer 1 — Multi-track renderer
+ *
+ * Renders many tracks (one VoiceRenderer each: EventStream + patch) in
+ * parallel, MIX_BLOCK samples at a time, on a small work-stealing pool.
+ * Each block, the live tracks are dealt round-robin onto per-thread task
+ * queues; a thread that runs out of its own tasks steals from the others.
+ * Every track renders into its own buffer, and the master bus is summed
+ * afterwards in track order — so output is bit-identical for any thread
+ * count, including 1.
+ *
+ * The calling thread is worker 0; n_threads-1 extra threads are started
+ * by mixer_init() and parked between blocks.
+ *
+ * Usage:
+ *   Mixer m; mixer_init(&m, 4);
+ *   mixer_add_track(&m, &bass_vr, 0.8f);
+ *   mixer_add_track(&m, &lead_vr, 0.5f);
+ *   while(!mixer_render_block(&m, out, 1024)) ...;
+ *   mixer_free(&m);
+ */
+#include <pthread.h>
+#include "voice.h"
+
+#define MIX_MAX_TRACKS   256
+#define MIX_MAX_THREADS  64
+#define MIX_BLOCK        1024   /* samples per scheduled task */
+
+/* Task queue of one worker: track indices [head, tail) */
+typedef struct {
+    pthread_mutex_t lk;
+    int             task[MIX_MAX_TRACKS];
+    int             head, tail;
+} MixQueue;
+
+struct Mixer;
+typedef struct { struct Mixer *m; int id; } MixWorker;
+
+typedef struct Mixer {
+    VoiceRenderer  *track[MIX_MAX_TRACKS];
+    float           gain[MIX_MAX_TRACKS];
+    uint8_t         live[MIX_MAX_TRACKS];  /* rendered in this block  */
+    int             n_tracks;
+    float          *buf;                   /* [n_tracks][MIX_BLOCK]   */
+    int             n;                     /* samples in this block   */
+    int             n_threads;
+    MixQueue        q[MIX_MAX_THREADS];
+    MixWorker       w[MIX_MAX_THREADS];
+    pthread_t       thr[MIX_MAX_THREADS];
+    pthread_mutex_t lk;
+    pthread_cond_t  go, idle;
+    unsigned        gen;                   /* bumped once per block   */
+    int             pending;               /* tasks not yet finished  */
+    int             quit;
+} Mixer;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Start the pool (n_threads clamped to 1..MIX_MAX_THREADS).
+   Returns 0, or -1 if no memory / threads could be had. */
+int  mixer_init(Mixer *m, int n_threads);
+/* Add an initialized VoiceRenderer, mixed at gain.  The renderer is
+   driven by the mixer from now on.  Returns the track index or -1. */
+int  mixer_add_track(Mixer *m, VoiceRenderer *vr, float gain);
+/* Render n samples of the master bus (any n; scheduled in MIX_BLOCK
+   chunks).  Returns 0 while any track is playing, 1 when all are done. */
+int  mixer_render_block(Mixer *m, float *out, int n);
+/* Stop and join the workers, release the track buffers. */
+void mixer_free(Mixer *m);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,102 @@
+#pragma once
+/*
+ * SHMC Layer 1 — Real-time audio callback driver
+ *
+ * Wraps one VoiceRenderer for use from an audio device callback.  A
+ * control thread posts commands (note on/off, patch swap, tempo) into a
+ * single-producer / single-consumer ring; the audio thread drains it at
+ * every AUDIO_BLOCK boundary inside rt_driver_process() and renders.
+ * The audio side takes no locks, allocates nothing and makes no system
+ * calls (the optional clock is the caller's), so its cost per callback
+ * is bounded by the voice count.
+ *
+ * Each callback of n frames has a deadline of n/sr seconds.  With a
+ * clock installed, rt_driver_process() times its own body and counts
+ * callbacks that overran; tests pass a simulated clock.
+ *
+ * Usage:
+ *   RtDriver d; rt_driver_init(&d, &prog, NULL, 44100.f, 120.f, 8, now_ns);
+ *   control thread:  rt_note_on(&d, 60, 0.8f); ... rt_note_off(&d, 60);
+ *   audio callback:  rt_driver_process(&d, out, frames);
+ */
+#include <stdatomic.h>
+#include "voice.h"
+
+#define RT_QUEUE_SIZE 256           /* commands in flight; power of two */
+
+typedef enum {
+    RT_CMD_NOTE_ON = 0,
+    RT_CMD_NOTE_OFF,
+    RT_CMD_PATCH,                   /* program for subsequent notes     */
+    RT_CMD_TEMPO,
+    RT_CMD_ALL_OFF,                 /* release every sounding voice     */
+} RtCmdType;
+
+typedef struct {
+    uint8_t  type;                  /* RtCmdType                        */
+    uint8_t  pitch;
+    float    value;                 /* velocity, or bpm for RT_CMD_TEMPO */
+    const PreparedProgram *prep;    /* RT_CMD_PATCH (NULL: default)     */
+} RtCmd;
+
+/* Ring of commands [head, tail); indices run free and wrap by mask.
+   Each end writes only its own index. */
+typedef struct {
+    RtCmd                          buf[RT_QUEUE_SIZE];
+    _Alignas(64) _Atomic uint32_t  head;    /* consumer (audio thread)   */
+    _Alignas(64) _Atomic uint32_t  tail;    /* producer (control thread) */
+} RtQueue;
+
+/* Nanosecond monotonic clock; NULL disables timing */
+typedef uint64_t (*RtClock)(void);
+
+typedef struct {
+    uint64_t callbacks;
+    uint64_t misses;                /* callbacks that overran n/sr      */
+    uint64_t worst_ns;              /* longest callback                 */
+    uint64_t last_ns;
+    uint64_t commands;              /* applied by the audio thread      */
+    uint64_t dropped;               /* rejected by a full queue         */
+} RtStats;
+
+typedef struct {
+    VoiceRenderer     vr;
+    RtQueue           q;
+    RtClock           clock;
+    _Atomic uint64_t  callbacks, misses, worst_ns, last_ns, commands;
+    _Atomic uint64_t  dropped;      /* written by the control thread    */
+} RtDriver;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* es may be NULL (live input only).  With a sequence, live notes still
+   play after it ends: the renderer resumes for them.  No allocation;
+   no threads. */
+void rt_driver_init(RtDriver *d, const PatchProgram *patch, const EventStream *es,
+                    float sr, float bpm, int polyphony, RtClock clock);
+
+/* ---- Control thread (single producer) ----
+   Return 0, or -1 if the queue is full (the command is dropped and
+   counted).  Commands take effect at the next AUDIO_BLOCK boundary.  */
+int  rt_queue_push(RtQueue *q, const RtCmd *cmd);
+int  rt_note_on(RtDriver *d, int pitch, float vel);
+int  rt_note_off(RtDriver *d, int pitch);
+int  rt_all_off(RtDriver *d);
+/* pp must stay valid while any voice started with it sounds */
+int  rt_set_patch(RtDriver *d, const PreparedProgram *pp);
+int  rt_set_tempo(RtDriver *d, float bpm);
+
+/* ---- Audio thread (single consumer) ---- */
+/* 1 if a command was taken, 0 if the queue was empty */
+int  rt_queue_pop(RtQueue *q, RtCmd *cmd);
+/* Render frames samples (any count) into out */
+void rt_driver_process(RtDriver *d, float *out, int frames);
+
+/* Snapshot of the counters; safe from any thread */
+void rt_driver_stats(const RtDriver *d, RtStats *st);
+
+#ifdef __cplusplus
+}
+#endif
@@ -7,21 +7,29 @@
  *
  * Compilation:
  *   voice_compile()  →  EventStream  (sorted timed note-on/off events)
+ *   VoiceCursor      →  the same events one at a time, on demand
  *
  * The EventStream feeds into the Layer 0 Patch engine via voice_render().
  *
  * Pitch domain : MIDI 0-127
- * Duration     : index into DUR_TABLE  {1/64 1/32 1/16 1/8 1/4 1/2 1} beat
+ * Duration     : index into DUR_TICKS  {1/64 1/32 1/16 1/8 1/4 1/2 1} beat
+ * Time         : integer ticks, VOICE_PPQ per beat; converted to samples
+ *                exactly (integer arithmetic) at the renderer's bpm / sr
  * Velocity     : index into VEL_TABLE  {8 steps, 0.125..1.0}
  */
 
 #include <stdint.h>
 #include "../../layer0/include/patch.h"   /* PatchProgram, Patch, tables */
+#include "../../layer0/include/patch_file.h"  /* PatchFile, PF_E_* */
 
 /* ---- Limits ---- */
 #define VOICE_MAX_INSTRS  4096
 #define VOICE_MAX_EVENTS  8192
 #define VOICE_MAX_REPEAT   8    /* nesting depth */
+#define VOICE_MAX_POLY    16    /* voice pool size */
+
+/* ---- Timeline resolution: ticks per beat ---- */
+#define VOICE_PPQ 960
 
 /* ---- Duration table index (7 values) ---- */
 #define DUR_1_64  0
@@ -42,7 +50,8 @@
 #define VEL_F     6
 #define VEL_FF    7
 
-extern const float VEL_TABLE[8];  /* 0.125, 0.25, ... 1.0 */
+extern const float    VEL_TABLE[8];  /* 0.125, 0.25, ... 1.0 */
+extern const uint32_t DUR_TICKS[7];  /* 15, 30, ... 960      */
 
 /* ---- VoiceInstr opcodes ---- */
 typedef enum {
@@ -58,7 +67,7 @@ typedef enum {
 /* ---- Packed instruction (fits in 32 bits) ----
    [31:24] opcode  (8b)
    [23:16] pitch   (8b)  MIDI 0-127 / unused
-   [15: 8] dur_idx (8b)  index into g_dur
+   [15: 8] dur_idx (8b)  index into DUR_TICKS
    [ 7: 0] vel_idx (8b)  index into VEL_TABLE / repeat count
 */
 typedef uint32_t VInstr;
@@ -81,9 +90,10 @@ typedef struct {
 /* ---- Event types ---- */
 typedef enum { EV_NOTE_ON=0, EV_NOTE_OFF } EvType;
 
-/* ---- Event: one note-on or note-off at a beat-time ---- */
+/* ---- Event: one note-on or note-off at a tick ----
+   uint32 ticks last 621 hours at 120 bpm. */
 typedef struct {
-    float   beat;       /* time in beats from start  */
+    uint32_t tick;      /* VOICE_PPQ ticks from start */
     EvType  type;
     uint8_t pitch;
     float   velocity;   /* 0..1                      */
@@ -91,22 +101,77 @@ typedef struct {
 
 /* ---- EventStream: sorted list of Events ---- */
 typedef struct {
-    Event events[VOICE_MAX_EVENTS];
-    int   n;
-    float total_beats;  /* total duration of the voice */
+    Event    events[VOICE_MAX_EVENTS];
+    int      n;
+    uint32_t total_ticks;  /* total duration of the voice */
 } EventStream;
 
-/* ---- VoiceRenderer: stateful playback of EventStream via Patch ---- */
+/* ---- VoiceCursor: streaming event generator ----
+   Walks the VoiceProgram directly, producing the events voice_compile()
+   would, in the same order and at the same ticks.  REPEAT blocks
+   are looped through a jump table (BEGIN -> matching END, built once by
+   voice_cursor_init) and a counter stack, so memory is bounded by the
+   nesting depth, not the expanded length.  A NOTE/GLIDE's note-off is
+   held back until the next note starts or the program ends, because a
+   later TIE may still extend it.                                        */
+typedef struct {
+    const VoiceProgram *vp;
+    int16_t jump[VOICE_MAX_INSTRS];  /* BEGIN: its END; -1 unmatched  */
+    struct { int16_t begin; int16_t left; } loop[VOICE_MAX_REPEAT];
+    int     depth;
+    int     pc;
+    uint32_t tick;                   /* current position               */
+    Event   off;                     /* held note-off                  */
+    int     has_off;
+    Event   q[2];                    /* produced, not yet taken        */
+    int     q_head, q_n;
+    int     err;                     /* -1: unmatched REPEAT_BEGIN     */
+} VoiceCursor;
+
+/* ---- Voice stealing policy when every pool slot is busy ---- */
+typedef enum {
+    STEAL_OLDEST = 0,   /* earliest note-on                        */
+    STEAL_QUIETEST,     /* lowest output peak this AUDIO_BLOCK     */
+    STEAL_SAME_PITCH    /* retrigger a voice already on this pitch,
+                           else oldest                             */
+} StealPolicy;
+
+/* ---- One pool slot ---- */
+typedef struct {
+    Patch    patch;
+    uint8_t  pitch;
+    uint8_t  released;   /* note-off received         */
+    uint32_t age;        /* note-on serial            */
+    float    level;      /* peak |out| this block     */
+} VoiceSlot;
+
+/* ---- VoiceRenderer: stateful playback of EventStream via Patch ----
+   Voices come from a fixed pool.  Only active slots are rendered: they
+   are kept in a dense index list and returned to a free list as soon as
+   their envelopes finish releasing.                                     */
 typedef struct {
-    const EventStream  *es;
+    const EventStream  *es;           /* NULL: live input only       */
+    VoiceCursor        *src;          /* streaming source, or NULL   */
     const PatchProgram *patch_prog;
+    PreparedProgram     prep;         /* decoded once, shared by notes */
+    const PreparedProgram *cur;       /* program for new notes       */
     float               bpm;
     float               sr;
-    float               beat_time;    /* current position in beats  */
-    float               sample_time;  /* current position in seconds */
+    int64_t             mbpm;         /* tempo, 1/1000 bpm           */
+    int64_t             sr_i;         /* sample rate, Hz             */
+    int64_t             tick_origin;  /* tempo segment start, in
+                                         1/(125*sr_i) of a tick      */
+    int64_t             sample_origin;/*   ... and its sample        */
+    int64_t             sample_pos;   /* current position in samples */
     int                 ev_cursor;    /* next event to process       */
-    Patch               active;       /* currently playing patch     */
-    int                 has_active;
+    VoiceSlot           voices[VOICE_MAX_POLY];
+    int                 active[VOICE_MAX_POLY];  /* active slot indices */
+    int                 n_active;
+    int                 free_list[VOICE_MAX_POLY];
+    int                 n_free;
+    int                 polyphony;    /* max simultaneous voices     */
+    StealPolicy         steal;
+    uint32_t            serial;
     int                 done;
 } VoiceRenderer;
 
@@ -120,6 +185,21 @@ extern "C" {
    Returns 0 on success, -1 on overflow. */
 int voice_compile(const VoiceProgram *vp, EventStream *es);
 
+/* Prepare a cursor over vp (which must outlive it).  Returns 0, or -1
+   if REPEAT nesting exceeds VOICE_MAX_REPEAT. */
+int voice_cursor_init(VoiceCursor *c, const VoiceProgram *vp);
+
+/* ---- Loading from a patch file ---- */
+/* Known opcodes, NOTE/GLIDE pitch 0-127, REPEAT blocks balanced and at
+   most VOICE_MAX_REPEAT deep.  Returns 0 or a PF_E_* code. */
+int voice_validate(const VInstr *code, int n);
+/* Validated copy of voice entry i */
+int voice_load(const PatchFile *f, int i, VoiceProgram *vp);
+/* Next event without consuming it; NULL at the end (or on error) */
+const Event *voice_cursor_peek(VoiceCursor *c);
+/* Take the next event: 1, 0 at the end, -1 on an unmatched REPEAT_BEGIN */
+int voice_cursor_next(VoiceCursor *c, Event *ev);
+
 /* ---- Rendering ---- */
 /* Initialize renderer.  Call before voice_render_block(). */
 void voice_renderer_init(VoiceRenderer *vr,
@@ -127,8 +207,44 @@ void voice_renderer_init(VoiceRenderer *vr,
                          const PatchProgram *patch,
                          float bpm, float sr);
 
+/* Initialize a renderer that pulls events from a cursor as it plays,
+   instead of a precompiled EventStream. */
+void voice_renderer_init_stream(VoiceRenderer *vr, VoiceCursor *src,
+                                const PatchProgram *patch,
+                                float bpm, float sr);
+
+/* Set the number of simultaneous voices (1..VOICE_MAX_POLY) and the
+   stealing policy.  The default after init is 1 voice, STEAL_OLDEST:
+   each note-on cuts the previous note, as a monophonic synth.        */
+void voice_renderer_set_polyphony(VoiceRenderer *vr, int polyphony,
+                                  StealPolicy steal);
+
+/* Number of voices currently sounding. */
+int voice_renderer_active(const VoiceRenderer *vr);
+
+/* ---- Live control ----
+   Applied at the current position, alongside the EventStream.  A
+   renderer initialized with es==NULL plays live input only and never
+   reports done.  A note-on after the sequence has finished resumes
+   rendering until its voice is reclaimed.                             */
+void voice_renderer_note_on(VoiceRenderer *vr, int pitch, float vel);
+void voice_renderer_note_off(VoiceRenderer *vr, int pitch);
+/* Release every held voice, whatever its pitch */
+void voice_renderer_all_off(VoiceRenderer *vr);
+/* New tempo from the current position on; earlier events keep their
+   sample positions. */
+void voice_renderer_set_tempo(VoiceRenderer *vr, float bpm);
+/* Program for subsequent note-ons (NULL: back to the renderer's own).
+   Sounding voices keep theirs, so pp must outlive them. */
+void voice_renderer_set_program(VoiceRenderer *vr, const PreparedProgram *pp);
+
 /* Render one block of n_samples into out[].
-   Mixes patch audio with proper note-on/off scheduling.
+   Mixes patch audio with proper note-on/off scheduling: the block is
+   split at event boundaries (exact sample offsets, first sample at or
+   after the event's tick) and at multiples of AUDIO_BLOCK, and each span
+   is rendered in one patch_step() call per voice.  Finished voices are
+   reclaimed at those same points, so the output does not depend on
+   n_samples.
    Returns 0 while playing, 1 when done. */
 int voice_render_block(VoiceRenderer *vr, float *out, int n_samples);
 
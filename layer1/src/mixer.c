@@ -0,0 +1,153 @@
+/*
+ * SHMC Layer 1 — Multi-track renderer
+ *
+ * One pool mutex guards the block handshake (gen / pending / quit); each
+ * task queue has its own lock, so owners and thieves only contend on the
+ * queue they touch.  `pending` is set before any task of a block is
+ * queued, so a worker still draining the previous block can safely pick
+ * up new tasks early.
+ */
+#include "../include/mixer.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* ---- Task queues ---- */
+
+/* Owner end: newest task first */
+static int take(MixQueue *q){
+    int t=-1;
+    pthread_mutex_lock(&q->lk);
+    if(q->tail>q->head) t=q->task[--q->tail];
+    pthread_mutex_unlock(&q->lk);
+    return t;
+}
+/* Thief end: oldest task first */
+static int steal(MixQueue *q){
+    int t=-1;
+    pthread_mutex_lock(&q->lk);
+    if(q->tail>q->head) t=q->task[q->head++];
+    pthread_mutex_unlock(&q->lk);
+    return t;
+}
+
+static int next_task(Mixer *m, int self){
+    int t=take(&m->q[self]);
+    for(int i=1;t<0&&i<m->n_threads;i++) t=steal(&m->q[(self+i)%m->n_threads]);
+    return t;
+}
+
+static void run_tasks(Mixer *m, int self){
+    int t;
+    while((t=next_task(m,self))>=0){
+        voice_render_block(m->track[t],m->buf+(size_t)t*MIX_BLOCK,m->n);
+        pthread_mutex_lock(&m->lk);
+        if(--m->pending==0) pthread_cond_signal(&m->idle);
+        pthread_mutex_unlock(&m->lk);
+    }
+}
+
+static void *worker(void *arg){
+    MixWorker *w=(MixWorker*)arg; Mixer *m=w->m;
+    unsigned seen=0;
+    pthread_mutex_lock(&m->lk);
+    for(;;){
+        while(m->gen==seen&&!m->quit) pthread_cond_wait(&m->go,&m->lk);
+        if(m->quit) break;
+        seen=m->gen;
+        pthread_mutex_unlock(&m->lk);
+        run_tasks(m,w->id);
+        pthread_mutex_lock(&m->lk);
+    }
+    pthread_mutex_unlock(&m->lk);
+    return NULL;
+}
+
+/* ---- Public API ---- */
+
+int mixer_init(Mixer *m, int n_threads){
+    if(n_threads<1) n_threads=1;
+    if(n_threads>MIX_MAX_THREADS) n_threads=MIX_MAX_THREADS;
+    memset(m,0,sizeof(*m));
+    m->buf=(float*)calloc((size_t)MIX_MAX_TRACKS*MIX_BLOCK,sizeof(float));
+    if(!m->buf) return -1;
+    pthread_mutex_init(&m->lk,NULL);
+    pthread_cond_init(&m->go,NULL);
+    pthread_cond_init(&m->idle,NULL);
+    for(int i=0;i<n_threads;i++){
+        pthread_mutex_init(&m->q[i].lk,NULL);
+        m->w[i].m=m; m->w[i].id=i;
+    }
+    m->n_threads=n_threads;
+    for(int i=1;i<n_threads;i++)
+        if(pthread_create(&m->thr[i],NULL,worker,&m->w[i])!=0){
+            m->n_threads=i; mixer_free(m); return -1;
+        }
+    return 0;
+}
+
+int mixer_add_track(Mixer *m, VoiceRenderer *vr, float gain){
+    if(m->n_tracks>=MIX_MAX_TRACKS) return -1;
+    m->track[m->n_tracks]=vr;
+    m->gain[m->n_tracks]=gain;
+    return m->n_tracks++;
+}
+
+/* One chunk of n <= MIX_BLOCK samples */
+static int render_chunk(Mixer *m, float *out, int n){
+    int n_live=0;
+    for(int t=0;t<m->n_tracks;t++) n_live+=m->live[t]=!m->track[t]->done;
+    memset(out,0,(size_t)n*sizeof(float));
+    if(!n_live) return 1;
+
+    m->n=n;
+    pthread_mutex_lock(&m->lk);
+    m->pending=n_live;
+    pthread_mutex_unlock(&m->lk);
+    for(int t=0,k=0;t<m->n_tracks;t++) if(m->live[t]){
+        MixQueue *q=&m->q[k++%m->n_threads];
+        pthread_mutex_lock(&q->lk);
+        q->task[q->tail++]=t;
+        pthread_mutex_unlock(&q->lk);
+    }
+    pthread_mutex_lock(&m->lk);
+    m->gen++;
+    pthread_cond_broadcast(&m->go);
+    pthread_mutex_unlock(&m->lk);
+
+    run_tasks(m,0);
+    pthread_mutex_lock(&m->lk);
+    while(m->pending>0) pthread_cond_wait(&m->idle,&m->lk);
+    pthread_mutex_unlock(&m->lk);
+    for(int i=0;i<m->n_threads;i++){        /* drained: rewind */
+        pthread_mutex_lock(&m->q[i].lk);
+        m->q[i].head=m->q[i].tail=0;
+        pthread_mutex_unlock(&m->q[i].lk);
+    }
+
+    /* Master bus: fixed track order, independent of who rendered what */
+    for(int t=0;t<m->n_tracks;t++) if(m->live[t]){
+        const float *b=m->buf+(size_t)t*MIX_BLOCK; float g=m->gain[t];
+        for(int k=0;k<n;k++) out[k]+=g*b[k];
+    }
+    for(int t=0;t<m->n_tracks;t++) if(!m->track[t]->done) return 0;
+    return 1;
+}
+
+int mixer_render_block(Mixer *m, float *out, int n){
+    int done=1;
+    for(int i=0;i<n;i+=MIX_BLOCK){
+        int c=n-i<MIX_BLOCK?n-i:MIX_BLOCK;
+        done=render_chunk(m,out+i,c);
+    }
+    return done;
+}
+
+void mixer_free(Mixer *m){
+    pthread_mutex_lock(&m->lk);
+    m->quit=1;
+    pthread_cond_broadcast(&m->go);
+    pthread_mutex_unlock(&m->lk);
+    for(int i=1;i<m->n_threads;i++) pthread_join(m->thr[i],NULL);
+    m->n_threads=1;
+    free(m->buf); m->buf=NULL;
+}
@@ -0,0 +1,107 @@
+/*
+ * SHMC Layer 1 — Real-time audio callback driver
+ *
+ * The ring publishes with release stores and reads the other end's index
+ * with acquire loads: the producer's writes to a slot happen-before the
+ * consumer sees the new tail, and the consumer is done with a slot
+ * before the producer sees the new head.  Counters are relaxed — they
+ * are statistics, not synchronization.
+ */
+#include "../include/rt_driver.h"
+#include <string.h>
+
+#define RT_MASK (RT_QUEUE_SIZE-1)
+_Static_assert((RT_QUEUE_SIZE&RT_MASK)==0, "RT_QUEUE_SIZE must be a power of two");
+
+#define LD(x)    atomic_load_explicit(&(x),memory_order_relaxed)
+#define ST(x,v)  atomic_store_explicit(&(x),(v),memory_order_relaxed)
+
+/* ---- Command ring ---- */
+
+int rt_queue_push(RtQueue *q, const RtCmd *cmd){
+    uint32_t t=LD(q->tail);
+    if(t-atomic_load_explicit(&q->head,memory_order_acquire)==RT_QUEUE_SIZE) return -1;
+    q->buf[t&RT_MASK]=*cmd;
+    atomic_store_explicit(&q->tail,t+1,memory_order_release);
+    return 0;
+}
+
+int rt_queue_pop(RtQueue *q, RtCmd *cmd){
+    uint32_t h=LD(q->head);
+    if(h==atomic_load_explicit(&q->tail,memory_order_acquire)) return 0;
+    *cmd=q->buf[h&RT_MASK];
+    atomic_store_explicit(&q->head,h+1,memory_order_release);
+    return 1;
+}
+
+/* ---- Control thread ---- */
+
+void rt_driver_init(RtDriver *d, const PatchProgram *patch, const EventStream *es,
+                    float sr, float bpm, int polyphony, RtClock clock){
+    memset(d,0,sizeof(*d));
+    voice_renderer_init(&d->vr,es,patch,bpm,sr);
+    voice_renderer_set_polyphony(&d->vr,polyphony,STEAL_OLDEST);
+    d->clock=clock;
+}
+
+static int post(RtDriver *d, RtCmd c){
+    if(rt_queue_push(&d->q,&c)==0) return 0;
+    atomic_fetch_add_explicit(&d->dropped,1,memory_order_relaxed);
+    return -1;
+}
+
+int rt_note_on(RtDriver *d, int pitch, float vel){
+    return post(d,(RtCmd){ .type=RT_CMD_NOTE_ON, .pitch=(uint8_t)pitch, .value=vel });
+}
+int rt_note_off(RtDriver *d, int pitch){
+    return post(d,(RtCmd){ .type=RT_CMD_NOTE_OFF, .pitch=(uint8_t)pitch });
+}
+int rt_all_off(RtDriver *d){ return post(d,(RtCmd){ .type=RT_CMD_ALL_OFF }); }
+int rt_set_patch(RtDriver *d, const PreparedProgram *pp){
+    return post(d,(RtCmd){ .type=RT_CMD_PATCH, .prep=pp });
+}
+int rt_set_tempo(RtDriver *d, float bpm){
+    return post(d,(RtCmd){ .type=RT_CMD_TEMPO, .value=bpm });
+}
+
+/* ---- Audio thread ---- */
+
+static void apply(VoiceRenderer *vr, const RtCmd *c){
+    switch(c->type){
+    case RT_CMD_NOTE_ON:  voice_renderer_note_on(vr,c->pitch,c->value); break;
+    case RT_CMD_NOTE_OFF: voice_renderer_note_off(vr,c->pitch); break;
+    case RT_CMD_PATCH:    voice_renderer_set_program(vr,c->prep); break;
+    case RT_CMD_TEMPO:    if(c->value>0.f) voice_renderer_set_tempo(vr,c->value); break;
+    case RT_CMD_ALL_OFF:  voice_renderer_all_off(vr); break;
+    default: break;
+    }
+}
+
+void rt_driver_process(RtDriver *d, float *out, int frames){
+    uint64_t t0=d->clock?d->clock():0, n_cmd=0;
+    for(int i=0;i<frames;i+=AUDIO_BLOCK){
+        int c=frames-i<AUDIO_BLOCK?frames-i:AUDIO_BLOCK;
+        RtCmd cmd;
+        while(rt_queue_pop(&d->q,&cmd)){ apply(&d->vr,&cmd); n_cmd++; }
+        if(d->vr.done) memset(out+i,0,(size_t)c*sizeof(float));
+        else voice_render_block(&d->vr,out+i,c);
+    }
+    if(n_cmd) ST(d->commands,LD(d->commands)+n_cmd);
+    ST(d->callbacks,LD(d->callbacks)+1);
+    if(!d->clock) return;
+
+    uint64_t ns=d->clock()-t0;
+    ST(d->last_ns,ns);
+    if(ns>LD(d->worst_ns)) ST(d->worst_ns,ns);
+    if((double)ns*(double)d->vr.sr > (double)frames*1e9) ST(d->misses,LD(d->misses)+1);
+}
+
+void rt_driver_stats(const RtDriver *d, RtStats *st){
+    RtDriver *m=(RtDriver*)d;          /* atomic loads on a const object */
+    st->callbacks=LD(m->callbacks);
+    st->misses   =LD(m->misses);
+    st->worst_ns =LD(m->worst_ns);
+    st->last_ns  =LD(m->last_ns);
+    st->commands =LD(m->commands);
+    st->dropped  =LD(m->dropped);
+}
@@ -9,117 +9,182 @@ const float VEL_TABLE[8] = {
     0.625f, 0.750f, 0.875f, 1.000f
 };
 
+/* ---- Duration table in ticks: 1/64 .. 1 beat ---- */
+const uint32_t DUR_TICKS[7] = {
+    VOICE_PPQ/64, VOICE_PPQ/32, VOICE_PPQ/16, VOICE_PPQ/8,
+    VOICE_PPQ/4,  VOICE_PPQ/2,  VOICE_PPQ
+};
+_Static_assert(VOICE_PPQ%64==0, "VOICE_PPQ must divide into 1/64 beats");
+
+/* 60000 ms/min over VOICE_PPQ, reduced: samples per tick is
+   TL_NUM*sr / (TL_DEN*mbpm) */
+#define TL_NUM 125
+#define TL_DEN 2
+
+static int64_t to_mbpm(float bpm){
+    int64_t m = llround((double)bpm*1000.0);
+    return m<1 ? 1 : m;
+}
+_Static_assert(60000*TL_DEN==TL_NUM*VOICE_PPQ, "TL_NUM/TL_DEN out of step with VOICE_PPQ");
+
 /* ---- Emit an event (sorted insert is not needed: we build in order) ---- */
-static int ev_push(EventStream *es, float beat, EvType type,
+static int ev_push(EventStream *es, uint32_t tick, EvType type,
                    uint8_t pitch, float vel){
     if(es->n >= VOICE_MAX_EVENTS) return -1;
     Event *e = &es->events[es->n++];
-    e->beat     = beat;
+    e->tick     = tick;
     e->type     = type;
     e->pitch    = pitch;
     e->velocity = vel;
     return 0;
 }
 
+/* ---- Loading ---- */
+
+int voice_validate(const VInstr *code, int n){
+    int depth=0;
+    if(n<0||n>VOICE_MAX_INSTRS) return PF_E_OPERAND;
+    for(int i=0;i<n;i++){
+        uint8_t op=VI_OP(code[i]);
+        if(op>=VI_COUNT) return PF_E_OPCODE;
+        if((op==VI_NOTE||op==VI_GLIDE)&&VI_PITCH(code[i])>127) return PF_E_OPERAND;
+        if(op==VI_REPEAT_BEGIN&&++depth>VOICE_MAX_REPEAT) return PF_E_OPERAND;
+        if(op==VI_REPEAT_END&&--depth<0) return PF_E_OPERAND;
+    }
+    return depth ? PF_E_OPERAND : PF_OK;
+}
+
+int voice_load(const PatchFile *f, int i, VoiceProgram *vp){
+    int n, r;
+    const uint32_t *code=pf_voice_code(f,i,&n,&r);
+    if(!code) return r;
+    if((r=voice_validate(code,n))) return r;
+    memcpy(vp->code,code,(size_t)n*sizeof(VInstr));
+    vp->n=n;
+    return PF_OK;
+}
+
 /* ============================================================
-   voice_compile
-   Walks the VoiceProgram, expanding REPEAT blocks inline.
-   Produces a flat event list in chronological order.
+   VoiceCursor
+   Interprets the VoiceProgram one instruction at a time.  Positions are
+   integer ticks, so a note's time does not depend on how many
+   durations were summed to reach it.
    ============================================================ */
 
-/* Recursive helper that processes instrs[lo..hi) and advances *beat */
-static int compile_range(const VInstr *code, int lo, int hi,
-                          EventStream *es, float *beat){
-    extern const float g_dur[7];
-    int i = lo;
-    while(i < hi){
-        VInstr vi = code[i];
+int voice_cursor_init(VoiceCursor *c, const VoiceProgram *vp){
+    int16_t open[VOICE_MAX_INSTRS]; int sp=0;
+    memset(c,0,sizeof(*c));
+    c->vp = vp;
+    for(int i=0;i<vp->n;i++){
+        c->jump[i] = -1;
+        uint8_t op = VI_OP(vp->code[i]);
+        if(op==VI_REPEAT_BEGIN){
+            if(sp>=VOICE_MAX_REPEAT) return -1;
+            open[sp++] = (int16_t)i;
+        }
+        else if(op==VI_REPEAT_END && sp>0) c->jump[open[--sp]] = (int16_t)i;
+    }
+    return 0;   /* BEGINs left open stay -1; stray ENDs are skipped */
+}
+
+static void q_push(VoiceCursor *c, Event e){ c->q[(c->q_head+c->q_n++)&1] = e; }
+static void flush_off(VoiceCursor *c){
+    if(c->has_off){ q_push(c,c->off); c->has_off=0; }
+}
+
+/* Run instructions until at least one event is queued or the program ends */
+static void cursor_fill(VoiceCursor *c){
+    const VInstr *code = c->vp->code;
+    while(c->q_n==0 && !c->err){
+        if(c->pc >= c->vp->n){ flush_off(c); return; }
+        VInstr vi = code[c->pc];
         uint8_t op    = VI_OP(vi);
         uint8_t pitch = VI_PITCH(vi);
         uint8_t di    = VI_DUR(vi);
         uint8_t veli  = VI_VEL(vi);
 
-        float dur_beats = (di < 7) ? g_dur[di] : g_dur[4]; /* default 1/4 */
+        uint32_t dur    = (di < 7) ? DUR_TICKS[di] : DUR_TICKS[4]; /* default 1/4 */
         float vel       = (veli < 8) ? VEL_TABLE[veli] : 0.75f;
 
         switch(op){
         case VI_NOTE:
-            if(ev_push(es,*beat,EV_NOTE_ON, pitch,vel)<0) return -1;
-            if(ev_push(es,*beat+dur_beats,EV_NOTE_OFF,pitch,vel)<0) return -1;
-            *beat += dur_beats;
+        case VI_GLIDE:
+            /* Glide: note-on at new pitch immediately (no note-off between) */
+            flush_off(c);
+            q_push(c,(Event){ c->tick, EV_NOTE_ON, pitch, vel });
+            c->off = (Event){ c->tick+dur, EV_NOTE_OFF, pitch, vel };
+            c->has_off = 1;
+            c->tick += dur;
             break;
 
         case VI_REST:
-            *beat += dur_beats;
+            c->tick += dur;
             break;
 
         case VI_TIE:
-            /* Extend last NOTE_OFF by dur_beats */
-            for(int k=es->n-1;k>=0;k--){
-                if(es->events[k].type==EV_NOTE_OFF){
-                    es->events[k].beat += dur_beats;
-                    break;
-                }
-            }
-            *beat += dur_beats;
+            /* Extend the held note-off by dur */
+            if(c->has_off) c->off.tick += dur;
+            c->tick += dur;
             break;
 
-        case VI_GLIDE:
-            /* Glide: note-on at new pitch immediately (no note-off between) */
-            if(ev_push(es,*beat,EV_NOTE_ON, pitch,vel)<0) return -1;
-            if(ev_push(es,*beat+dur_beats,EV_NOTE_OFF,pitch,vel)<0) return -1;
-            *beat += dur_beats;
-            break;
-
-        case VI_REPEAT_BEGIN:
-            /* Find matching REPEAT_END, track nesting */
-            {
-                int begin_i = i;
-                int depth   = 1;
-                int end_i   = -1;
-                for(int j=i+1;j<hi;j++){
-                    uint8_t jop = VI_OP(code[j]);
-                    if(jop==VI_REPEAT_BEGIN) depth++;
-                    else if(jop==VI_REPEAT_END){
-                        depth--;
-                        if(depth==0){ end_i=j; break; }
-                    }
-                }
-                if(end_i<0) return -1; /* unmatched */
-                int count = (int)VI_VEL(code[end_i]);
-                if(count<1) count=1;
-                for(int r=0;r<count;r++){
-                    if(compile_range(code, begin_i+1, end_i, es, beat)<0)
-                        return -1;
-                }
-                i = end_i; /* skip to end, outer loop does i++ */
-            }
+        case VI_REPEAT_BEGIN: {
+            int end = c->jump[c->pc];
+            if(end<0){ flush_off(c); c->err=-1; return; }   /* unmatched */
+            int count = (int)VI_VEL(code[end]);
+            c->loop[c->depth].begin = (int16_t)c->pc;
+            c->loop[c->depth].left  = (int16_t)(count<1 ? 1 : count);
+            c->depth++;
             break;
+        }
 
         case VI_REPEAT_END:
-            /* Only reached when not inside a BEGIN scan — skip */
+            /* Closes the innermost loop, unless it is a stray END */
+            if(c->depth>0 && c->jump[c->loop[c->depth-1].begin]==c->pc){
+                if(--c->loop[c->depth-1].left > 0){
+                    c->pc = c->loop[c->depth-1].begin;   /* ++ below: body start */
+                } else c->depth--;
+            }
             break;
 
         default:
             break;
         }
-        i++;
+        c->pc++;
     }
-    return 0;
 }
 
+const Event *voice_cursor_peek(VoiceCursor *c){
+    cursor_fill(c);
+    return c->q_n ? &c->q[c->q_head] : NULL;
+}
+
+int voice_cursor_next(VoiceCursor *c, Event *ev){
+    cursor_fill(c);
+    if(!c->q_n) return c->err;
+    if(ev) *ev = c->q[c->q_head];
+    c->q_head ^= 1; c->q_n--;
+    return 1;
+}
+
+/* ============================================================
+   voice_compile
+   Drains a VoiceCursor into a flat event list in chronological order.
+   ============================================================ */
+
 int voice_compile(const VoiceProgram *vp, EventStream *es){
+    VoiceCursor c; Event ev={0}; int r;
     memset(es,0,sizeof(*es));
-    float beat=0.0f;
-    int r = compile_range(vp->code, 0, vp->n, es, &beat);
-    es->total_beats = beat;
+    if(voice_cursor_init(&c,vp)<0) return -1;
+    while((r=voice_cursor_next(&c,&ev))>0)
+        if(ev_push(es,ev.tick,ev.type,ev.pitch,ev.velocity)<0){ r=-1; break; }
+    es->total_ticks = c.tick;
     return r;
 }
 
 /* ============================================================
    VoiceRenderer
-   Converts the event stream to audio by driving a Patch engine.
-   Handles note-on/off scheduling within each audio block.
+   Converts the event stream to audio by driving a pool of Patch
+   voices.  Handles note-on/off scheduling within each audio block.
    ============================================================ */
 
 void voice_renderer_init(VoiceRenderer *vr,
@@ -129,80 +194,204 @@ void voice_renderer_init(VoiceRenderer *vr,
     memset(vr,0,sizeof(*vr));
     vr->es          = es;
     vr->patch_prog  = patch;
+    patch_prepare(&vr->prep, patch, sr);
+    vr->cur         = &vr->prep;
     vr->bpm         = bpm;
     vr->sr          = sr;
-    vr->beat_time   = 0.0f;
-    vr->sample_time = 0.0f;
+    vr->mbpm        = to_mbpm(bpm);
+    vr->sr_i        = llround((double)sr);
+    vr->sample_pos  = 0;
     vr->ev_cursor   = 0;
-    vr->has_active  = 0;
+    vr->polyphony   = 1;
+    vr->steal       = STEAL_OLDEST;
+    for(int i=0;i<VOICE_MAX_POLY;i++) vr->free_list[i]=VOICE_MAX_POLY-1-i;
+    vr->n_free      = VOICE_MAX_POLY;
     vr->done        = 0;
 }
 
+void voice_renderer_init_stream(VoiceRenderer *vr, VoiceCursor *src,
+                                const PatchProgram *patch,
+                                float bpm, float sr){
+    voice_renderer_init(vr,NULL,patch,bpm,sr);
+    vr->src = src;
+}
+
+void voice_renderer_set_polyphony(VoiceRenderer *vr, int polyphony,
+                                  StealPolicy steal){
+    if(polyphony<1) polyphony=1;
+    if(polyphony>VOICE_MAX_POLY) polyphony=VOICE_MAX_POLY;
+    vr->polyphony = polyphony;
+    vr->steal     = steal;
+}
+
+int voice_renderer_active(const VoiceRenderer *vr){ return vr->n_active; }
+
+void voice_renderer_set_tempo(VoiceRenderer *vr, float bpm){
+    vr->tick_origin  += (vr->sample_pos-vr->sample_origin)*TL_DEN*vr->mbpm;
+    vr->sample_origin = vr->sample_pos;
+    vr->bpm           = bpm;
+    vr->mbpm          = to_mbpm(bpm);
+}
+
+void voice_renderer_set_program(VoiceRenderer *vr, const PreparedProgram *pp){
+    vr->cur = pp ? pp : &vr->prep;
+}
+
+/* ---- Pool management ---- */
+
+/* Position in active[] of the voice to steal */
+static int steal_pos(const VoiceRenderer *vr){
+    int best=0;
+    for(int i=1;i<vr->n_active;i++){
+        const VoiceSlot *a=&vr->voices[vr->active[i]];
+        const VoiceSlot *b=&vr->voices[vr->active[best]];
+        if(vr->steal==STEAL_QUIETEST ? a->level<b->level : a->age<b->age) best=i;
+    }
+    return best;
+}
+
+/* Return active[pos] to the free list.  The rest keep their order
+   (note-on order), which is the order they are summed in. */
+static void voice_free(VoiceRenderer *vr, int pos){
+    vr->free_list[vr->n_free++] = vr->active[pos];
+    memmove(&vr->active[pos],&vr->active[pos+1],(size_t)(--vr->n_active-pos)*sizeof(int));
+}
+
+static void voice_note_on(VoiceRenderer *vr, uint8_t pitch, float vel){
+    int slot=-1;
+    if(vr->steal==STEAL_SAME_PITCH)
+        for(int i=0;i<vr->n_active&&slot<0;i++)
+            if(vr->voices[vr->active[i]].pitch==pitch) slot=vr->active[i];
+    if(slot<0){
+        if(vr->n_active>=vr->polyphony) slot=vr->active[steal_pos(vr)];
+        else { slot=vr->free_list[--vr->n_free]; vr->active[vr->n_active++]=slot; }
+    }
+    VoiceSlot *v=&vr->voices[slot];
+    patch_note_on_prepared(&v->patch, vr->cur, (int)pitch, vel);
+    v->pitch    = pitch;
+    v->released = 0;
+    v->age      = vr->serial++;
+    v->level    = vel;
+}
+
+static void voice_release(VoiceSlot *v){
+    patch_note_off(&v->patch);
+    v->released = 1;
+}
+
+/* Note-off releases the oldest held voice on that pitch */
+static void voice_note_off(VoiceRenderer *vr, uint8_t pitch){
+    VoiceSlot *hit=NULL;
+    for(int i=0;i<vr->n_active;i++){
+        VoiceSlot *v=&vr->voices[vr->active[i]];
+        if(!v->released && v->pitch==pitch && (!hit||v->age<hit->age)) hit=v;
+    }
+    if(hit) voice_release(hit);
+}
+
+void voice_renderer_note_on(VoiceRenderer *vr, int pitch, float vel){
+    voice_note_on(vr,(uint8_t)pitch,vel);
+    vr->done=0;                         /* live input outlives the sequence */
+}
+void voice_renderer_note_off(VoiceRenderer *vr, int pitch){
+    voice_note_off(vr,(uint8_t)pitch);
+}
+void voice_renderer_all_off(VoiceRenderer *vr){
+    for(int i=0;i<vr->n_active;i++){
+        VoiceSlot *v=&vr->voices[vr->active[i]];
+        if(!v->released) voice_release(v);
+    }
+}
+
+/* A released voice is finished once every envelope has reached stage 4;
+   patches without an ADSR finish when a whole AUDIO_BLOCK (ending at
+   a boundary) was silent. */
+static int voice_finished(const VoiceSlot *v, int boundary){
+    if(!v->released) return 0;
+    int d=patch_done(&v->patch);
+    return d<0 ? boundary && v->level<1e-5f : d;
+}
+
+static void reclaim(VoiceRenderer *vr, int boundary){
+    for(int i=vr->n_active-1;i>=0;i--)
+        if(voice_finished(&vr->voices[vr->active[i]],boundary)) voice_free(vr,i);
+}
+
+/* Sample index at which an event fires: the first sample at or after
+   its tick, measured from the current tempo segment.  One tick is
+   60000/(mbpm*VOICE_PPQ) s = TL_NUM*sr/(TL_DEN*mbpm) samples, so the
+   position is exact in int64: tick*TL_NUM*sr stays below 2^57 for
+   every uint32 tick at 192 kHz, and a tempo segment's samples*TL_DEN*mbpm
+   below 2^63 for ~29000 hours at 1000 bpm. */
+static int64_t ceil_div(int64_t a, int64_t b){
+    return a>=0 ? (a+b-1)/b : -(-a/b);
+}
+static int64_t event_sample(const VoiceRenderer *vr, const Event *ev){
+    int64_t num = (int64_t)ev->tick*TL_NUM*vr->sr_i - vr->tick_origin;
+    return vr->sample_origin + ceil_div(num, TL_DEN*vr->mbpm);
+}
+
+/* Next pending event from the cursor or the stream; NULL if none */
+static const Event *ev_peek(VoiceRenderer *vr){
+    if(vr->src) return voice_cursor_peek(vr->src);
+    return vr->es && vr->ev_cursor < vr->es->n ? &vr->es->events[vr->ev_cursor] : NULL;
+}
+static void ev_take(VoiceRenderer *vr){
+    if(vr->src) voice_cursor_next(vr->src,NULL);
+    else        vr->ev_cursor++;
+}
+
 /*
  * Render n_samples into out[].
  * Returns 0 while still playing, 1 when all events are done
- * and the last note has released.
+ * and every voice has released.
  */
 int voice_render_block(VoiceRenderer *vr, float *out, int n_samples){
     if(vr->done){ memset(out,0,n_samples*sizeof(float)); return 1; }
 
-    float secs_per_beat = 60.0f / vr->bpm;
-    float dt            = 1.0f  / vr->sr;
-
     memset(out,0,n_samples*sizeof(float));
 
-    for(int s=0;s<n_samples;s++){
-        float cur_beat = vr->beat_time;
-
-        /* Process all events at or before cur_beat */
-        while(vr->ev_cursor < vr->es->n){
-            const Event *ev = &vr->es->events[vr->ev_cursor];
-            if(ev->beat > cur_beat) break;
-
-            if(ev->type == EV_NOTE_ON){
-                patch_note_on(&vr->active, vr->patch_prog,
-                              vr->sr, (int)ev->pitch, ev->velocity);
-                vr->has_active = 1;
-            } else { /* EV_NOTE_OFF */
-                /* Trigger release stage in ADSR by setting stage=3 in state.
-                   Each ADSR instruction owns state slots at (instr_idx*4).
-                   We scan the program for OP_ADSR and set state[sb+0]=3. */
-                if(vr->has_active){
-                    const PatchProgram *pp = vr->patch_prog;
-                    for(int k=0;k<pp->n_instrs;k++){
-                        if(((pp->code[k]>>56)&0xFF)==0x1C){ /* OP_ADSR=28=0x1C */
-                            int sb=(k*4)%MAX_STATE;
-                            vr->active.st.state[sb+0]=3.0f; /* release */
-                            vr->active.st.state[sb+2]=0.0f; /* reset timer */
-                        }
-                    }
-                }
-            }
-            vr->ev_cursor++;
-        }
+    int s=0;
+    const Event *ev;
+    while(s<n_samples){
+        int at=(int)(vr->sample_pos%AUDIO_BLOCK);
+        if(at==0) for(int i=0;i<vr->n_active;i++) vr->voices[vr->active[i]].level=0.0f;
 
-        /* Synthesize one sample from active patch */
-        float samp=0.0f;
-        if(vr->has_active){
-            patch_step(&vr->active,&samp,1);
+        /* Process all events due at the current sample */
+        while((ev=ev_peek(vr)) && event_sample(vr,ev) <= vr->sample_pos){
+            if(ev->type == EV_NOTE_ON) voice_note_on(vr, ev->pitch, ev->velocity);
+            else                       voice_note_off(vr, ev->pitch);
+            ev_take(vr);
         }
-        out[s] = samp;
 
-        /* Advance time */
-        vr->sample_time += dt;
-        vr->beat_time    = vr->sample_time / secs_per_beat;
-    }
+        /* Span up to the next event, AUDIO_BLOCK boundary or call end */
+        int span = n_samples-s;
+        if(span > AUDIO_BLOCK-at) span = AUDIO_BLOCK-at;
+        if(ev){
+            int64_t due = event_sample(vr,ev) - vr->sample_pos;
+            if(due < span) span = (int)due;
+        }
 
-    /* Check done: all events processed and last note is silent */
-    if(vr->ev_cursor >= vr->es->n){
-        int all_silent = !vr->has_active;
-        if(vr->has_active){
-            /* Check if patch output is near-zero (tail ended) */
-            float probe=0.0f;
-            patch_step(&vr->active,&probe,1);
-            if(fabsf(probe)<1e-5f) all_silent=1;
+        /* Synthesize the span from every active voice */
+        float buf[AUDIO_BLOCK];
+        for(int i=0;i<vr->n_active;i++){
+            VoiceSlot *v=&vr->voices[vr->active[i]];
+            if(patch_step(&v->patch,buf,span)<0) continue;
+            for(int k=0;k<span;k++){
+                if(fabsf(buf[k])>v->level) v->level=fabsf(buf[k]);
+                out[s+k] += buf[k];
+            }
         }
-        if(all_silent){ vr->done=1; return 1; }
+        s += span;
+        vr->sample_pos += span;
+
+        /* Reclaim finished voices at every AUDIO_BLOCK boundary and
+           event: the same samples whatever the caller's block size */
+        int boundary = vr->sample_pos%AUDIO_BLOCK==0;
+        if(boundary || (ev && event_sample(vr,ev)<=vr->sample_pos)) reclaim(vr,boundary);
     }
+
+    /* Done: all events processed and every voice reclaimed */
+    if((vr->es||vr->src) && !ev_peek(vr) && vr->n_active==0){ vr->done=1; return 1; }
     return 0;
 }
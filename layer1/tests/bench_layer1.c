@@ -0,0 +1,89 @@
+/*
+ * SHMC Layer 1 — Multi-track scaling benchmark
+ * Build: make -f layer1/Makefile bench
+ *
+ * Offline render of a large arrangement (TRACKS tracks, 4-voice
+ * polyphony, cycling through four patches) on 1..N threads, where N is
+ * max(4, online cores).  Reports wall time, real-time factor and speedup
+ * over one thread, and checks every run is bit-identical to the first.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "mixer.h"
+#include "../../layer0/include/patch_builder.h"
+
+#define SR 44100
+#ifndef TRACKS
+#define TRACKS 64
+#endif
+#ifndef SECONDS
+#define SECONDS 8
+#endif
+
+static double now_s(void){
+    struct timespec t; clock_gettime(CLOCK_MONOTONIC,&t);
+    return (double)t.tv_sec+(double)t.tv_nsec*1e-9;
+}
+
+static PatchProgram mk_patch(int k){
+    PatchBuilder b; pb_init(&b);
+    int o, e;
+    switch(k&3){
+    case 0:  o=pb_lpf(&b,pb_saw(&b,REG_ONE),28); e=pb_adsr(&b,0,8,20,8); break;
+    case 1:  o=pb_fm(&b,REG_ONE,pb_osc(&b,pb_const_f(&b,2.0f)),15); e=pb_adsr(&b,0,14,8,10); break;
+    case 2:  o=pb_tanh(&b,pb_mul(&b,pb_tri(&b,REG_ONE),pb_const_f(&b,3.0f))); e=pb_adsr(&b,1,10,22,12); break;
+    default: o=pb_lpf(&b,pb_mix(&b,pb_osc(&b,REG_ONE),pb_osc(&b,pb_const_f(&b,1.008f)),15,15),42);
+             e=pb_adsr(&b,14,4,28,20); break;
+    }
+    pb_out(&b,pb_mul(&b,o,e));
+    return *pb_finish(&b);
+}
+
+static EventStream   s_es[TRACKS];
+static PatchProgram  s_pp[TRACKS];
+static VoiceRenderer s_vr[TRACKS];
+static Mixer         s_mix;
+
+/* Seconds of wall time for the whole arrangement on `threads` threads */
+static double run(int threads, float *out, int n){
+    for(int t=0;t<TRACKS;t++){
+        voice_renderer_init(&s_vr[t],&s_es[t],&s_pp[t],120.0f,(float)SR);
+        voice_renderer_set_polyphony(&s_vr[t],4,STEAL_OLDEST);
+    }
+    mixer_init(&s_mix,threads);
+    for(int t=0;t<TRACKS;t++) mixer_add_track(&s_mix,&s_vr[t],1.0f/TRACKS);
+    double t0=now_s();
+    mixer_render_block(&s_mix,out,n);
+    double dt=now_s()-t0;
+    mixer_free(&s_mix);
+    return dt;
+}
+
+int main(void){
+    /* Chords of overlapping eighths: each track keeps ~2-4 voices busy */
+    for(int t=0;t<TRACKS;t++){
+        VoiceBuilder vb; vb_init(&vb);
+        for(int i=0;i<SECONDS*4;i++) vb_note(&vb,36+(t*7+i*5)%48,DUR_1_8+(i%3==0),VEL_MF);
+        voice_compile(vb_finish(&vb),&s_es[t]);
+        s_pp[t]=mk_patch(t);
+    }
+    int n=SR*SECONDS, cores=(int)sysconf(_SC_NPROCESSORS_ONLN);
+    int maxth=cores>4?cores:4;
+    float *ref=(float*)malloc(n*sizeof(float)), *buf=(float*)malloc(n*sizeof(float));
+
+    printf("=== SHMC Layer 1  —  multi-track scaling (%d tracks, %d s, %d cores) ===\n\n",
+           TRACKS,SECONDS,cores);
+    printf("%8s %10s %10s %9s %10s\n","threads","wall s","x realtime","speedup","identical");
+    double t1=run(1,ref,n);
+    printf("%8d %10.3f %10.1f %8.2fx %10s\n",1,t1,SECONDS/t1,1.0,"ref");
+    for(int th=2;th<=maxth;th++){
+        double tt=run(th,buf,n);
+        printf("%8d %10.3f %10.1f %8.2fx %10s\n",th,tt,SECONDS/tt,t1/tt,
+               memcmp(ref,buf,n*sizeof(float))?"NO":"yes");
+    }
+    free(ref); free(buf);
+    return 0;
+}
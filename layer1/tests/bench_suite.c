@@ -0,0 +1,362 @@
+/*
+ * SHMC Layer 1 — Benchmark suite with a regression gate
+ * Build: make -f layer1/Makefile bench_suite
+ *
+ *   ./bench_suite                      metrics on stdout
+ *   ./bench_suite --json FILE          ... and as JSON
+ *   ./bench_suite --compare BASE.json [--threshold PCT]
+ *                                      exit 1 if any metric is more than
+ *                                      PCT % (default 15) worse than BASE,
+ *                                      or missing from this run
+ *   --rounds N                         suite passes (default 3)
+ *
+ * op.*:      every opcode in isolation, one voice through patch_step().
+ *            A base program (OSC input, two CONSTs, OUT) is timed alone and
+ *            with the opcode added; "ns" and "voices" are the whole mini
+ *            patch, "net_ns" the opcode's share (informational: too small
+ *            to gate on).
+ * patch.*:   the reference patches, same measure.
+ * noteon.*:  patch_note_on_prepared() alone, note-on plus the first block,
+ *            and voice_renderer_note_on() into a live renderer.
+ * compile.*: voice_compile() and VoiceCursor throughput, events/s.
+ *
+ * Every figure is the best of REPS runs in each of N rounds: whole-suite
+ * passes, so a burst of load on the machine costs one round, not a
+ * metric.  voices = voices one core can sustain in real time at SR.
+ * JSON layout, one metric per line:
+ *   {"suite":"shmc-bench","version":1,"sr":44100,"metrics":[
+ *   {"name":"op.ADD.ns","value":4.21,"unit":"ns","better":"lower"},
+ *   ...]}
+ * better is "lower", "higher" or "none" (not compared, but must exist).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "voice.h"
+#include "patches.h"
+#include "../../layer0/tests/patches.h"
+
+#define SR     44100
+#define NSAMP  (SR/2)
+#define REPS   5
+#define MAX_METRICS 256
+
+static double now_s(void){
+    struct timespec t; clock_gettime(CLOCK_MONOTONIC,&t);
+    return (double)t.tv_sec+(double)t.tv_nsec*1e-9;
+}
+
+static volatile float g_sink;
+
+/* ---- Metrics ---- */
+
+typedef struct { char name[48]; double value; char unit[12]; char better[8]; } Metric;
+
+static Metric s_m[MAX_METRICS];
+static int    s_n;
+
+/* Record a metric; a later round keeps the better value */
+static void metric(const char *name, double v, const char *unit, const char *better){
+    for(int i=0;i<s_n;i++) if(!strcmp(s_m[i].name,name)){
+        Metric *m=&s_m[i];
+        if(!strcmp(better,"lower")?v<m->value:!strcmp(better,"higher")?v>m->value:0) m->value=v;
+        return;
+    }
+    if(s_n==MAX_METRICS) return;
+    Metric *m=&s_m[s_n++];
+    snprintf(m->name,sizeof m->name,"%s",name);
+    snprintf(m->unit,sizeof m->unit,"%s",unit);
+    snprintf(m->better,sizeof m->better,"%s",better);
+    m->value=v;
+}
+
+static double value(const char *name){
+    for(int i=0;i<s_n;i++) if(!strcmp(s_m[i].name,name)) return s_m[i].value;
+    return 0;
+}
+
+static int write_json(const char *path){
+    FILE *f=fopen(path,"w");
+    if(!f) return -1;
+    fprintf(f,"{\"suite\":\"shmc-bench\",\"version\":1,\"sr\":%d,\"metrics\":[\n",SR);
+    for(int i=0;i<s_n;i++)
+        fprintf(f,"{\"name\":\"%s\",\"value\":%.6g,\"unit\":\"%s\",\"better\":\"%s\"}%s\n",
+                s_m[i].name,s_m[i].value,s_m[i].unit,s_m[i].better,i+1<s_n?",":"");
+    fprintf(f,"]}\n");
+    return fclose(f);
+}
+
+/* Reads what write_json() writes: one metric object per line */
+static int read_json(const char *path, Metric *m, int cap){
+    FILE *f=fopen(path,"r");
+    if(!f) return -1;
+    char line[256]; int n=0, ok=0;
+    while(fgets(line,sizeof line,f)){
+        if(strstr(line,"\"suite\":\"shmc-bench\",\"version\":1")) ok=1;
+        if(n<cap&&sscanf(line,"{\"name\":\"%47[^\"]\",\"value\":%lf,\"unit\":\"%11[^\"]\",\"better\":\"%7[^\"]\"",
+                         m[n].name,&m[n].value,m[n].unit,m[n].better)==4) n++;
+    }
+    fclose(f);
+    return ok?n:-1;
+}
+
+/* Slowdown of cur against base: > 1 is worse, whichever way is better */
+static double slowdown(const Metric *base, double cur){
+    if(!strcmp(base->better,"lower"))  return base->value>0?cur/base->value:1.0;
+    if(!strcmp(base->better,"higher")) return cur>0?base->value/cur:1e9;
+    return 1.0;
+}
+
+static int compare(const char *path, double pct){
+    static Metric base[MAX_METRICS];
+    int nb=read_json(path,base,MAX_METRICS);
+    if(nb<0){ fprintf(stderr,"bench_suite: cannot read baseline %s\n",path); return 2; }
+    int bad=0, seen=0, lost=0;
+    printf("\n--- compare against %s (threshold %.1f%%) ---\n",path,pct);
+    for(int i=0;i<nb;i++){
+        const Metric *cur=NULL;
+        for(int j=0;j<s_n;j++) if(!strcmp(s_m[j].name,base[i].name)){ cur=&s_m[j]; break; }
+        /* A renamed, dropped or failed metric must not pass the gate */
+        if(!cur){ printf("  %-34s MISSING\n",base[i].name); lost++; continue; }
+        if(!strcmp(base[i].better,"none")) continue;
+        double sd=slowdown(&base[i],cur->value);
+        seen++;
+        if(sd>1.0+pct/100.0){
+            printf("  %-34s %12.4g -> %12.4g %-8s  %+.1f%%  REGRESSION\n",base[i].name,
+                   base[i].value,cur->value,cur->unit,(sd-1.0)*100.0);
+            bad++;
+        }
+    }
+    printf("  %d metrics compared, %d regressed, %d missing\n",seen,bad,lost);
+    return bad||lost?1:0;
+}
+
+/* ---- Patch timing ---- */
+
+/* Best-of-REPS ns per sample for one voice of prog */
+static double ns_per_sample(const PatchProgram *prog){
+    static PreparedProgram pp;
+    static Patch p;
+    float blk[AUDIO_BLOCK];
+    double best=1e30;
+    if(patch_prepare(&pp,prog,(float)SR)) return 0;
+    for(int r=0;r<REPS;r++){
+        patch_note_on_prepared(&p,&pp,57,0.8f);
+        double t0=now_s();
+        for(int i=0;i<NSAMP;i+=AUDIO_BLOCK){ patch_step(&p,blk,AUDIO_BLOCK); g_sink+=blk[0]; }
+        double dt=(now_s()-t0)*1e9/NSAMP;
+        if(dt<best) best=dt;
+    }
+    return best;
+}
+
+static double voices(double ns){ return ns>0?1e9/(ns*SR):0; }
+
+static void patch_metrics(const char *name, const PatchProgram *prog){
+    char k[48];
+    double ns=ns_per_sample(prog);
+    snprintf(k,sizeof k,"patch.%s.ns",name);     metric(k,ns,"ns","lower");
+    snprintf(k,sizeof k,"patch.%s.voices",name); metric(k,voices(ns),"voices","higher");
+}
+
+/* ---- Opcodes in isolation ----
+   r4 = OSC(one) is the moving input, r5 = 0.75 and r6 = 2.0 constants;
+   the opcode writes r7 from (a, b[, c]) with the immediates below. */
+#define X 4
+#define Y 5
+#define Q 6
+
+typedef struct { const char *name; uint8_t op, a, b; uint16_t hi, lo; } OpCase;
+
+static const OpCase OPS[]={
+    {"CONST",     OP_CONST,    0,0, 192,1},
+    {"ADD",       OP_ADD,      X,Y, 0,0},
+    {"SUB",       OP_SUB,      X,Y, 0,0},
+    {"MUL",       OP_MUL,      X,Y, 0,0},
+    {"DIV",       OP_DIV,      X,Y, 0,0},
+    {"NEG",       OP_NEG,      X,0, 0,0},
+    {"ABS",       OP_ABS,      X,0, 0,0},
+    {"OSC",       OP_OSC,      Q,0, 0,MATH_REF},
+    {"OSC.poly",  OP_OSC,      Q,0, 0,MATH_POLY},
+    {"SAW",       OP_SAW,      Q,0, 0,OSC_NAIVE},
+    {"SAW.blep",  OP_SAW,      Q,0, 0,OSC_BLEP},
+    {"SQUARE",    OP_SQUARE,   Q,0, 0,OSC_NAIVE},
+    {"SQUARE.blep",OP_SQUARE,  Q,0, 0,OSC_BLEP},
+    {"TRI",       OP_TRI,      Q,0, 0,OSC_NAIVE},
+    {"TRI.blep",  OP_TRI,      Q,0, 0,OSC_BLEP},
+    {"PHASE",     OP_PHASE,    Q,0, 0,0},
+    {"FM",        OP_FM,       Q,X, 15,0},
+    {"PM",        OP_PM,       Q,X, 0,0},
+    {"AM",        OP_AM,       X,Y, 15,0},
+    {"SYNC",      OP_SYNC,     Q,Y, 0,0},
+    {"NOISE",     OP_NOISE,    0,0, 0,0},
+    {"LP_NOISE",  OP_LP_NOISE, 0,0, 30,0},
+    {"RAND_STEP", OP_RAND_STEP,0,0, 100,0},
+    {"TANH",      OP_TANH,     X,0, OS_1X,MATH_REF},
+    {"TANH.poly", OP_TANH,     X,0, OS_1X,MATH_POLY},
+    {"TANH.2x",   OP_TANH,     X,0, OS_2X,MATH_POLY},
+    {"TANH.4x",   OP_TANH,     X,0, OS_4X,MATH_POLY},
+    {"CLIP",      OP_CLIP,     X,0, OS_1X,0},
+    {"FOLD",      OP_FOLD,     X,0, OS_1X,0},
+    {"SIGN",      OP_SIGN,     X,0, 0,0},
+    {"LPF",       OP_LPF,      X,0, 30,0},
+    {"HPF",       OP_HPF,      X,0, 30,0},
+    {"BPF",       OP_BPF,      X,0, 30,20},
+    {"ONEPOLE",   OP_ONEPOLE,  X,0, 0x8000,0},
+    {"SVF",       OP_SVF,      X,REG_FREQ, Q,SVF_LP},
+    {"ADSR",      OP_ADSR,     0,0, (2<<10)|(10<<5)|20,15<<11},
+    {"RAMP",      OP_RAMP,     0,0, 10,0},
+    {"EXP_DECAY", OP_EXP_DECAY,0,0, 18,MATH_REF},
+    {"EXP_DECAY.recur",OP_EXP_DECAY,0,0, 18,MATH_RECUR},
+    {"MIN",       OP_MIN,      X,Y, 0,0},
+    {"MAX",       OP_MAX,      X,Y, 0,0},
+    {"MIXN",      OP_MIXN,     X,Y, 15,15},
+};
+
+static PatchProgram op_prog(const OpCase *c){
+    PatchBuilder b; pb_init(&b);
+    pb_osc(&b,REG_ONE);             /* r4 */
+    pb_const_f(&b,0.75f);           /* r5 */
+    pb_const_f(&b,2.0f);            /* r6 */
+    if(!c){ pb_out(&b,X); return *pb_finish(&b); }
+    int d=pb_reg(&b);
+    pb_emit(&b,INSTR_PACK(c->op,d,c->a,c->b,c->hi,c->lo));
+    pb_out(&b,d);
+    return *pb_finish(&b);
+}
+
+static void bench_ops(void){
+    PatchProgram pr=op_prog(NULL);
+    char k[48];
+    metric("op.base.ns",ns_per_sample(&pr),"ns","lower");
+    for(size_t i=0;i<sizeof OPS/sizeof OPS[0];i++){
+        const OpCase *c=&OPS[i];
+        pr=op_prog(c);
+        double ns=ns_per_sample(&pr);
+        snprintf(k,sizeof k,"op.%s.ns",c->name);     metric(k,ns,"ns","lower");
+        snprintf(k,sizeof k,"op.%s.voices",c->name); metric(k,voices(ns),"voices","higher");
+    }
+}
+
+/* ---- Note-on latency ---- */
+
+#define NOTES 20000
+
+static void bench_note_on(void){
+    static PreparedProgram pp;
+    static Patch p;
+    static VoiceRenderer vr;
+    PatchProgram pr=p_pad();
+    float blk[AUDIO_BLOCK];
+    double on=1e30, first=1e30, live=1e30;
+    patch_prepare(&pp,&pr,(float)SR);
+    for(int r=0;r<REPS;r++){
+        double t0=now_s();
+        for(int i=0;i<NOTES;i++){ patch_note_on_prepared(&p,&pp,36+i%48,0.8f); g_sink+=p.st.note_freq; }
+        double t=(now_s()-t0)*1e9/NOTES; if(t<on) on=t;
+        t0=now_s();
+        for(int i=0;i<NOTES;i++){
+            patch_note_on_prepared(&p,&pp,36+i%48,0.8f);
+            patch_step(&p,blk,AUDIO_BLOCK); g_sink+=blk[0];
+        }
+        t=(now_s()-t0)*1e9/NOTES; if(t<first) first=t;
+        /* live renderer: a batch of note-ons into free slots, init untimed */
+        double acc=0;
+        for(int i=0;i<NOTES;i+=VOICE_MAX_POLY){
+            voice_renderer_init(&vr,NULL,&pr,120.0f,(float)SR);
+            voice_renderer_set_polyphony(&vr,VOICE_MAX_POLY,STEAL_OLDEST);
+            t0=now_s();
+            for(int v=0;v<VOICE_MAX_POLY;v++) voice_renderer_note_on(&vr,36+v*3,0.8f);
+            acc+=now_s()-t0;
+        }
+        t=acc*1e9/NOTES; if(t<live) live=t;
+    }
+    metric("noteon.prepared.ns",on,"ns","lower");
+    metric("noteon.first_block.ns",first,"ns","lower");
+    metric("noteon.renderer.ns",live,"ns","lower");
+}
+
+/* ---- Sequence compilation ---- */
+
+static void bench_compile(void){
+    static EventStream es;
+    static VoiceCursor vc;
+    VoiceBuilder vb; vb_init(&vb);
+    /* 8 x (4 x 60 notes, rests and ties) */
+    vb_repeat_begin(&vb);
+    vb_repeat_begin(&vb);
+    for(int i=0;i<60;i++){
+        vb_note(&vb,36+(i*7)%48,DUR_1_16+i%3,VEL_MF);
+        if(i%5==0) vb_tie(&vb,DUR_1_32);
+        if(i%7==0) vb_rest(&vb,DUR_1_16);
+    }
+    vb_repeat_end(&vb,4);
+    vb_repeat_end(&vb,8);
+    const VoiceProgram *vp=vb_finish(&vb);
+    if(voice_compile(vp,&es)) return;
+    int runs=200;
+    double best=1e30, cbest=1e30;
+    for(int r=0;r<REPS;r++){
+        double t0=now_s();
+        for(int i=0;i<runs;i++){ voice_compile(vp,&es); g_sink+=(float)es.n; }
+        double t=(now_s()-t0)/runs; if(t<best) best=t;
+        Event ev; int n=0;
+        t0=now_s();
+        for(int i=0;i<runs;i++){
+            voice_cursor_init(&vc,vp);
+            while(voice_cursor_next(&vc,&ev)>0) n++;
+        }
+        g_sink+=(float)n;
+        t=(now_s()-t0)/runs; if(t<cbest) cbest=t;
+    }
+    metric("compile.voice_compile.events_per_s",es.n/best,"events/s","higher");
+    metric("compile.cursor.events_per_s",es.n/cbest,"events/s","higher");
+}
+
+/* ---- Main ---- */
+
+int main(int argc, char **argv){
+    const char *json=NULL, *base=NULL;
+    double pct=15.0;
+    int rounds=3;
+    for(int i=1;i<argc;i++){
+        if(!strcmp(argv[i],"--json")&&i+1<argc)           json=argv[++i];
+        else if(!strcmp(argv[i],"--compare")&&i+1<argc)   base=argv[++i];
+        else if(!strcmp(argv[i],"--threshold")&&i+1<argc) pct=atof(argv[++i]);
+        else if(!strcmp(argv[i],"--rounds")&&i+1<argc)    rounds=atoi(argv[++i]);
+        else {
+            fprintf(stderr,"usage: %s [--json FILE] [--compare BASELINE] [--threshold PCT] [--rounds N]\n",argv[0]);
+            return 2;
+        }
+    }
+    if(rounds<1) rounds=1;
+
+    printf("=== SHMC benchmark suite  —  %d Hz, best of %d x %d rounds ===\n",SR,REPS,rounds);
+    for(int r=0;r<rounds;r++){
+        bench_ops();
+        PatchProgram pr;
+        pr=p_sine_adsr();   patch_metrics("sine_adsr",&pr);
+        pr=p_fm_2op();      patch_metrics("fm_2op",&pr);
+        pr=p_fm_fold();     patch_metrics("fm_fold",&pr);
+        pr=p_pad();         patch_metrics("pad",&pr);
+        pr=patch_piano();   patch_metrics("piano",&pr);
+        pr=patch_bass();    patch_metrics("bass",&pr);
+        pr=patch_lead();    patch_metrics("lead",&pr);
+        bench_note_on();
+        bench_compile();
+    }
+    /* the opcode's share, from the best totals */
+    for(size_t i=0;i<sizeof OPS/sizeof OPS[0];i++){
+        char k[48];
+        snprintf(k,sizeof k,"op.%s.ns",OPS[i].name);
+        double ns=value(k);
+        snprintf(k,sizeof k,"op.%s.net_ns",OPS[i].name);
+        metric(k,ns-value("op.base.ns"),"ns","none");
+    }
+    for(int i=0;i<s_n;i++)
+        printf("  %-34s %12.5g %s\n",s_m[i].name,s_m[i].value,s_m[i].unit);
+
+    if(json&&write_json(json)){ fprintf(stderr,"bench_suite: cannot write %s\n",json); return 2; }
+    return base?compare(base,pct):0;
+}
@@ -0,0 +1,429 @@
+/*
+ * SHMC Layer 1 — Differential test of every execution engine
+ * Build: make -f layer1/Makefile diff
+ *
+ *   ./diff_engines [--fuzz N] [--seed S] [--samples N] [-v]
+ *
+ * Renders a corpus through a reference engine and each candidate and
+ * compares them by max-abs error, SNR and spectral difference (Welch
+ * power spectra, RMS dB difference over the bins within 100 dB of the
+ * reference's peak).  Exit status 1 if any candidate fails.
+ *
+ * patches:  the layer 0 reference patches and the layer 1 instruments.
+ *           Reference: patch_step_scalar() (exec1) on the raw program.
+ *           Exact candidates — must be bit-identical: block (raw
+ *           program), prepared, ragged spans, PatchBank lane, patch_jit()
+ *           code, patch_optimize() output (scalar and jit).
+ *           Approximate candidates — the accuracy report for the
+ *           approximate kernels: TANH and EXP_DECAY switched from
+ *           MATH_REF to MATH_POLY, EXP_DECAY to MATH_RECUR; pass on SNR
+ *           and spectrum.  OSC's MATH_POLY is listed but not judged: it
+ *           is the more accurate of the two (patch_dsp.h), so the
+ *           difference measures fsin().
+ * voices:   VoiceBuilder programs on the instruments.  Reference:
+ *           compiled EventStream in 64-sample blocks.  Exact
+ *           candidates: VoiceCursor streaming, ragged block sizes, and
+ *           the mixer on 4 threads against 1.
+ * fuzz:     N random valid PatchPrograms from PatchBuilder (every
+ *           opcode, tier, oversampling and SVF mode), through the exact
+ *           patch engines.  A failure prints its seed and disassembly;
+ *           --fuzz 1 --seed S reproduces it.
+ *
+ * Every render releases the note half way, so the release stages run.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "voice.h"
+#include "mixer.h"
+#include "patch_bank.h"
+#include "patch_opt.h"
+#include "patch_jit.h"
+#include "patch_file.h"
+#include "patch_asm.h"
+#include "patches.h"
+#include "../../layer0/tests/patches.h"
+
+#define SR      44100
+#define MIDI    57
+#define VEL     0.8f
+#define FFT_N   1024
+#define MAX_N   (SR*4)
+
+/* Approximate engines: minimum SNR and maximum spectral difference */
+#define APPROX_SNR_DB   60.0
+#define APPROX_SPEC_DB  1.0
+
+static int s_verbose, s_fail;
+
+/* ---- Comparison ---- */
+
+typedef struct { double maxabs, snr, spec; int first; } Diff;
+
+/* In-place radix-2 FFT, n a power of two */
+static void fft(float *re, float *im, int n){
+    for(int i=1,j=0;i<n;i++){
+        int b=n>>1;
+        for(;j&b;b>>=1) j^=b;
+        j^=b;
+        if(i<j){ float t=re[i]; re[i]=re[j]; re[j]=t; t=im[i]; im[i]=im[j]; im[j]=t; }
+    }
+    for(int len=2;len<=n;len<<=1){
+        double a=-2.0*M_PI/len;
+        for(int i=0;i<n;i+=len)
+            for(int k=0;k<len/2;k++){
+                float wr=(float)cos(a*k), wi=(float)sin(a*k);
+                float *ur=&re[i+k], *ui=&im[i+k], *vr=&re[i+k+len/2], *vi=&im[i+k+len/2];
+                float xr=*vr*wr-*vi*wi, xi=*vr*wi+*vi*wr;
+                *vr=*ur-xr; *vi=*ui-xi; *ur+=xr; *ui+=xi;
+            }
+    }
+}
+
+/* Welch power spectrum of x[0..n): Hann frames, 50% overlap */
+static void welch(const float *x, int n, double *p){
+    static float re[FFT_N], im[FFT_N];
+    memset(p,0,sizeof(double)*(FFT_N/2+1));
+    for(int s=0;s+FFT_N<=n;s+=FFT_N/2){
+        for(int k=0;k<FFT_N;k++){
+            float w=0.5f-0.5f*cosf(2.f*(float)M_PI*k/FFT_N);
+            float v=x[s+k];
+            re[k]=isfinite(v)?v*w:0.f; im[k]=0.f;
+        }
+        fft(re,im,FFT_N);
+        for(int k=0;k<=FFT_N/2;k++) p[k]+=(double)re[k]*re[k]+(double)im[k]*im[k];
+    }
+}
+
+static Diff compare(const float *ref, const float *c, int n){
+    static double pr[FFT_N/2+1], pc[FFT_N/2+1];
+    Diff d={0,INFINITY,0,-1};
+    double es=0, ed=0;
+    for(int i=0;i<n;i++){
+        if(d.first<0&&memcmp(&ref[i],&c[i],sizeof(float))) d.first=i;
+        double r=isfinite(ref[i])?ref[i]:0, e=isfinite(c[i])?c[i]-r:INFINITY;
+        if(fabs(e)>d.maxabs) d.maxabs=fabs(e);
+        es+=r*r; ed+=e*e;
+    }
+    if(ed>0) d.snr=es>0?10.0*log10(es/ed):-INFINITY;
+    welch(ref,n,pr); welch(c,n,pc);
+    double peak=0, acc=0; int nb=0;
+    for(int k=0;k<=FFT_N/2;k++) if(pr[k]>peak) peak=pr[k];
+    for(int k=0;k<=FFT_N/2;k++){
+        if(peak==0||pr[k]<peak*1e-10) continue;
+        double db=10.0*log10((pc[k]+peak*1e-10)/(pr[k]+peak*1e-10));
+        acc+=db*db; nb++;
+    }
+    d.spec=nb?sqrt(acc/nb):0;
+    return d;
+}
+
+enum { EXACT, APPROX, INFO };   /* how report() judges a candidate */
+
+static void report(const char *name, const char *engine, const float *ref,
+                   const float *c, int n, int mode){
+    Diff d=compare(ref,c,n);
+    int ok=mode==EXACT?d.first<0:mode==APPROX?d.snr>=APPROX_SNR_DB&&d.spec<=APPROX_SPEC_DB:1;
+    if(!ok) s_fail++;
+    if(!ok||mode!=EXACT||s_verbose){
+        printf("  %-14s %-10s max %-10.3g snr %7.1f dB  spec %6.3f dB  %s",name,engine,
+               d.maxabs,d.snr,d.spec,mode==INFO?"info":ok?"ok":"FAIL");
+        if(!ok&&mode==EXACT) printf("  (first diff at sample %d)",d.first);
+        printf("\n");
+    }
+}
+
+/* ---- Patch engines ---- */
+
+typedef int (*StepFn)(Patch*,float*,int);
+
+/* The k-th span, starting at sample i: 64 samples, or cycling through
+   RAGGED.  Spans stop at n/2, where the note is released. */
+static const int RAGGED[]={ 1,13,64,200,7,37,128,3 };
+
+static int span(int i, int k, int n, const int *spans){
+    int c=spans?spans[k%8]:AUDIO_BLOCK;
+    if(c>n-i) c=n-i;
+    if(i<n/2&&i+c>n/2) c=n/2-i;
+    return c;
+}
+
+static void render_patch(Patch *p, StepFn step, float *out, int n, const int *spans){
+    for(int i=0,k=0;i<n;k++){
+        if(i==n/2) patch_note_off(p);
+        int c=span(i,k,n,spans);
+        step(p,out+i,c); i+=c;
+    }
+}
+
+/* Reference: exec1 on the raw program */
+static void render_ref(const PatchProgram *pr, float *out, int n){
+    Patch p; patch_note_on(&p,pr,(float)SR,MIDI,VEL);
+    render_patch(&p,patch_step_scalar,out,n,NULL);
+}
+
+static void render_block(const PatchProgram *pr, float *out, int n){
+    Patch p; patch_note_on(&p,pr,(float)SR,MIDI,VEL);
+    render_patch(&p,patch_step,out,n,NULL);
+}
+
+static int render_prepared(const PatchProgram *pr, float *out, int n, int jit, const int *spans){
+    static PreparedProgram pp;
+    if(patch_prepare(&pp,pr,(float)SR)) return -1;
+    if(jit&&(patch_jit(&pp)||!pp.jit)) return -1;
+    Patch p; patch_note_on_prepared(&p,&pp,MIDI,VEL);
+    render_patch(&p,patch_step,out,n,spans);
+    return 0;
+}
+
+/* A bank lane goes silent once its released envelopes finish; returns
+   the samples rendered up to then, -1 if the program does not fit */
+static int render_bank(const PatchProgram *pr, float *out, int n){
+    static PreparedProgram pp; static PatchBank bk;
+    static float lanes[AUDIO_BLOCK*BANK_LANES];
+    if(patch_prepare(&pp,pr,(float)SR)||bank_init(&bk,&pp)) return -1;
+    int lane=bank_note_on(&bk,MIDI,VEL);
+    for(int i=0,k=0;i<n;k++){
+        if(i==n/2) bank_note_off(&bk,MIDI);
+        int c=span(i,k,n,NULL);
+        bank_step_lanes(&bk,lanes,c);
+        for(int j=0;j<c;j++) out[i+j]=lanes[j*BANK_LANES+lane];
+        i+=c;
+        if(!(bk.active&(1u<<lane))) return i;
+    }
+    return n;
+}
+
+/* Every exact engine against the reference; returns failures */
+static int diff_patch(const char *name, const PatchProgram *pr, int n){
+    static float ref[MAX_N], buf[MAX_N];
+    static PatchProgram opt;
+    int f0=s_fail, m;
+    render_ref(pr,ref,n);
+    render_block(pr,buf,n);                      report(name,"block",ref,buf,n,EXACT);
+    if(!render_prepared(pr,buf,n,0,NULL))        report(name,"prepared",ref,buf,n,EXACT);
+    if(!render_prepared(pr,buf,n,0,RAGGED))      report(name,"ragged",ref,buf,n,EXACT);
+    if((m=render_bank(pr,buf,n))>0)              report(name,"bank",ref,buf,m,EXACT);
+    if(!render_prepared(pr,buf,n,1,RAGGED))      report(name,"jit",ref,buf,n,EXACT);
+    patch_optimize(&opt,pr,NULL);
+    render_ref(&opt,buf,n);                      report(name,"opt",ref,buf,n,EXACT);
+    if(!render_prepared(&opt,buf,n,1,NULL))      report(name,"opt+jit",ref,buf,n,EXACT);
+    patch_jit_clear();
+    return s_fail-f0;
+}
+
+/* The program with its MATH_REF ops a and b switched to tier; returns
+   how many were */
+static int approx(PatchProgram *dst, const PatchProgram *src, int a, int b, int tier){
+    int k=0;
+    *dst=*src;
+    for(int i=0;i<dst->n_instrs;i++){
+        Instr in=dst->code[i]; uint8_t op=INSTR_OP(in);
+        if(INSTR_IMM_LO(in)!=MATH_REF||(op!=a&&op!=b)) continue;
+        dst->code[i]=(in&~(Instr)0xFFFF)|(Instr)tier;
+        k++;
+    }
+    return k;
+}
+
+static void diff_approx(const char *name, const PatchProgram *pr, int n){
+    static float ref[MAX_N], buf[MAX_N];
+    PatchProgram ap;
+    render_ref(pr,ref,n);
+    if(approx(&ap,pr,OP_TANH,OP_EXP_DECAY,MATH_POLY)){ render_ref(&ap,buf,n); report(name,"poly",ref,buf,n,APPROX); }
+    if(approx(&ap,pr,OP_EXP_DECAY,-1,MATH_RECUR))    { render_ref(&ap,buf,n); report(name,"recur",ref,buf,n,APPROX); }
+    if(approx(&ap,pr,OP_OSC,-1,MATH_POLY))           { render_ref(&ap,buf,n); report(name,"sin poly",ref,buf,n,INFO); }
+}
+
+/* ---- Voice engines ---- */
+
+static void render_voice(VoiceRenderer *vr, float *out, int n, const int *spans){
+    for(int i=0,k=0;i<n;k++){
+        int c=span(i,k,n,spans);
+        voice_render_block(vr,out+i,c); i+=c;
+    }
+}
+
+static void diff_voice(const char *name, const VoiceProgram *vp, const PatchProgram *pr, int n){
+    static EventStream es;
+    static VoiceRenderer vr;
+    static VoiceCursor vc;
+    static float ref[MAX_N], buf[MAX_N];
+    voice_compile(vp,&es);
+    voice_renderer_init(&vr,&es,pr,132.0f,(float)SR);
+    voice_renderer_set_polyphony(&vr,4,STEAL_OLDEST);
+    render_voice(&vr,ref,n,NULL);
+
+    voice_cursor_init(&vc,vp);
+    voice_renderer_init_stream(&vr,&vc,pr,132.0f,(float)SR);
+    voice_renderer_set_polyphony(&vr,4,STEAL_OLDEST);
+    render_voice(&vr,buf,n,NULL);                report(name,"stream",ref,buf,n,EXACT);
+
+    voice_renderer_init(&vr,&es,pr,132.0f,(float)SR);
+    voice_renderer_set_polyphony(&vr,4,STEAL_OLDEST);
+    render_voice(&vr,buf,n,RAGGED);              report(name,"ragged",ref,buf,n,EXACT);
+}
+
+/* The same arrangement mixed on 1 and on 4 threads */
+static void diff_mixer(const VoiceProgram *vp, const PatchProgram *pr, int nt, int n){
+    static EventStream es;
+    static VoiceRenderer vr[8];
+    static float ref[MAX_N], buf[MAX_N];
+    voice_compile(vp,&es);
+    for(int th=1;th<=4;th+=3){
+        Mixer m; mixer_init(&m,th);
+        for(int t=0;t<nt;t++){
+            voice_renderer_init(&vr[t],&es,&pr[t],100.0f+t*7,(float)SR);
+            voice_renderer_set_polyphony(&vr[t],4,STEAL_QUIETEST);
+            mixer_add_track(&m,&vr[t],1.0f/nt);
+        }
+        mixer_render_block(&m,th==1?ref:buf,n);
+        mixer_free(&m);
+    }
+    report("mix","threads=4",ref,buf,n,EXACT);
+}
+
+/* ---- Fuzzing ---- */
+
+static uint32_t s_rng;
+static uint32_t rnd(uint32_t n){
+    s_rng^=s_rng<<13; s_rng^=s_rng>>17; s_rng^=s_rng<<5;
+    return s_rng%n;
+}
+
+/* A random valid program: 2..24 instructions, each reading earlier
+   results or the reserved registers (audio-rate pitch sources are
+   kept positive and small so oscillators stay below Nyquist) */
+static PatchProgram fuzz_prog(void){
+    PatchBuilder b; pb_init(&b);
+    int pool[32]={ REG_ONE,REG_VEL }, np=2;
+    int n=2+(int)rnd(23);
+    #define SRC   pool[rnd((uint32_t)np)]
+    #define RATIO pb_const_f(&b,0.25f+(float)rnd(32)/8.f)
+    for(int i=0;i<n&&np<32;i++){
+        int d, k=(int)rnd(24);
+        switch(k){
+        case 0:  d=pb_const_f(&b,((float)rnd(2048)-1024.f)/256.f); break;
+        case 1:  d=pb_reg(&b); pb_emit(&b,INSTR_PACK(OP_ADD+rnd(4),d,SRC,SRC,0,0)); break;
+        case 2:  d=pb_reg(&b); pb_emit(&b,INSTR_PACK(rnd(2)?OP_NEG:OP_ABS,d,SRC,0,0,0)); break;
+        case 3:  d=pb_osc_q(&b,rnd(2)?REG_ONE:RATIO,rnd(2)); break;
+        case 4:  { static const uint8_t o[3]={OP_SAW,OP_SQUARE,OP_TRI};
+                   d=pb_reg(&b); pb_emit(&b,INSTR_PACK(o[rnd(3)],d,RATIO,0,0,rnd(2))); break; }
+        case 5:  d=pb_reg(&b); pb_emit(&b,INSTR_PACK(OP_PHASE,d,RATIO,0,0,0)); break;
+        case 6:  d=pb_fm(&b,REG_ONE,SRC,(int)rnd(32)); break;
+        case 7:  d=pb_reg(&b); pb_emit(&b,INSTR_PACK(OP_PM,d,RATIO,SRC,0,0)); break;
+        case 8:  d=pb_am(&b,SRC,SRC,(int)rnd(32)); break;
+        case 9:  d=pb_reg(&b); pb_emit(&b,INSTR_PACK(OP_SYNC,d,REG_ONE,RATIO,0,0)); break;
+        case 10: d=rnd(2)?pb_noise(&b):pb_lp_noise(&b,(int)rnd(64)); break;
+        case 11: d=pb_reg(&b); pb_emit(&b,INSTR_PACK(OP_RAND_STEP,d,0,0,1+rnd(400),0)); break;
+        case 12: pb_oversample(&b,(int)rnd(3));
+                 { int x=rnd(2)?pool[np-1]:SRC;       /* chains share a region */
+                   d=rnd(3)==0?pb_tanh_q(&b,x,rnd(2)):rnd(2)?pb_clip(&b,x):pb_fold(&b,x); }
+                 pb_oversample(&b,OS_1X); break;
+        case 13: d=pb_reg(&b); pb_emit(&b,INSTR_PACK(OP_SIGN,d,SRC,0,0,0)); break;
+        case 14: d=rnd(2)?pb_lpf(&b,SRC,(int)rnd(64)):pb_hpf(&b,SRC,(int)rnd(64)); break;
+        case 15: d=pb_bpf(&b,SRC,(int)rnd(64),(int)rnd(32)); break;
+        case 16: d=pb_reg(&b); pb_emit(&b,INSTR_PACK(OP_ONEPOLE,d,SRC,0,rnd(256)<<8,0)); break;
+        case 17: { int x=SRC, c=pb_mul(&b,REG_FREQ,RATIO), q=pb_const_f(&b,0.25f+(float)rnd(64)/8.f);
+                   d=pb_svf(&b,x,c,q,(int)rnd(4)); break; }
+        case 18: d=pb_adsr(&b,(int)rnd(32),(int)rnd(32),(int)rnd(32),(int)rnd(32)); break;
+        case 19: d=pb_reg(&b); pb_emit(&b,INSTR_PACK(OP_RAMP,d,0,0,rnd(32),0)); break;
+        case 20: d=pb_exp_decay_q(&b,(int)rnd(32),(int)rnd(3)); break;
+        case 21: d=pb_reg(&b); pb_emit(&b,INSTR_PACK(rnd(2)?OP_MIN:OP_MAX,d,SRC,SRC,0,0)); break;
+        case 22: d=pb_mix(&b,SRC,SRC,(int)rnd(32),(int)rnd(32)); break;
+        default: d=pb_mul(&b,SRC,SRC); break;
+        }
+        pool[np++]=d;
+    }
+    #undef SRC
+    #undef RATIO
+    pb_out(&b,pool[np-1-rnd(np>3?3:1)]);
+    return *pb_finish(&b);
+}
+
+static int fuzz(int count, uint32_t seed, int n){
+    int bad=0, f0=s_fail;
+    for(int i=0;i<count;i++){
+        uint32_t s=seed+(uint32_t)i;
+        s_rng=s*2654435761u|1u;
+        PatchProgram pr=fuzz_prog();
+        char name[24]; snprintf(name,sizeof(name),"fuzz %u",s);
+        int v=patch_validate(&pr);
+        if(v){ printf("  %-14s invalid program: %s\n",name,pf_strerror(v)); s_fail++; }
+        else if(!diff_patch(name,&pr,n)) continue;
+        printf("  reproduce: --fuzz 1 --seed %u\n",s);
+        patch_disasm(stdout,name,&pr);
+        if(++bad==5){ printf("  stopping after 5 failing programs\n"); break; }
+    }
+    return s_fail-f0;
+}
+
+/* ---- Main ---- */
+
+int main(int argc, char **argv){
+    int nfuzz=300, n=SR;
+    uint32_t seed=1;
+    for(int i=1;i<argc;i++){
+        if(!strcmp(argv[i],"--fuzz")&&i+1<argc)         nfuzz=atoi(argv[++i]);
+        else if(!strcmp(argv[i],"--seed")&&i+1<argc)    seed=(uint32_t)strtoul(argv[++i],NULL,0);
+        else if(!strcmp(argv[i],"--samples")&&i+1<argc) n=atoi(argv[++i]);
+        else if(!strcmp(argv[i],"-v"))                  s_verbose=1;
+        else {
+            fprintf(stderr,"usage: %s [--fuzz N] [--seed S] [--samples N] [-v]\n",argv[0]);
+            return 2;
+        }
+    }
+    if(n<FFT_N) n=FFT_N;
+    if(n>MAX_N) n=MAX_N;
+
+    printf("=== SHMC differential test  —  %d samples, exact engines must be bit-identical ===\n\n",n);
+    printf("[patches]  block prepared ragged bank jit opt opt+jit vs exec1\n");
+    struct { const char *name; PatchProgram pr; } P[]={
+        #define ITEM(x) { #x, p_##x() },
+        PATCH_LIST(ITEM)
+        #undef ITEM
+        { "piano", patch_piano() }, { "bass", patch_bass() },
+        { "lead",  patch_lead()  }, { "strings", patch_pad() },
+    };
+    int np=(int)(sizeof(P)/sizeof(P[0])), f=s_fail;
+    for(int i=0;i<np;i++) diff_patch(P[i].name,&P[i].pr,n);
+    printf("  %d patches, %d failures\n\n",np,s_fail-f);
+
+    printf("[approx]  MATH_POLY / MATH_RECUR vs MATH_REF  (snr >= %.0f dB, spec <= %.1f dB; sin: info)\n",
+           APPROX_SNR_DB,APPROX_SPEC_DB);
+    f=s_fail;
+    for(int i=0;i<np;i++) diff_approx(P[i].name,&P[i].pr,n);
+    printf("  %d failures\n\n",s_fail-f);
+
+    printf("[voices]  stream ragged vs compiled EventStream; mixer 4 threads vs 1\n");
+    f=s_fail;
+    {
+        VoiceBuilder a; vb_init(&a);
+        for(int p=60;p<=72;p+=2) vb_note(&a,p,DUR_1_8,VEL_MF);
+        VoiceBuilder b; vb_init(&b);
+        vb_repeat_begin(&b);
+          vb_note(&b,48,DUR_1_16,VEL_F); vb_rest(&b,DUR_1_16);
+          vb_repeat_begin(&b); vb_note(&b,55,DUR_1_32,VEL_P); vb_repeat_end(&b,3);
+          vb_glide(&b,60,DUR_1_8,VEL_MF); vb_tie(&b,DUR_1_16);
+        vb_repeat_end(&b,4);
+        VoiceBuilder c; vb_init(&c);
+        for(int i=0;i<24;i++) vb_note(&c,40+(i*7)%30,DUR_1_64+i%4,VEL_PP+i%6);
+        const VoiceProgram *vp[3]={ vb_finish(&a),vb_finish(&b),vb_finish(&c) };
+        const char *vn[3]={ "scale","nested","dense" };
+        PatchProgram inst[4]={ patch_piano(),patch_bass(),patch_lead(),patch_pad() };
+        for(int v=0;v<3;v++) for(int k=0;k<4;k++){
+            char name[24]; snprintf(name,sizeof(name),"%s/%d",vn[v],k);
+            diff_voice(name,vp[v],&inst[k],n);
+        }
+        diff_mixer(vp[2],inst,4,n);
+    }
+    printf("  %d failures\n\n",s_fail-f);
+
+    printf("[fuzz]  %d random programs from seed %u\n",nfuzz,seed);
+    f=fuzz(nfuzz,seed,n<8192?n:8192);
+    printf("  %d failures\n\n",f);
+
+    printf("=== %s ===\n",s_fail?"FAIL":"all engines agree");
+    return s_fail?1:0;
+}
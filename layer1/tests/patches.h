@@ -0,0 +1,50 @@
+#pragma once
+/*
+ * SHMC Layer 1 — reference patches shared by the test and bench programs
+ */
+#include "../../layer0/include/patch_builder.h"
+
+static PatchProgram patch_piano(void){
+    /* Bright FM + fast decay — "piano-like" */
+    PatchBuilder b; pb_init(&b);
+    int two=pb_const_f(&b,2.0f);
+    int mod=pb_osc(&b,two);
+    int car=pb_fm(&b,REG_ONE,mod,15);
+    int env=pb_adsr(&b,0,14,8,10);
+    pb_out(&b,pb_mul(&b,car,env));
+    return *pb_finish(&b);
+}
+
+static PatchProgram patch_bass(void){
+    /* Sawtooth + LP filter */
+    PatchBuilder b; pb_init(&b);
+    int saw=pb_saw(&b,REG_ONE);
+    int flt=pb_lpf(&b,saw,28);
+    int env=pb_adsr(&b,0,8,20,8);
+    pb_out(&b,pb_mul(&b,flt,env));
+    return *pb_finish(&b);
+}
+
+static PatchProgram patch_lead(void){
+    /* Triangle + tanh saturation */
+    PatchBuilder b; pb_init(&b);
+    int tr=pb_tri(&b,REG_ONE);
+    int gn=pb_const_f(&b,3.0f);
+    int dr=pb_mul(&b,tr,gn);
+    int st=pb_tanh(&b,dr);
+    int env=pb_adsr(&b,1,10,22,12);
+    pb_out(&b,pb_mul(&b,st,env));
+    return *pb_finish(&b);
+}
+
+static PatchProgram patch_pad(void){
+    PatchBuilder b; pb_init(&b);
+    int o1=pb_osc(&b,REG_ONE);
+    int dt=pb_const_f(&b,1.008f);
+    int o2=pb_osc(&b,dt);
+    int mx=pb_mix(&b,o1,o2,15,15);
+    int fl=pb_lpf(&b,mx,42);
+    int en=pb_adsr(&b,14,4,28,20);
+    pb_out(&b,pb_mul(&b,fl,en));
+    return *pb_finish(&b);
+}
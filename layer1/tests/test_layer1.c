@@ -14,11 +14,18 @@
 #include <string.h>
 #include <math.h>
 #include "voice.h"
-#include "../../layer0/include/patch_builder.h"
+#include "mixer.h"
+#include "rt_driver.h"
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include "patches.h"
 
 #define SR      44100
 #define BLK     512
 
+static int g_fail = 0;
+
 /* ---- WAV writer ---- */
 static void write_wav(const char *path, const float *b, int n){
     FILE *f=fopen(path,"wb"); if(!f){perror(path);return;}
@@ -38,7 +45,7 @@ static void write_wav(const char *path, const float *b, int n){
 /* ---- Render EventStream to float buffer ---- */
 static float *render_voice(const EventStream *es, const PatchProgram *patch,
                              float bpm, int *out_n){
-    int cap = (int)(SR * (es->total_beats * 60.0f / bpm + 2.0f)); /* +2s tail */
+    int cap = (int)(SR * ((float)es->total_ticks/VOICE_PPQ * 60.0f / bpm + 2.0f)); /* +2s tail */
     float *buf=(float*)calloc(cap,sizeof(float));
     VoiceRenderer vr;
     voice_renderer_init(&vr,es,patch,bpm,(float)SR);
@@ -53,53 +60,6 @@ static float *render_voice(const EventStream *es, const PatchProgram *patch,
     return buf;
 }
 
-/* ---- Patches ---- */
-
-static PatchProgram patch_piano(void){
-    /* Bright FM + fast decay — "piano-like" */
-    PatchBuilder b; pb_init(&b);
-    int two=pb_const_f(&b,2.0f);
-    int mod=pb_osc(&b,two);
-    int car=pb_fm(&b,REG_ONE,mod,15);
-    int env=pb_adsr(&b,0,14,8,10);
-    pb_out(&b,pb_mul(&b,car,env));
-    return *pb_finish(&b);
-}
-
-static PatchProgram patch_bass(void){
-    /* Sawtooth + LP filter */
-    PatchBuilder b; pb_init(&b);
-    int saw=pb_saw(&b,REG_ONE);
-    int flt=pb_lpf(&b,saw,28);
-    int env=pb_adsr(&b,0,8,20,8);
-    pb_out(&b,pb_mul(&b,flt,env));
-    return *pb_finish(&b);
-}
-
-static PatchProgram patch_lead(void){
-    /* Triangle + tanh saturation */
-    PatchBuilder b; pb_init(&b);
-    int tr=pb_tri(&b,REG_ONE);
-    int gn=pb_const_f(&b,3.0f);
-    int dr=pb_mul(&b,tr,gn);
-    int st=pb_tanh(&b,dr);
-    int env=pb_adsr(&b,1,10,22,12);
-    pb_out(&b,pb_mul(&b,st,env));
-    return *pb_finish(&b);
-}
-
-static PatchProgram patch_pad(void){
-    PatchBuilder b; pb_init(&b);
-    int o1=pb_osc(&b,REG_ONE);
-    int dt=pb_const_f(&b,1.008f);
-    int o2=pb_osc(&b,dt);
-    int mx=pb_mix(&b,o1,o2,15,15);
-    int fl=pb_lpf(&b,mx,42);
-    int en=pb_adsr(&b,14,4,28,20);
-    pb_out(&b,pb_mul(&b,fl,en));
-    return *pb_finish(&b);
-}
-
 /* ====================================================================
    Test 1: C major scale (8 quarter notes)
    ==================================================================== */
@@ -111,7 +71,7 @@ static void test_scale(void){
 
     EventStream es;
     if(voice_compile(vb_finish(&vb),&es)<0){printf("  FAIL compile\n");return;}
-    printf("  events=%d  total_beats=%.2f\n",es.n,es.total_beats);
+    printf("  events=%d  total_beats=%.2f\n",es.n,(float)es.total_ticks/VOICE_PPQ);
 
     PatchProgram pa=patch_piano();
     int n; float *buf=render_voice(&es,&pa,120.0f,&n);
@@ -136,7 +96,7 @@ static void test_repeat(void){
 
     EventStream es;
     if(voice_compile(vb_finish(&vb),&es)<0){printf("  FAIL compile\n");return;}
-    printf("  events=%d  total_beats=%.2f\n",es.n,es.total_beats);
+    printf("  events=%d  total_beats=%.2f\n",es.n,(float)es.total_ticks/VOICE_PPQ);
 
     PatchProgram pa=patch_bass();
     int n; float *buf=render_voice(&es,&pa,120.0f,&n);
@@ -160,7 +120,7 @@ static void test_rest_tie(void){
 
     EventStream es;
     if(voice_compile(vb_finish(&vb),&es)<0){printf("  FAIL compile\n");return;}
-    printf("  events=%d  total_beats=%.2f\n",es.n,es.total_beats);
+    printf("  events=%d  total_beats=%.2f\n",es.n,(float)es.total_ticks/VOICE_PPQ);
 
     PatchProgram pa=patch_lead();
     int n; float *buf=render_voice(&es,&pa,100.0f,&n);
@@ -186,7 +146,7 @@ static void test_nested_repeat(void){
 
     EventStream es;
     if(voice_compile(vb_finish(&vb),&es)<0){printf("  FAIL compile\n");return;}
-    printf("  events=%d  total_beats=%.2f\n",es.n,es.total_beats);
+    printf("  events=%d  total_beats=%.2f\n",es.n,(float)es.total_ticks/VOICE_PPQ);
 
     PatchProgram pa=patch_piano();
     int n; float *buf=render_voice(&es,&pa,130.0f,&n);
@@ -209,7 +169,7 @@ static void test_glide(void){
 
     EventStream es;
     if(voice_compile(vb_finish(&vb),&es)<0){printf("  FAIL compile\n");return;}
-    printf("  events=%d  total_beats=%.2f\n",es.n,es.total_beats);
+    printf("  events=%d  total_beats=%.2f\n",es.n,(float)es.total_ticks/VOICE_PPQ);
 
     PatchProgram pa=patch_lead();
     int n; float *buf=render_voice(&es,&pa,100.0f,&n);
@@ -236,7 +196,7 @@ static void test_melody(void){
 
     EventStream es;
     if(voice_compile(vb_finish(&vb),&es)<0){printf("  FAIL compile\n");return;}
-    printf("  events=%d  total_beats=%.2f\n",es.n,es.total_beats);
+    printf("  events=%d  total_beats=%.2f\n",es.n,(float)es.total_ticks/VOICE_PPQ);
 
     PatchProgram pa=patch_pad();
     int n; float *buf=render_voice(&es,&pa,110.0f,&n);
@@ -258,42 +218,434 @@ static void test_compile_structure(void){
     EventStream es;
     voice_compile(vb_finish(&vb),&es);
 
-    /* Expected events:
-       beat 0.00 : NOTE_ON  C4
-       beat 0.25 : NOTE_OFF C4
-       beat 0.375: NOTE_ON  E4   (after 1/8 rest = 0.125 beats)
-       beat 0.625: NOTE_OFF E4
+    /* Expected events (VOICE_PPQ 960):
+       tick   0 : NOTE_ON  C4
+       tick 240 : NOTE_OFF C4
+       tick 360 : NOTE_ON  E4   (after 1/8 rest = 120 ticks)
+       tick 600 : NOTE_OFF E4
     */
     int pass=1;
     if(es.n!=4){ printf("  FAIL: expected 4 events, got %d\n",es.n); pass=0; }
     else {
-        float eps=1e-4f;
-        float b0=es.events[0].beat, b1=es.events[1].beat;
-        float b2=es.events[2].beat, b3=es.events[3].beat;
-        if(fabsf(b0-0.000f)>eps||es.events[0].type!=EV_NOTE_ON) {printf("  FAIL ev0\n");pass=0;}
-        if(fabsf(b1-0.250f)>eps||es.events[1].type!=EV_NOTE_OFF){printf("  FAIL ev1\n");pass=0;}
-        if(fabsf(b2-0.375f)>eps||es.events[2].type!=EV_NOTE_ON) {printf("  FAIL ev2\n");pass=0;}
-        if(fabsf(b3-0.625f)>eps||es.events[3].type!=EV_NOTE_OFF){printf("  FAIL ev3\n");pass=0;}
-        if(pass) printf("  events: %.3f ON  %.3f OFF  %.3f ON  %.3f OFF  ✓\n",b0,b1,b2,b3);
+        uint32_t t0=es.events[0].tick, t1=es.events[1].tick;
+        uint32_t t2=es.events[2].tick, t3=es.events[3].tick;
+        if(t0!=  0||es.events[0].type!=EV_NOTE_ON) {printf("  FAIL ev0\n");pass=0;}
+        if(t1!=240||es.events[1].type!=EV_NOTE_OFF){printf("  FAIL ev1\n");pass=0;}
+        if(t2!=360||es.events[2].type!=EV_NOTE_ON) {printf("  FAIL ev2\n");pass=0;}
+        if(t3!=600||es.events[3].type!=EV_NOTE_OFF){printf("  FAIL ev3\n");pass=0;}
+        if(pass) printf("  ticks: %u ON  %u OFF  %u ON  %u OFF  ✓\n",t0,t1,t2,t3);
+    }
+    printf("  %s\n\n", pass?"PASS":"FAIL");
+}
+
+/* ====================================================================
+   Test 7b: Streaming — VoiceCursor vs compiled EventStream, and a loop
+   far longer than VOICE_MAX_EVENTS that plays without expansion
+   ==================================================================== */
+static void test_stream(void){
+    printf("[test_stream] VoiceCursor streaming, sizeof=%zu\n",sizeof(VoiceCursor));
+    VoiceBuilder vb; vb_init(&vb);
+    vb_repeat_begin(&vb);
+      vb_note(&vb,60,DUR_1_8,VEL_MF); vb_tie(&vb,DUR_1_16);
+      vb_repeat_begin(&vb);
+        vb_note(&vb,64,DUR_1_16,VEL_F); vb_rest(&vb,DUR_1_16);
+      vb_repeat_end(&vb,3);
+      vb_glide(&vb,67,DUR_1_8,VEL_P); vb_tie(&vb,DUR_1_8);
+    vb_repeat_end(&vb,4);
+    vb_rest(&vb,DUR_1_4); vb_tie(&vb,DUR_1_4);      /* tie across a rest */
+    static EventStream es; static VoiceCursor c; static VoiceRenderer vr;
+    int pass=voice_compile(vb_finish(&vb),&es)==0 && voice_cursor_init(&c,vb_finish(&vb))==0;
+    Event ev; int n=0;
+    while(voice_cursor_next(&c,&ev)>0){
+        const Event *e=&es.events[n++];
+        pass&=n<=es.n && e->tick==ev.tick && e->type==ev.type && e->pitch==ev.pitch;
+    }
+    pass&=n==es.n && c.tick==es.total_ticks;
+
+    /* Same audio from the stream and the cursor */
+    PatchProgram pa=patch_piano();
+    int len; float *ref=render_voice(&es,&pa,120.0f,&len), *got=calloc(len,sizeof(float));
+    voice_cursor_init(&c,vb_finish(&vb));
+    voice_renderer_init_stream(&vr,&c,&pa,120.0f,(float)SR);
+    for(int pos=0;pos<len;pos+=BLK) voice_render_block(&vr,got+pos,len-pos<BLK?len-pos:BLK);
+    pass&=!memcmp(ref,got,len*sizeof(float)) && vr.done;
+    free(ref); free(got);
+
+    /* 255^3 sixty-fourth notes: 33M events, playing from the first block */
+    vb_init(&vb);
+    vb_repeat_begin(&vb); vb_repeat_begin(&vb); vb_repeat_begin(&vb);
+    vb_note(&vb,72,DUR_1_64,VEL_MF);
+    vb_repeat_end(&vb,255); vb_repeat_end(&vb,255); vb_repeat_end(&vb,255);
+    pass&=voice_compile(vb_finish(&vb),&es)==-1;                  /* overflows */
+    voice_cursor_init(&c,vb_finish(&vb));
+    voice_renderer_init_stream(&vr,&c,&pa,120.0f,(float)SR);
+    float blk[BLK], pk=0;
+    for(int pos=0;pos<2*SR;pos+=BLK){
+        voice_render_block(&vr,blk,BLK);
+        for(int k=0;k<BLK;k++) if(fabsf(blk[k])>pk) pk=fabsf(blk[k]);
     }
+    printf("  long loop: 2 s rendered, tick %u, depth %d, peak %.3f\n",c.tick,c.depth,pk);
+    pass&=!vr.done && c.depth==3 && pk>0.01f && c.tick>=4*VOICE_PPQ && c.tick<4*VOICE_PPQ+96;
+    if(!pass) g_fail=1;
     printf("  %s\n\n", pass?"PASS":"FAIL");
 }
 
+/* ====================================================================
+   Test 7c: Patch file — a patch and a voice round-trip through a mapped
+   library; malformed voices are refused
+   ==================================================================== */
+static void test_file(void){
+    printf("[test_file] Patch + voice library, mmap load\n");
+    VoiceBuilder vb; vb_init(&vb);
+    vb_repeat_begin(&vb);
+      vb_note(&vb,60,DUR_1_8,VEL_MF); vb_rest(&vb,DUR_1_16); vb_glide(&vb,64,DUR_1_8,VEL_F);
+    vb_repeat_end(&vb,3);
+    PatchProgram pa=patch_piano();
+    static uint64_t buf[4096];
+    PfWriter w; pf_writer_init(&w,buf,sizeof(buf));
+    pf_add_patch(&w,"piano",&pa);
+    pf_add_voice(&w,"riff",vb_finish(&vb)->code,vb_finish(&vb)->n);
+    size_t sz=pf_finish(&w);
+    const char *path="/tmp/shmc_layer1.shmc";
+    FILE *f=fopen(path,"wb"); int pass=f&&sz;
+    if(f){ fwrite(buf,1,sz,f); fclose(f); }
+
+    PatchFile lib; static PatchProgram lp; static VoiceProgram lv;
+    static EventStream a, b;
+    pass&=pf_open(&lib,path)==PF_OK;
+    pass&=pf_patch_load(&lib,pf_find(&lib,"piano"),&lp)==PF_OK;
+    pass&=voice_load(&lib,pf_find(&lib,"riff"),&lv)==PF_OK;
+    pass&=voice_load(&lib,pf_find(&lib,"piano"),&lv)==PF_E_ENTRY;
+    pf_close(&lib);
+    pass&=voice_compile(vb_finish(&vb),&a)==0 && voice_compile(&lv,&b)==0;
+    int la, lb; float *ra=render_voice(&a,&pa,120.0f,&la), *rb=render_voice(&b,&lp,120.0f,&lb);
+    pass&=la==lb && !memcmp(ra,rb,la*sizeof(float));
+    free(ra); free(rb);
+
+    VInstr bad[1]={ VI_PACK(VI_NOTE,200,DUR_1_4,VEL_F) };
+    pass&=voice_validate(bad,1)==PF_E_OPERAND;
+    bad[0]=VI_PACK(VI_REPEAT_BEGIN,0,0,0);
+    pass&=voice_validate(bad,1)==PF_E_OPERAND;
+    bad[0]=VI_PACK(VI_COUNT,0,0,0);
+    pass&=voice_validate(bad,1)==PF_E_OPCODE;
+    printf("  %zu bytes, %d events\n",sz,b.n);
+    if(!pass) g_fail=1;
+    printf("  %s\n\n", pass?"PASS":"FAIL");
+}
+
+/* ====================================================================
+   Test 8: Polyphony — chord from a merged stream, stealing policies
+   ==================================================================== */
+static void ev_add(EventStream *es, float beat, EvType t, int pitch){
+    Event *e=&es->events[es->n++];
+    e->tick=(uint32_t)(beat*VOICE_PPQ); e->type=t; e->pitch=(uint8_t)pitch; e->velocity=0.75f;
+}
+
+static void test_poly(void){
+    printf("[test_poly] C major chord + voice stealing\n");
+    static EventStream es; memset(&es,0,sizeof(es));
+    ev_add(&es,0.0f,EV_NOTE_ON,60); ev_add(&es,0.0f,EV_NOTE_ON,64);
+    ev_add(&es,0.0f,EV_NOTE_ON,67); ev_add(&es,0.5f,EV_NOTE_ON,72);
+    ev_add(&es,2.0f,EV_NOTE_OFF,60); ev_add(&es,2.0f,EV_NOTE_OFF,64);
+    ev_add(&es,2.0f,EV_NOTE_OFF,67); ev_add(&es,2.0f,EV_NOTE_OFF,72);
+    es.total_ticks=2*VOICE_PPQ;
+
+    PatchProgram pa=patch_pad();
+    static VoiceRenderer vr;
+    float blk[BLK]; int pass=1, peak_voices=0, blocks=0;
+
+    /* Enough voices: all four sound together, then all are reclaimed */
+    voice_renderer_init(&vr,&es,&pa,120.0f,(float)SR);
+    voice_renderer_set_polyphony(&vr,8,STEAL_OLDEST);
+    while(!voice_render_block(&vr,blk,BLK) && blocks<1000){
+        int a=voice_renderer_active(&vr); if(a>peak_voices)peak_voices=a;
+        blocks++;
+    }
+    if(peak_voices!=4||!vr.done||vr.n_free!=VOICE_MAX_POLY){
+        printf("  FAIL poly: peak=%d done=%d\n",peak_voices,vr.done); pass=0;
+    }
+
+    /* Three voices: the fourth note steals the oldest (C4) */
+    voice_renderer_init(&vr,&es,&pa,120.0f,(float)SR);
+    voice_renderer_set_polyphony(&vr,3,STEAL_OLDEST);
+    for(int i=0;i<(int)(0.3f*SR)/BLK;i++) voice_render_block(&vr,blk,BLK);
+    int has60=0, has72=0;
+    for(int i=0;i<vr.n_active;i++){
+        int p=vr.voices[vr.active[i]].pitch; has60|=p==60; has72|=p==72;
+    }
+    if(vr.n_active!=3||has60||!has72){ printf("  FAIL steal oldest\n"); pass=0; }
+
+    /* Same-pitch: retriggering a sounding pitch reuses its voice */
+    static EventStream rt; memset(&rt,0,sizeof(rt));
+    ev_add(&rt,0.0f,EV_NOTE_ON,60); ev_add(&rt,0.25f,EV_NOTE_ON,60);
+    ev_add(&rt,0.5f,EV_NOTE_OFF,60); rt.total_ticks=VOICE_PPQ/2;
+    voice_renderer_init(&vr,&rt,&pa,120.0f,(float)SR);
+    voice_renderer_set_polyphony(&vr,8,STEAL_SAME_PITCH);
+    for(int i=0;i<(int)(0.2f*SR)/BLK;i++) voice_render_block(&vr,blk,BLK);
+    if(vr.n_active!=1){ printf("  FAIL same-pitch: %d voices\n",vr.n_active); pass=0; }
+
+    /* Zero sustain: released plucks are reclaimed and the render ends */
+    PatchBuilder pb; pb_init(&pb);
+    pb_out(&pb,pb_mul(&pb,pb_osc(&pb,REG_ONE),pb_adsr(&pb,0,8,0,8)));
+    PatchProgram pluck=*pb_finish(&pb);
+    voice_renderer_init(&vr,&es,&pluck,120.0f,(float)SR);
+    voice_renderer_set_polyphony(&vr,8,STEAL_OLDEST);
+    blocks=0;
+    while(!voice_render_block(&vr,blk,BLK) && blocks<1000) blocks++;
+    if(!vr.done||vr.n_active){ printf("  FAIL zero sustain: %d voices left\n",vr.n_active); pass=0; }
+
+    printf("  peak voices=%d  %s\n\n",peak_voices,pass?"PASS":"FAIL");
+    if(!pass) g_fail++;
+}
+
+/* ====================================================================
+   Test 9: Sample-accurate event timing far into a long render
+   ==================================================================== */
+static void test_timing(void){
+    printf("[test_timing] Events at beat 1000.25 and 7 h land on their exact samples\n");
+    static EventStream es; memset(&es,0,sizeof(es));
+    ev_add(&es,1000.25f,EV_NOTE_ON,60); ev_add(&es,1001.0f,EV_NOTE_OFF,60);
+    es.total_ticks=1001*VOICE_PPQ;
+
+    PatchProgram pa=patch_piano();
+    static VoiceRenderer vr;
+    voice_renderer_init(&vr,&es,&pa,120.0f,(float)SR);
+    /* 1000.25 beats * 22050 samples/beat = 22055512.5 -> sample 22055513 */
+    const int64_t target=22055513;
+    static float buf[4096];
+    while(vr.sample_pos+4096<target) voice_render_block(&vr,buf,4096);
+    voice_render_block(&vr,buf,(int)(target-vr.sample_pos));
+    int before=voice_renderer_active(&vr);
+    voice_render_block(&vr,buf,1);
+    int after=voice_renderer_active(&vr);
+    int pass = before==0 && after==1 && vr.sample_pos==target+1;
+    printf("  voices before=%d after=%d\n",before,after);
+
+    /* Seven hours in at 97.5 bpm: tick 39312007 is 28894325145/26
+       samples, so the note fires at 1111320198.  Jump the renderer
+       there instead of rendering the hours between. */
+    memset(&es,0,sizeof(es));
+    es.events[0]=(Event){ 39312007u, EV_NOTE_ON, 60, 0.75f };
+    es.events[1]=(Event){ 39312007u+VOICE_PPQ, EV_NOTE_OFF, 60, 0.75f };
+    es.n=2; es.total_ticks=39312007u+VOICE_PPQ;
+    voice_renderer_init(&vr,&es,&pa,97.5f,(float)SR);
+    vr.sample_pos=1111320198-64;
+    voice_render_block(&vr,buf,64);
+    before=voice_renderer_active(&vr);
+    voice_render_block(&vr,buf,1);
+    after=voice_renderer_active(&vr);
+    int far = before==0 && after==1;
+    printf("  7 h at 97.5 bpm: before=%d after=%d\n",before,after);
+    pass&=far;
+    printf("  %s\n\n",pass?"PASS":"FAIL");
+    if(!pass) g_fail++;
+}
+
+/* ====================================================================
+   Test 10: Multi-track mix — identical for any thread count
+   ==================================================================== */
+#define MIX_TRACKS 6
+
+static void mix_tracks_init(VoiceRenderer *vr, EventStream *es, PatchProgram *pp){
+    static const int root[MIX_TRACKS]={36,48,60,64,67,72};
+    PatchProgram (*const mk[4])(void)={patch_bass,patch_piano,patch_lead,patch_pad};
+    for(int t=0;t<MIX_TRACKS;t++){
+        VoiceBuilder vb; vb_init(&vb);
+        vb_repeat_begin(&vb);
+        for(int i=0;i<4;i++) vb_note(&vb,root[t]+(i*(t+2))%12,DUR_1_8+(t&1),VEL_MF);
+        vb_repeat_end(&vb,2);
+        voice_compile(vb_finish(&vb),&es[t]);
+        pp[t]=mk[t%4]();
+        voice_renderer_init(&vr[t],&es[t],&pp[t],132.0f,(float)SR);
+        voice_renderer_set_polyphony(&vr[t],4,STEAL_OLDEST);
+    }
+}
+
+static float *mix_render(int threads, int *out_n){
+    static EventStream es[MIX_TRACKS]; static PatchProgram pp[MIX_TRACKS];
+    static VoiceRenderer vr[MIX_TRACKS]; static Mixer m;
+    int cap=SR*8, n=0, done=0;
+    float *buf=(float*)calloc(cap,sizeof(float));
+    mix_tracks_init(vr,es,pp);
+    mixer_init(&m,threads);
+    for(int t=0;t<MIX_TRACKS;t++) mixer_add_track(&m,&vr[t],0.3f);
+    while(!done && n+MIX_BLOCK<=cap){ done=mixer_render_block(&m,buf+n,MIX_BLOCK); n+=MIX_BLOCK; }
+    mixer_free(&m);
+    *out_n=n;
+    return buf;
+}
+
+static void test_mixer(void){
+    printf("[test_mixer] %d tracks, bit-identical for 1..4 threads\n",MIX_TRACKS);
+    static EventStream es[MIX_TRACKS]; static PatchProgram pp[MIX_TRACKS];
+    static VoiceRenderer vr[MIX_TRACKS];
+    int n1; float *ref=mix_render(1,&n1);
+
+    /* Sequential reference: each track alone, summed in track order */
+    int cap=SR*8, pass=n1>0;
+    float *seq=(float*)calloc(cap,sizeof(float)), blk[MIX_BLOCK];
+    mix_tracks_init(vr,es,pp);
+    for(int i=0;i<n1;i+=MIX_BLOCK)
+        for(int t=0;t<MIX_TRACKS;t++){
+            if(vr[t].done) continue;
+            voice_render_block(&vr[t],blk,MIX_BLOCK);
+            for(int k=0;k<MIX_BLOCK;k++) seq[i+k]+=0.3f*blk[k];
+        }
+    pass&=!memcmp(ref,seq,sizeof(float)*n1);
+    for(int th=2;th<=4;th++){
+        int n; float *b=mix_render(th,&n);
+        if(n!=n1||memcmp(ref,b,sizeof(float)*n1)){ printf("  FAIL %d threads\n",th); pass=0; }
+        free(b);
+    }
+    write_wav("/mnt/user-data/outputs/v1_mix.wav",ref,n1);
+    printf("  samples=%d  %s\n\n",n1,pass?"PASS":"FAIL");
+    if(!pass) g_fail++;
+    free(ref); free(seq);
+}
+
+/* ====================================================================
+   Test 11: Real-time driver — command ring, simulated callback clock
+   ==================================================================== */
+#define RT_N_CMDS 20000
+
+static void *rt_producer(void *arg){
+    RtQueue *q=(RtQueue*)arg;
+    for(int i=0;i<RT_N_CMDS;i++){
+        RtCmd c={ .type=RT_CMD_NOTE_ON, .pitch=(uint8_t)(i&127), .value=(float)i };
+        while(rt_queue_push(q,&c)) sched_yield();
+    }
+    return NULL;
+}
+
+/* Simulated clock: each read advances by g_step ns, so every callback
+   appears to take exactly g_step */
+static uint64_t g_now, g_step;
+static uint64_t fake_clock(void){ return g_now+=g_step; }
+static uint64_t mono_clock(void){
+    struct timespec ts; clock_gettime(CLOCK_MONOTONIC,&ts);
+    return (uint64_t)ts.tv_sec*1000000000ull+(uint64_t)ts.tv_nsec;
+}
+
+static void test_rt(void){
+    printf("[test_rt] Lock-free command ring + callback driver\n");
+    static RtDriver d; static float buf[BLK];
+    RtStats st; int pass=1;
+
+    /* Ring across two threads: every command arrives, in order */
+    static RtQueue q; memset(&q,0,sizeof(q));
+    pthread_t th; pthread_create(&th,NULL,rt_producer,&q);
+    int got=0; RtCmd c;
+    while(got<RT_N_CMDS){
+        if(!rt_queue_pop(&q,&c)){ sched_yield(); continue; }
+        if(c.value!=(float)got||c.pitch!=(got&127)){ pass=0; break; }
+        got++;
+    }
+    pthread_join(th,NULL);
+    if(got!=RT_N_CMDS||rt_queue_pop(&q,&c)){ printf("  FAIL ring: %d commands\n",got); pass=0; }
+
+    /* Full ring rejects and counts; nothing is lost from what was taken */
+    PatchProgram pi=patch_piano(), pb=patch_bass();
+    rt_driver_init(&d,&pi,NULL,(float)SR,120.f,4,NULL);
+    int rej=0;
+    for(int i=0;i<RT_QUEUE_SIZE+5;i++) rej+=rt_note_off(&d,60)!=0;
+    rt_driver_process(&d,buf,BLK);
+    rt_driver_stats(&d,&st);
+    if(rej!=5||st.dropped!=5||st.commands!=RT_QUEUE_SIZE){ printf("  FAIL overflow\n"); pass=0; }
+
+    /* Simulated callbacks of BLK frames; budget BLK/SR = 11.6 ms.
+       Callback 100 "takes" 15 ms and must be the only miss. */
+    static PreparedProgram bass; patch_prepare(&bass,&pb,(float)SR);
+    rt_driver_init(&d,&pi,NULL,(float)SR,120.f,4,fake_clock);
+    int heard=0, two=0;
+    for(int cb=0;cb<400;cb++){
+        if(cb==0)   rt_note_on(&d,60,0.8f);
+        if(cb==40){ rt_set_patch(&d,&bass); rt_note_on(&d,48,0.8f); }
+        if(cb==80)  rt_set_tempo(&d,90.f);
+        if(cb==120) rt_all_off(&d);
+        g_step=cb==100?15000000u:1000000u;
+        rt_driver_process(&d,buf,BLK);
+        if(cb==1) for(int k=0;k<BLK;k++) heard|=buf[k]!=0.f;
+        if(cb==41){
+            int n=d.vr.n_active;
+            for(int i=0;i<n;i++){
+                const VoiceSlot *v=&d.vr.voices[d.vr.active[i]];
+                two+=v->pitch==48 ? v->patch.prep==&bass : v->patch.prep==&d.vr.prep;
+            }
+        }
+    }
+    rt_driver_stats(&d,&st);
+    if(!heard||two!=2){ printf("  FAIL live notes / patch swap\n"); pass=0; }
+    if(voice_renderer_active(&d.vr)!=0||d.vr.bpm!=90.f){ printf("  FAIL all-off / tempo\n"); pass=0; }
+    if(st.callbacks!=400||st.misses!=1||st.worst_ns!=15000000u||st.commands!=5||st.dropped){
+        printf("  FAIL stats: cb=%llu miss=%llu worst=%llu cmd=%llu\n",
+               (unsigned long long)st.callbacks,(unsigned long long)st.misses,
+               (unsigned long long)st.worst_ns,(unsigned long long)st.commands);
+        pass=0;
+    }
+
+    /* Tempo change mid-sequence: a note at beat 4 after two beats at
+       120 bpm and two at 60 lands on sample 44100 + 88200 */
+    static EventStream es; memset(&es,0,sizeof(es));
+    ev_add(&es,4.0f,EV_NOTE_ON,60); ev_add(&es,5.0f,EV_NOTE_OFF,60); es.total_ticks=5*VOICE_PPQ;
+    static float big[4410];
+    rt_driver_init(&d,&pi,&es,(float)SR,120.f,1,NULL);
+    for(int i=0;i<10;i++) rt_driver_process(&d,big,4410);
+    rt_set_tempo(&d,60.f);
+    while(d.vr.sample_pos+4410<=132300) rt_driver_process(&d,big,4410);
+    rt_driver_process(&d,big,(int)(132300-d.vr.sample_pos));
+    int before=voice_renderer_active(&d.vr);
+    rt_driver_process(&d,big,1);
+    if(before!=0||voice_renderer_active(&d.vr)!=1){ printf("  FAIL tempo change timing\n"); pass=0; }
+
+    /* Live input after the sequence has ended is still rendered */
+    for(int i=0;i<100&&!d.vr.done;i++) rt_driver_process(&d,big,4410);
+    rt_note_on(&d,67,0.8f);
+    rt_driver_process(&d,buf,BLK);
+    int late=0; for(int k=0;k<BLK;k++) late|=buf[k]!=0.f;
+    if(!late){ printf("  FAIL note after sequence end\n"); pass=0; }
+
+    /* All-off releases doubled pitches too (STEAL_OLDEST keeps both) */
+    rt_driver_init(&d,&pi,NULL,(float)SR,120.f,4,NULL);
+    rt_note_on(&d,60,0.8f); rt_note_on(&d,60,0.8f);
+    rt_driver_process(&d,buf,BLK);
+    before=voice_renderer_active(&d.vr);
+    rt_all_off(&d);
+    for(int i=0;i<200;i++) rt_driver_process(&d,buf,BLK);
+    if(before!=2||voice_renderer_active(&d.vr)!=0){ printf("  FAIL all-off doubled pitch\n"); pass=0; }
+
+    /* Wall clock: 8-voice chord, reported only (machine dependent) */
+    static PatchProgram pp; pp=patch_pad();
+    rt_driver_init(&d,&pp,NULL,(float)SR,120.f,8,mono_clock);
+    for(int i=0;i<8;i++) rt_note_on(&d,48+i*3,0.5f);
+    for(int cb=0;cb<500;cb++) rt_driver_process(&d,buf,BLK);
+    rt_driver_stats(&d,&st);
+    printf("  8 voices x %d frames: worst %.1f us of %.1f us budget, %llu misses\n",
+           BLK,st.worst_ns/1e3,BLK*1e6/SR,(unsigned long long)st.misses);
+
+    printf("  %s\n\n",pass?"PASS":"FAIL");
+    if(!pass) g_fail++;
+}
+
 /* ====================================================================
    Main
    ==================================================================== */
 int main(void){
-    tables_init();
     printf("=== SHMC Layer 1  —  Voice DSL Test ===\n\n");
 
     test_compile_structure();
+    test_stream();
+    test_file();
     test_scale();
     test_repeat();
     test_rest_tie();
     test_nested_repeat();
     test_glide();
     test_melody();
+    test_poly();
+    test_timing();
+    test_mixer();
+    test_rt();
 
     printf("=== done ===\n");
-    return 0;
+    return g_fail ? 1 : 0;
 }
@@ -1,33 +1,54 @@
-; ---- Metadata ----
-SAMPLE_RATE 48000
-REGISTERS   8
-STATES      4
-
+; ---- SHMC patch assembly (layer0/include/patch_asm.h) ----
+;
 ; All instructions are:
-; OP dst src1 src2/immediate
-
-; --- Constants ---
-CONST   rX   value          ; rX = constant float
-
-; --- Arithmetic ---
-ADD     rX   rA   rB        ; rX = rA + rB
-MUL     rX   rA   rB        ; rX = rA * rB
-SUB     rX   rA   rB
-DIV     rX   rA   rB
-
-; --- Oscillator ---
-; state slot holds phase
-OSC     rX   sY   freq      ; rX = sin(phase)
-                             ; phase += 2π*freq/SR
-
-; --- Noise ---
-NOISE   rX   sY              ; sY used as RNG state
-
-; --- Nonlinearities ---
-SIN     rX   rA
-TANH    rX   rA
-CLIP    rX   rA
-
-; --- Mixing ---
-OUT     rX                   ; final output register
-
+;   OP dst src1 src2/immediate [mode words]
+; OUT has no destination.  Registers are rN, the reserved freq / vel /
+; time / one, or names (a new name as destination allocates one).
+; Immediates take their decoded units and snap to the nearest table
+; entry; #N is the raw field value.  State slots are allocated by the
+; assembler, densely in program order.
+
+; ---- PATCH name ... END; a file with one patch may leave them out ----
+PATCH pluck
+SAMPLE_RATE 48000
+REGISTERS   12
+STATES      64                  ; 2x TANH owns 40 of the 46
+
+; --- Envelope: attack, decay, sustain level, release ---
+    ADSR      env   2ms 150ms 0.5 300ms
+
+; --- Oscillators: frequency ratio register (one = note pitch) ---
+    SAW       osc   one blep          ; band-limited
+    CONST     det   1.0078125         ; Q8.8 constant
+    SQUARE    osc2  det blep
+    MIXN      mix   osc osc2 0.709677 0.709677
+
+; --- Filter, nonlinearity, output ---
+    LPF       flt   mix 1200Hz
+    TANH      sat   flt poly 2x       ; polynomial tier, 2x oversampled
+    MUL       o     sat env
+    OUT       o
+END
+
+; ---- Feedback: a name read before it is written needs REG ----
+PATCH feedback
+REG fb
+    ADD       ph    one fb
+    OSC       o     ph
+    MUL       fb    o o
+    OUT       o
+END
+
+; ---- TPT state-variable filter with register cutoff and Q ----
+PATCH svf_sweep
+    NOISE     n
+    EXP_DECAY sweep 6
+    CONST     base  2
+    MUL       k     sweep freq
+    MUL       k     k base            ; names can be written again
+    CONST     q     4
+    SVF       f     n k q bp
+    ADSR      env   1ms 400ms 0 100ms
+    MUL       o     f env
+    OUT       o
+END